@@ -96,19 +96,63 @@ bread(uint dev, uint blockno)
 
   b = bget(dev, blockno);
   if(!b->valid) {
-    virtio_disk_rw(b, 0);
+    blk_rw(b, 0);
     b->valid = 1;
   }
   return b;
 }
 
+// Read blocks blockno..blockno+n-1 into the cache, if they
+// aren't there already, using multi-block disk requests for
+// runs of uncached blocks. For reads of contiguous files.
+void
+breadahead(uint dev, uint blockno, int n)
+{
+  struct buf *b, *list, **pp;
+  int i;
+
+  pp = &list;
+  for(i = 0; i < n; i++){
+    b = bget(dev, blockno + i);
+    if(b->valid){
+      brelse(b);
+      continue;
+    }
+    *pp = b;
+    pp = &b->qnext;
+  }
+  *pp = 0;
+  if(list == 0)
+    return;
+
+  blk_read(list);
+  while(list){
+    b = list;
+    list = b->qnext;
+    b->valid = 1;
+    brelse(b);
+  }
+}
+
+// Return a locked buf for a block that the caller will
+// overwrite entirely, without reading it from disk.
+struct buf*
+bnew(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  b->valid = 1;
+  return b;
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
     panic("bwrite");
-  virtio_disk_rw(b, 1);
+  blk_rw(b, 1);
 }
 
 // Release a locked buffer.
@@ -143,6 +187,18 @@ bpin(struct buf *b) {
   release(&bcache.lock);
 }
 
+// Lock b, which the caller keeps pinned with bpin() so that
+// it stays in the cache, and return it as bread() would.
+struct buf*
+bacquire(struct buf *b)
+{
+  acquire(&bcache.lock);
+  b->refcnt++;
+  release(&bcache.lock);
+  acquiresleep(&b->lock);
+  return b;
+}
+
 void
 bunpin(struct buf *b) {
   acquire(&bcache.lock);
@@ -0,0 +1,189 @@
+// Block I/O scheduling.
+//
+// blk.c sits between the buffer cache (bio.c) and the
+// disk driver (virtio_disk.c). Normally bread() and bwrite()
+// go straight to the disk, one block per request.
+//
+// A caller about to write a batch of blocks can bracket
+// the writes with blk_plug() and blk_unplug():
+//   blk_plug();
+//   ... bwrite(b); brelse(b); ...
+//   blk_unplug();
+// While plugged, bwrite() doesn't touch the disk: it copies
+// the buffer into a snapshot, pins the buffer in the cache
+// until the write is done, so that nobody reads the block
+// from the disk before then, and adds the snapshot to the
+// process's plug list, which is kept sorted by block number.
+// blk_unplug() merges each run of adjacent blocks (up to
+// MAXSEG of them) into a single multi-segment disk request,
+// starts all the requests, and waits for them to finish.
+//
+// The disk writes from the snapshots, so blk_unplug() takes
+// no buffer locks. Holding every buffer of a checkpoint
+// locked, in block order, while waiting for the next, would
+// deadlock with anyone who holds one buffer while waiting
+// for a lower one, as extent tree walks do (parent, then
+// child). Writing from snapshots is safe because nobody else
+// writes a queued block before the unplug: file data blocks
+// are written under the inode's lock, and logged blocks
+// only by the log.
+//
+// blk_read() similarly reads a list of buffers with as few
+// requests as possible; see breadahead().
+//
+// A process waits for its disk requests by sleeping until
+// the completion interrupt, unless p->iopoll is set, when
+// it spins on the device's used ring instead. That costs a
+// hart, but saves the interrupt and the wakeup, which is
+// worth it for short synchronous waits that hold others up:
+// commit() polls while it writes the log. iopoll() sets
+// p->iopoll for a whole process, for benchmarks.
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "proc.h"
+#include "defs.h"
+#include "fs.h"
+#include "buf.h"
+#include "virtio.h"
+
+// A plugged write's copy of a buffer.
+struct snap {
+  struct buf b;       // the copy; b.qnext links the plug list
+  struct buf *orig;   // the cached buffer, pinned
+};
+
+// Snapshots come from pages from kalloc(), several to a page.
+#define NSNAP ((PGSIZE - 2*sizeof(uint64)) / sizeof(struct snap))
+struct snappage {
+  struct snappage *next;
+  uint64 n;           // snap[0..n-1] are in use
+  struct snap snap[NSNAP];
+};
+
+static struct snap*
+snapalloc(struct proc *p)
+{
+  struct snappage *pg;
+
+  if(p->snaps == 0 || p->snaps->n == NSNAP){
+    if((pg = (struct snappage*)kalloc()) == 0)
+      return 0;
+    pg->next = p->snaps;
+    pg->n = 0;
+    p->snaps = pg;
+  }
+  return &p->snaps->snap[p->snaps->n++];
+}
+
+// Add a snapshot of b to p's plug list, in block order.
+// Returns -1 if out of memory.
+static int
+blk_queue(struct proc *p, struct buf *b)
+{
+  struct buf **pp;
+  struct snap *s;
+
+  for(pp = &p->plug; *pp && (*pp)->blockno < b->blockno; pp = &(*pp)->qnext)
+    ;
+  if(*pp && (*pp)->blockno == b->blockno && (*pp)->dev == b->dev){
+    memmove((*pp)->data, b->data, BSIZE);  // already queued: newer contents
+    return 0;
+  }
+  if((s = snapalloc(p)) == 0)
+    return -1;
+  s->b.dev = b->dev;
+  s->b.blockno = b->blockno;
+  memmove(s->b.data, b->data, BSIZE);
+  s->orig = b;
+  bpin(b);
+  s->b.qnext = *pp;
+  *pp = &s->b;
+  return 0;
+}
+
+// Start disk requests for the buffers on list, which are
+// locked or snapshots, linked through qnext and sorted by
+// block number: one request per run of adjacent blocks.
+static void
+blk_start(struct buf *list, int write)
+{
+  struct buf *b, *head;
+  int n;
+
+  for(head = list; head != 0; head = b->qnext){
+    n = 1;
+    for(b = head; b->qnext && n < MAXSEG; b = b->qnext){
+      if(b->qnext->dev != b->dev || b->qnext->blockno != b->blockno + 1)
+        break;
+      n++;
+    }
+    virtio_disk_start(head, n, write);
+  }
+  virtio_disk_kick(); // one notification for the whole batch
+}
+
+// Read or write b, which must be locked.
+// A write by a plugged process is only queued, unless
+// there is no memory for a snapshot.
+void
+blk_rw(struct buf *b, int write)
+{
+  struct proc *p = myproc();
+
+  if(write && p->plugged && blk_queue(p, b) == 0)
+    return;
+  virtio_disk_rw(b, write, p->iopoll);
+}
+
+// Start holding back this process's writes.
+// Plugs nest; only the outermost blk_unplug() issues the writes.
+void
+blk_plug(void)
+{
+  myproc()->plugged++;
+}
+
+// Issue the writes queued since blk_plug(),
+// and wait for them to reach the disk.
+void
+blk_unplug(void)
+{
+  struct proc *p = myproc();
+  struct buf *b, *list;
+  struct snappage *pg;
+
+  if(p->plugged < 1)
+    panic("blk_unplug");
+  if(--p->plugged > 0)
+    return;
+
+  list = p->plug;
+  p->plug = 0;
+
+  blk_start(list, 1);
+  for(b = list; b != 0; b = b->qnext){
+    virtio_disk_wait(b, p->iopoll);
+    bunpin(((struct snap*)b)->orig);
+  }
+
+  while((pg = p->snaps) != 0){
+    p->snaps = pg->next;
+    kfree((char*)pg);
+  }
+}
+
+// Read the locked buffers on list (linked through qnext,
+// in block order), and wait for the reads to finish.
+void
+blk_read(struct buf *list)
+{
+  struct buf *b;
+
+  blk_start(list, 0);
+  for(b = list; b != 0; b = b->qnext)
+    virtio_disk_wait(b, myproc()->iopoll);
+}
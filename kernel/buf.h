@@ -7,6 +7,9 @@ struct buf {
   uint refcnt;
   struct buf *prev; // LRU cache list
   struct buf *next;
+  struct buf *qnext; // blk.c plug list; disk request
+  int vq;      // virtio_disk queue of the disk request
+  uint16 vqidx; // the request's avail ring position
   uchar data[BSIZE];
 };
 
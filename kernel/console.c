@@ -21,6 +21,8 @@
 #include "riscv.h"
 #include "defs.h"
 #include "proc.h"
+#include "poll.h"
+#include "fcntl.h"
 
 #define BACKSPACE 0x100
 #define C(x)  ((x)-'@')  // Control-x
@@ -50,13 +52,16 @@ struct {
   uint r;  // Read index
   uint w;  // Write index
   uint e;  // Edit index
+
+  struct pollent *pollq; // processes in poll()
 } cons;
 
 //
 // user write()s to the console go here.
+// they may wait for the uart, even if nonblock is set.
 //
 int
-consolewrite(int user_src, uint64 src, int n)
+consolewrite(int user_src, uint64 src, int n, int nonblock)
 {
   int i;
 
@@ -74,10 +79,11 @@ consolewrite(int user_src, uint64 src, int n)
 // user read()s from the console go here.
 // copy (up to) a whole input line to dst.
 // user_dist indicates whether dst is a user
-// or kernel address.
+// or kernel address. if nonblock is set, return
+// what has arrived, or -EAGAIN if nothing has.
 //
 int
-consoleread(int user_dst, uint64 dst, int n)
+consoleread(int user_dst, uint64 dst, int n, int nonblock)
 {
   uint target;
   int c;
@@ -93,6 +99,10 @@ consoleread(int user_dst, uint64 dst, int n)
         release(&cons.lock);
         return -1;
       }
+      if(nonblock){
+        release(&cons.lock);
+        return n < target ? target - n : -EAGAIN;
+      }
       sleep(&cons.r, &cons.lock);
     }
 
@@ -126,6 +136,23 @@ consoleread(int user_dst, uint64 dst, int n)
   return target - n;
 }
 
+//
+// poll() calls this to see if a read() would block.
+//
+int
+consolepoll(struct pollent *e)
+{
+  int r;
+
+  acquire(&cons.lock);
+  pollwait(&cons.pollq, e);
+  r = POLLOUT;
+  if(cons.r != cons.w)
+    r |= POLLIN;
+  release(&cons.lock);
+  return r;
+}
+
 //
 // the console input interrupt handler.
 // uartintr() calls this for input character.
@@ -170,6 +197,7 @@ consoleintr(int c)
         // has arrived.
         cons.w = cons.e;
         wakeup(&cons.r);
+        pollwakeup(&cons.pollq);
       }
     }
     break;
@@ -189,4 +217,5 @@ consoleinit(void)
   // to consoleread and consolewrite.
   devsw[CONSOLE].read = consoleread;
   devsw[CONSOLE].write = consolewrite;
+  devsw[CONSOLE].poll = consolepoll;
 }
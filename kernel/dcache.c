@@ -0,0 +1,197 @@
+// Directory entry cache.
+//
+// namex() looks up every component of every path name, and
+// without help each lookup locks the directory and scans its
+// entries with readi(). The dentry cache remembers recent
+// lookups: (dev, directory inum, name) -> inum, where inum 0
+// records that the directory has no such name (a negative
+// entry, which makes creating a file, or searching for a
+// command, cheap too). A cached lookup needs neither the
+// directory's sleep-lock nor its blocks.
+//
+// Entries are added and changed only while the directory is
+// locked: by dirlookup(), which has just read the directory,
+// and by dirlink() and unlink, which change it. So a cached
+// entry always agrees with the directory. Lock order:
+// dcache.lock, then itable.lock. When a directory
+// inode is freed, dc_forget() drops its entries, since the
+// inode number may be reused for something else.
+//
+// The cache has NDENTRY entries, found through a hash table
+// and recycled least recently used first, like the buffer
+// cache's buffers. Names of DNAMELEN bytes or more aren't
+// cached, so that an entry needn't have room for DIRSIZ.
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+
+#define NDHASH   61 // hash buckets
+#define DNAMELEN 28 // longest cached name, plus its NUL
+
+struct dentry {
+  uint dev;
+  uint dir;               // inum of the directory
+  char name[DNAMELEN];
+  uint inum;              // 0 if dir has no entry name
+  struct dentry *hnext;   // hash chain; 0-terminated
+  struct dentry *prev;    // LRU list
+  struct dentry *next;
+};
+
+struct {
+  struct spinlock lock;
+  struct dentry dentry[NDENTRY];
+  struct dentry *hash[NDHASH];
+
+  // Linked list of all entries, through prev/next.
+  // head.next is most recently used, head.prev least.
+  struct dentry head;
+} dcache;
+
+static uint
+dhash(uint dev, uint dir, char *name)
+{
+  uint h = dev * 31 + dir;
+  int i;
+
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = h * 31 + (uchar)name[i];
+  return h % NDHASH;
+}
+
+static int
+cacheable(char *name)
+{
+  int i;
+
+  for(i = 0; i < DNAMELEN; i++)
+    if(name[i] == 0)
+      return 1;
+  return 0;
+}
+
+void
+dcinit(void)
+{
+  struct dentry *d;
+
+  initlock(&dcache.lock, "dcache");
+  dcache.head.prev = &dcache.head;
+  dcache.head.next = &dcache.head;
+  for(d = dcache.dentry; d < dcache.dentry+NDENTRY; d++){
+    d->next = dcache.head.next;
+    d->prev = &dcache.head;
+    dcache.head.next->prev = d;
+    dcache.head.next = d;
+  }
+}
+
+// Move d to the front of the LRU list.
+static void
+touch(struct dentry *d)
+{
+  d->next->prev = d->prev;
+  d->prev->next = d->next;
+  d->next = dcache.head.next;
+  d->prev = &dcache.head;
+  dcache.head.next->prev = d;
+  dcache.head.next = d;
+}
+
+// Take d out of its hash chain, if it is in one.
+static void
+unhash(struct dentry *d)
+{
+  struct dentry **pp;
+
+  if(d->dir == 0)
+    return;
+  for(pp = &dcache.hash[dhash(d->dev, d->dir, d->name)]; *pp != d; pp = &(*pp)->hnext)
+    ;
+  *pp = d->hnext;
+  d->dir = 0;
+}
+
+// Find the entry for name in dp. Caller holds dcache.lock.
+static struct dentry*
+find(struct inode *dp, char *name)
+{
+  struct dentry *d;
+
+  for(d = dcache.hash[dhash(dp->dev, dp->inum, name)]; d != 0; d = d->hnext){
+    if(d->dev == dp->dev && d->dir == dp->inum && namecmp(d->name, name) == 0)
+      return d;
+  }
+  return 0;
+}
+
+// Look up name in directory dp. Returns 1 if the cache knows
+// the answer, and sets *ipp to the inode, with a reference,
+// or to 0 if dp has no such name; returns 0 if the cache
+// doesn't know. dp needn't be locked, only referenced.
+int
+dc_lookup(struct inode *dp, char *name, struct inode **ipp)
+{
+  struct dentry *d;
+
+  if(!cacheable(name))
+    return 0;
+  acquire(&dcache.lock);
+  if((d = find(dp, name)) == 0){
+    release(&dcache.lock);
+    return 0;
+  }
+  // take the reference before an unlink can change the
+  // entry, so that the inode can't be freed under us.
+  *ipp = d->inum ? iget(dp->dev, d->inum) : 0;
+  touch(d);
+  release(&dcache.lock);
+  return 1;
+}
+
+// Record that name in directory dp is inum, or that dp has
+// no entry name if inum is 0. Caller holds dp->lock.
+void
+dc_enter(struct inode *dp, char *name, uint inum)
+{
+  struct dentry *d;
+  uint h;
+
+  if(!cacheable(name))
+    return;
+  acquire(&dcache.lock);
+  if((d = find(dp, name)) == 0){
+    // recycle the least recently used entry.
+    d = dcache.head.prev;
+    unhash(d);
+    d->dev = dp->dev;
+    d->dir = dp->inum;
+    safestrcpy(d->name, name, DNAMELEN);
+    h = dhash(dp->dev, dp->inum, name);
+    d->hnext = dcache.hash[h];
+    dcache.hash[h] = d;
+  }
+  d->inum = inum;
+  touch(d);
+  release(&dcache.lock);
+}
+
+// Drop the entries of directory inum on dev, which is being freed.
+void
+dc_forget(uint dev, uint inum)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  for(d = dcache.dentry; d < dcache.dentry+NDENTRY; d++){
+    if(d->dev == dev && d->dir == inum)
+      unhash(d);
+  }
+  release(&dcache.lock);
+}
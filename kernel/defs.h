@@ -2,26 +2,46 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct iostat;
+struct iovec;
 struct pipe;
+struct pollent;
 struct proc;
+struct sqe;
 struct spinlock;
 struct sleeplock;
+struct sock;
 struct stat;
 struct superblock;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+struct buf*     bnew(uint, uint);
+void            breadahead(uint, uint, int);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
+struct buf*     bacquire(struct buf*);
+
+// blk.c
+void            blk_rw(struct buf*, int);
+void            blk_plug(void);
+void            blk_unplug(void);
+void            blk_read(struct buf*);
 
 // console.c
 void            consoleinit(void);
 void            consoleintr(int);
 void            consputc(int);
 
+// dcache.c
+void            dcinit(void);
+int             dc_lookup(struct inode*, char*, struct inode**);
+void            dc_enter(struct inode*, char*, uint);
+void            dc_forget(uint, uint);
+
 // exec.c
 int             exec(char*, char**);
 
@@ -33,13 +53,26 @@ void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
+int             filereadv(struct file*, struct iovec*, int);
+int             filewritev(struct file*, struct iovec*, int);
+int             filepread(struct file*, uint64, int, uint);
+int             filepwrite(struct file*, uint64, int, uint);
+int             filesplice(struct file*, struct file*, int, int);
+int             filepoll(struct file*, struct pollent*);
+int             filecopy(struct file*, struct file*, int);
 
 // fs.c
 void            fsinit(int);
+uint            balloc(uint, uint);
+uint            balloc_run(uint, uint, uint*);
+uint            dalloc(struct inode*, uint);
+void            bfree(int, uint, uint);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
+void            dirunlink(struct inode*, char*, uint);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
+struct inode*   iget(uint, uint);
 void            iinit();
 void            ilock(struct inode*);
 void            iput(struct inode*);
@@ -53,6 +86,14 @@ int             readi(struct inode*, int, uint64, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
+void            iflush(struct inode*);
+void            wbsync(void);
+
+// extent.c
+void            ext_initroot(uint*);
+uint            ext_bmap(struct inode*, uint, uint*);
+void            ext_trunc(struct inode*);
+uint            ext_nmeta(struct inode*);
 
 // ramdisk.c
 void            ramdiskinit(void);
@@ -67,14 +108,36 @@ void            kinit(void);
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
+void            log_data(struct buf*);
+void            log_free(uint, uint);
 void            begin_op(void);
 void            end_op(void);
+void            begin_opn(int);
+void            end_opn(int);
+void            log_force(void);
+void            log_stat(struct iostat*);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
-int             piperead(struct pipe*, uint64, int);
-int             pipewrite(struct pipe*, uint64, int);
+struct pipe*    pipenew(void);
+int             pipereadv(struct pipe*, struct iovec*, int, int);
+int             pipewritev(struct pipe*, struct iovec*, int, int);
+int             pipereadmsg(struct pipe*, struct iovec*, int, int);
+int             pipewritemsg(struct pipe*, struct iovec*, int, int);
+int             pipesize(struct pipe*);
+int             pipesetsize(struct pipe*, int);
+int             pipebegin(struct pipe*, int, int);
+char*           pipeptr(struct pipe*, int, uint, uint*);
+void            pipeend(struct pipe*, int, uint);
+int             pipepoll(struct pipe*, int, struct pollent*);
+
+// poll.c
+void            pollinit(void);
+void            pollwait(struct pollent**, struct pollent*);
+void            pollwakeup(struct pollent**);
+void            polltick(void);
+int             pollfds(uint64, int, int);
 
 // printf.c
 void            printf(char*, ...);
@@ -90,6 +153,7 @@ void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
+void            kthread(char*, void (*)(void));
 struct cpu*     mycpu(void);
 struct cpu*     getmycpu(void);
 struct proc*    myproc();
@@ -105,6 +169,22 @@ int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
 
+// sock.c
+void            sockinit(void);
+struct sock*    sockalloc(int);
+void            sockclose(struct sock*);
+int             sockbind(struct sock*);
+void            socknamed(struct sock*, struct inode*);
+int             socklisten(struct sock*, int);
+int             sockconnect(struct sock*, struct inode*);
+int             sockaccept(struct sock*, int, struct sock**);
+int             sockread(struct sock*, struct iovec*, int, int);
+int             sockwrite(struct sock*, struct iovec*, int, int);
+int             sockpoll(struct sock*, struct pollent*);
+
+// sysfile.c
+int             uringop(struct sqe*);
+
 // swtch.S
 void            swtch(struct context*, struct context*);
 
@@ -153,6 +233,17 @@ void            uartputc(int);
 void            uartputc_sync(int);
 int             uartgetc(void);
 
+// uring.c
+uint64          uringsetup(void);
+void            uringfree(struct proc*);
+int             uringenter(int);
+
+// vdso.c
+void            vdsoinit(void);
+void            vdsotick(void);
+int             vdsomap(pagetable_t, struct proc*);
+void            vdsounmap(pagetable_t);
+
 // vm.c
 void            kvminit(void);
 void            kvminithart(void);
@@ -179,7 +270,11 @@ void            plic_complete(int);
 
 // virtio_disk.c
 void            virtio_disk_init(void);
-void            virtio_disk_rw(struct buf *, int);
+void            virtio_disk_rw(struct buf *, int, int);
+void            virtio_disk_start(struct buf *, int, int);
+void            virtio_disk_kick(void);
+void            virtio_disk_wait(struct buf *, int);
+void            virtio_disk_stat(struct iostat *);
 void            virtio_disk_intr(void);
 
 // number of elements in fixed-size array
@@ -115,6 +115,8 @@ exec(char *path, char **argv)
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
   proc_freepagetable(oldpagetable, oldsz);
+  if(p->uring)
+    uringfree(p);  // the new image knows nothing of the old rings
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
@@ -0,0 +1,303 @@
+// Extent trees: the block maps of inodes with I_EXTENTS.
+//
+// A file written sequentially while the disk has free space
+// needs only a few extents, which fit in the inode itself, so
+// bmap() on it reads no metadata blocks at all, and readi()
+// can fetch a run of contiguous blocks with one disk request.
+// Larger or fragmented files grow a tree of extent blocks
+// below the inode, as in ext4. See fs.h for the format.
+//
+// The caller must hold ip->lock. Callers that may allocate
+// must be in a transaction, and must iupdate(ip) afterwards,
+// since the root of the tree lives in the inode.
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "stat.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "file.h"
+
+#define MAXDEPTH 5  // EXT_ROOT * EXT_NODE^4 extents; more than any disk
+
+// A node on the path from the root to a leaf:
+// the root in ip->addrs, or an extent block.
+struct node {
+  struct buf *bp;  // 0 for the root
+  struct extent_header *h;
+  struct extent *e;
+};
+
+// Make addrs the root of an empty tree.
+void
+ext_initroot(uint *addrs)
+{
+  struct extent_header *h = (struct extent_header*)addrs;
+
+  h->magic = EXT_MAGIC;
+  h->n = 0;
+  h->max = EXT_ROOT;
+  h->depth = 0;
+}
+
+// Set up n for the root (blk 0) or extent block blk.
+static void
+getnode(struct inode *ip, uint blk, struct node *n)
+{
+  if(blk == 0){
+    n->bp = 0;
+    n->h = (struct extent_header*)ip->addrs;
+  } else {
+    n->bp = bread(ip->dev, blk);
+    n->h = (struct extent_header*)n->bp->data;
+  }
+  n->e = (struct extent*)(n->h + 1);
+  if(n->h->magic != EXT_MAGIC)
+    panic("extent: bad node");
+}
+
+// Set up n for a new, empty extent block blk.
+static void
+newnode(struct inode *ip, uint blk, int depth, struct node *n)
+{
+  n->bp = bread(ip->dev, blk);
+  n->h = (struct extent_header*)n->bp->data;
+  n->e = (struct extent*)(n->h + 1);
+  n->h->magic = EXT_MAGIC;
+  n->h->n = 0;
+  n->h->max = EXT_NODE;
+  n->h->depth = depth;
+}
+
+// Record a change to n. Changes to the root reach
+// the disk with the caller's iupdate().
+static void
+dirty(struct node *n)
+{
+  if(n->bp)
+    log_write(n->bp);
+}
+
+// Release the blocks of path[0..d].
+static void
+putpath(struct node *path, int d)
+{
+  for(; d >= 0; d--)
+    if(path[d].bp)
+      brelse(path[d].bp);
+}
+
+// Index of the last entry of n whose lblk is <= bn,
+// or 0 if there is none.
+static int
+search(struct node *n, uint bn)
+{
+  int lo, hi, mid;
+
+  lo = 0;
+  hi = n->h->n - 1;
+  while(lo < hi){
+    mid = (lo + hi + 1) / 2;
+    if(n->e[mid].lblk <= bn)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+// Fill in path[] with the nodes from the root down to the leaf
+// that maps, or would map, file block bn. Returns the leaf's
+// index in path[]. Interior nodes are never empty, and the first
+// entry of each covers everything before the second.
+static int
+descend(struct inode *ip, uint bn, struct node *path)
+{
+  int d;
+
+  getnode(ip, 0, &path[0]);
+  for(d = 0; path[d].h->depth > 0; d++){
+    if(d+1 >= MAXDEPTH)
+      panic("extent: too deep");
+    getnode(ip, path[d].e[search(&path[d], bn)].pblk, &path[d+1]);
+  }
+  return d;
+}
+
+// Add x to n, which has room, keeping n sorted.
+static void
+put(struct node *n, struct extent *x)
+{
+  int i;
+
+  for(i = n->h->n; i > 0 && n->e[i-1].lblk > x->lblk; i--)
+    n->e[i] = n->e[i-1];
+  n->e[i] = *x;
+  n->h->n++;
+}
+
+// Add extent x to the leaf path[d], splitting full nodes on
+// the way back up, and deepening the tree if the root is full.
+static void
+insert(struct inode *ip, struct node *path, int d, struct extent *x)
+{
+  struct extent up = *x;
+  struct node *n, r;
+  uint blk;
+  int k;
+
+  for(; d > 0; d--){
+    n = &path[d];
+    if(n->h->n < n->h->max){
+      put(n, &up);
+      dirty(n);
+      return;
+    }
+
+    // split n, moving its upper half to a new block r. when
+    // appending, as most writes do, move nothing, so that
+    // n stays full rather than half empty.
+    blk = balloc(ip->dev, n->bp->blockno + 1);
+    newnode(ip, blk, n->h->depth, &r);
+    k = n->h->n;
+    if(up.lblk < n->e[k-1].lblk)
+      k /= 2;
+    memmove(r.e, n->e + k, (n->h->n - k) * sizeof(struct extent));
+    r.h->n = n->h->n - k;
+    n->h->n = k;
+    if(r.h->n == 0 || up.lblk >= r.e[0].lblk)
+      put(&r, &up);
+    else
+      put(n, &up);
+    dirty(n);
+    log_write(r.bp);
+    up.lblk = r.e[0].lblk;
+    up.len = 0;
+    up.pblk = blk;
+    brelse(r.bp);
+  }
+
+  n = &path[0];
+  if(n->h->n < n->h->max){
+    put(n, &up);
+    return;
+  }
+
+  // the root is full: move its entries down into a new
+  // block, and add up to that block instead.
+  blk = balloc(ip->dev, 0);
+  newnode(ip, blk, n->h->depth, &r);
+  memmove(r.e, n->e, n->h->n * sizeof(struct extent));
+  r.h->n = n->h->n;
+  put(&r, &up);
+  log_write(r.bp);
+  brelse(r.bp);
+  n->h->depth++;
+  n->h->n = 1;
+  n->e[0].lblk = 0;
+  n->e[0].len = 0;
+  n->e[0].pblk = blk;
+}
+
+// Return the disk block address of file block bn of ip,
+// allocating it if there is none, and set *run to the number
+// of blocks from bn on that are contiguous on disk.
+// ip->last remembers the extent found, so that runs of calls
+// for consecutive blocks don't have to search the tree.
+uint
+ext_bmap(struct inode *ip, uint bn, uint *run)
+{
+  struct node path[MAXDEPTH], *leaf;
+  struct extent *e, *last, x;
+  uint b;
+  int d;
+
+  last = &ip->last;
+  if(last->len == 0 || bn < last->lblk || bn - last->lblk >= last->len){
+    d = descend(ip, bn, path);
+    leaf = &path[d];
+    e = leaf->h->n > 0 ? &leaf->e[search(leaf, bn)] : 0;
+    if(e && e->lblk <= bn && bn - e->lblk < e->len){
+      *last = *e;
+    } else {
+      // allocate, trying for the block after the
+      // extent before bn, to extend that extent.
+      b = dalloc(ip, e && e->lblk <= bn ? e->pblk + (bn - e->lblk) : 0);
+      if(e && bn == e->lblk + e->len && b == e->pblk + e->len){
+        e->len++;
+        dirty(leaf);
+        *last = *e;
+      } else {
+        x.lblk = bn;
+        x.len = 1;
+        x.pblk = b;
+        insert(ip, path, d, &x);
+        *last = x;
+      }
+    }
+    putpath(path, d);
+  }
+  *run = last->lblk + last->len - bn;
+  return last->pblk + (bn - last->lblk);
+}
+
+// Free the extents below node h, and their blocks.
+static void
+freenode(struct inode *ip, struct extent_header *h)
+{
+  struct extent *e = (struct extent*)(h + 1);
+  struct buf *bp;
+  int i;
+
+  for(i = 0; i < h->n; i++){
+    if(h->depth == 0){
+      bfree(ip->dev, e[i].pblk, e[i].len);
+      continue;
+    }
+    bp = bread(ip->dev, e[i].pblk);
+    freenode(ip, (struct extent_header*)bp->data);
+    brelse(bp);
+    bfree(ip->dev, e[i].pblk, 1);
+  }
+}
+
+// Free all of ip's blocks, leaving an empty tree.
+void
+ext_trunc(struct inode *ip)
+{
+  freenode(ip, (struct extent_header*)ip->addrs);
+  ext_initroot(ip->addrs);
+  ip->last.len = 0;
+}
+
+// Count the extent blocks below node h.
+static uint
+countnode(struct inode *ip, struct extent_header *h)
+{
+  struct extent *e = (struct extent*)(h + 1);
+  struct buf *bp;
+  uint n;
+  int i;
+
+  n = 0;
+  if(h->depth == 0)
+    return 0;
+  for(i = 0; i < h->n; i++){
+    bp = bread(ip->dev, e[i].pblk);
+    n += 1 + countnode(ip, (struct extent_header*)bp->data);
+    brelse(bp);
+  }
+  return n;
+}
+
+// Number of extent blocks in ip's tree, for stat.
+uint
+ext_nmeta(struct inode *ip)
+{
+  return countnode(ip, (struct extent_header*)ip->addrs);
+}
@@ -3,3 +3,14 @@
 #define O_RDWR    0x002
 #define O_CREATE  0x200
 #define O_TRUNC   0x400
+#define O_NONBLOCK 0x800 // read() and write() return -EAGAIN rather than wait
+
+// fcntl() commands
+#define F_GETFL      3    // O_ flags of an open file
+#define F_SETFL      4    // set an open file's O_NONBLOCK
+#define F_SETPIPE_SZ 1031 // resize a pipe's buffer
+#define F_GETPIPE_SZ 1032 // size of a pipe's buffer
+
+// what read() and write() return, negated, if an O_NONBLOCK
+// file isn't ready.
+#define EAGAIN 11
@@ -12,6 +12,11 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "poll.h"
+#include "uio.h"
+#include "fcntl.h"
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
 
 struct devsw devsw[NDEV];
 struct {
@@ -75,6 +80,8 @@ fileclose(struct file *f)
 
   if(ff.type == FD_PIPE){
     pipeclose(ff.pipe, ff.writable);
+  } else if(ff.type == FD_SOCK){
+    sockclose(ff.sock);
   } else if(ff.type == FD_INODE || ff.type == FD_DEVICE){
     begin_op();
     iput(ff.ip);
@@ -101,27 +108,149 @@ filestat(struct file *f, uint64 addr)
   return -1;
 }
 
-// Read from file f.
-// addr is a user virtual address.
+// For poll(): put e on file f's wait queue, if it has one,
+// and return the POLL flags for what f is ready to do.
+// e points to two pollents, since a socket has two queues.
 int
-fileread(struct file *f, uint64 addr, int n)
+filepoll(struct file *f, struct pollent *e)
 {
-  int r = 0;
+  int r;
 
-  if(f->readable == 0)
-    return -1;
+  if(f->type == FD_PIPE)
+    r = pipepoll(f->pipe, f->writable, e);
+  else if(f->type == FD_SOCK)
+    r = sockpoll(f->sock, e);
+  else if(f->type == FD_DEVICE && f->major >= 0 && f->major < NDEV &&
+          devsw[f->major].poll)
+    r = devsw[f->major].poll(e);
+  else
+    r = POLLIN | POLLOUT;  // files never block
+  if(!f->readable)
+    r &= ~POLLIN;
+  if(!f->writable)
+    r &= ~POLLOUT;
+  return r;
+}
 
-  if(f->type == FD_PIPE){
-    r = piperead(f->pipe, addr, n);
-  } else if(f->type == FD_DEVICE){
+// Read from inode or device file f into the cnt buffers in
+// iov, in user memory (user_dst != 0) or kernel memory,
+// stopping at the first short read. An inode is read at
+// *off, which advances.
+static int
+rdfile(struct file *f, int user_dst, struct iovec *iov, int cnt, uint *off)
+{
+  int r = 0, tot = 0;
+
+  if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].read)
       return -1;
-    r = devsw[f->major].read(1, addr, n);
-  } else if(f->type == FD_INODE){
+    for(int v = 0; v < cnt; v++){
+      r = devsw[f->major].read(user_dst, (uint64)iov[v].iov_base, iov[v].iov_len, f->nonblock);
+      if(r > 0)
+        tot += r;
+      if(r != iov[v].iov_len)
+        break;
+    }
+  } else {
     ilock(f->ip);
-    if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
-      f->off += r;
+    for(int v = 0; v < cnt; v++){
+      if((r = readi(f->ip, user_dst, (uint64)iov[v].iov_base, *off, iov[v].iov_len)) > 0){
+        *off += r;
+        tot += r;
+      }
+      if(r != iov[v].iov_len)
+        break;
+    }
     iunlock(f->ip);
+  }
+  return tot > 0 ? tot : r;
+}
+
+// Write to inode or device file f from the cnt buffers in
+// iov, in user memory (user_src != 0) or kernel memory. An
+// inode is written at *off, which advances. Returns the
+// number of bytes written, or -1.
+static int
+wrfile(struct file *f, int user_src, struct iovec *iov, int cnt, uint *off)
+{
+  int r = 0, n1 = 0, v, tot = 0;
+  uint j;
+
+  if(f->type == FD_DEVICE){
+    if(f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
+      return -1;
+    for(v = 0; v < cnt; v++){
+      r = devsw[f->major].write(user_src, (uint64)iov[v].iov_base, iov[v].iov_len, f->nonblock);
+      if(r > 0)
+        tot += r;
+      if(r != iov[v].iov_len)
+        break;
+    }
+    return tot > 0 ? tot : r;
+  }
+
+  // write a few blocks at a time to avoid exceeding
+  // the maximum log transaction size, including
+  // i-node, indirect block, allocation blocks,
+  // and 2 blocks of slop for non-aligned writes.
+  // the buffers land next to each other in the file,
+  // so small ones share a transaction.
+  // this really belongs lower down, since writei()
+  // might be writing a device like the console.
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+  for(v = 0, j = 0; v < cnt; ){
+    begin_op();
+    ilock(f->ip);
+    for(int room = max; v < cnt && room > 0; ){
+      n1 = iov[v].iov_len - j;
+      if(n1 > room)
+        n1 = room;
+      if((r = writei(f->ip, user_src, (uint64)iov[v].iov_base + j, *off, n1)) > 0){
+        *off += r;
+        tot += r;
+        room -= r;
+        j += r;
+      }
+      if(r != n1)
+        break;
+      if(j == iov[v].iov_len){
+        v++;
+        j = 0;
+      }
+    }
+    int full = f->ip->ndelay == NDELAY;
+    iunlock(f->ip);
+    end_op();
+
+    if(r < 0)
+      break;
+    if(full){
+      // write back the delayed blocks to make room.
+      iflush(f->ip);
+    } else if(r != n1){
+      // error from writei
+      break;
+    }
+  }
+  return tot;
+}
+
+// Read from file f into the cnt buffers in iov,
+// which are at user virtual addresses.
+int
+filereadv(struct file *f, struct iovec *iov, int cnt)
+{
+  int r = 0;
+
+  if(f->readable == 0)
+    return -1;
+
+  if(f->type == FD_PIPE){
+    r = pipereadv(f->pipe, iov, cnt, f->nonblock);
+  } else if(f->type == FD_SOCK){
+    r = sockread(f->sock, iov, cnt, f->nonblock);
+  } else if(f->type == FD_DEVICE || f->type == FD_INODE){
+    r = rdfile(f, 1, iov, cnt, &f->off);
   } else {
     panic("fileread");
   }
@@ -129,50 +258,26 @@ fileread(struct file *f, uint64 addr, int n)
   return r;
 }
 
-// Write to file f.
-// addr is a user virtual address.
+// Write to file f from the cnt buffers in iov,
+// which are at user virtual addresses.
 int
-filewrite(struct file *f, uint64 addr, int n)
+filewritev(struct file *f, struct iovec *iov, int cnt)
 {
-  int r, ret = 0;
+  int ret = 0, n = 0;
 
   if(f->writable == 0)
     return -1;
 
   if(f->type == FD_PIPE){
-    ret = pipewrite(f->pipe, addr, n);
+    ret = pipewritev(f->pipe, iov, cnt, f->nonblock);
+  } else if(f->type == FD_SOCK){
+    ret = sockwrite(f->sock, iov, cnt, f->nonblock);
   } else if(f->type == FD_DEVICE){
-    if(f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
-      return -1;
-    ret = devsw[f->major].write(1, addr, n);
+    ret = wrfile(f, 1, iov, cnt, &f->off);
   } else if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
-    // this really belongs lower down, since writei()
-    // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
-    int i = 0;
-    while(i < n){
-      int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
-
-      begin_op();
-      ilock(f->ip);
-      if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
-        f->off += r;
-      iunlock(f->ip);
-      end_op();
-
-      if(r != n1){
-        // error from writei
-        break;
-      }
-      i += r;
-    }
-    ret = (i == n ? n : -1);
+    for(int v = 0; v < cnt; v++)
+      n += iov[v].iov_len;
+    ret = (wrfile(f, 1, iov, cnt, &f->off) == n ? n : -1);
   } else {
     panic("filewrite");
   }
@@ -180,3 +285,235 @@ filewrite(struct file *f, uint64 addr, int n)
   return ret;
 }
 
+// Read from file f.
+// addr is a user virtual address.
+int
+fileread(struct file *f, uint64 addr, int n)
+{
+  struct iovec iov;
+
+  if(n < 0)
+    return -1;
+  iov.iov_base = (void*)addr;
+  iov.iov_len = n;
+  return filereadv(f, &iov, 1);
+}
+
+// Write to file f.
+// addr is a user virtual address.
+int
+filewrite(struct file *f, uint64 addr, int n)
+{
+  struct iovec iov;
+
+  if(n < 0)
+    return -1;
+  iov.iov_base = (void*)addr;
+  iov.iov_len = n;
+  return filewritev(f, &iov, 1);
+}
+
+// Read n bytes from inode file f at offset off, without
+// using or moving f->off, into user address addr.
+int
+filepread(struct file *f, uint64 addr, int n, uint off)
+{
+  struct iovec iov;
+
+  if(f->readable == 0 || f->type != FD_INODE || n < 0)
+    return -1;
+  iov.iov_base = (void*)addr;
+  iov.iov_len = n;
+  return rdfile(f, 1, &iov, 1, &off);
+}
+
+// Write n bytes from user address addr to inode file f at
+// offset off, without using or moving f->off.
+int
+filepwrite(struct file *f, uint64 addr, int n, uint off)
+{
+  struct iovec iov;
+
+  if(f->writable == 0 || f->type != FD_INODE || n < 0)
+    return -1;
+  iov.iov_base = (void*)addr;
+  iov.iov_len = n;
+  return wrfile(f, 1, &iov, 1, &off) == n ? n : -1;
+}
+
+// Can f be one end of a splice()?
+static int
+okend(struct file *f)
+{
+  return f->type == FD_PIPE || f->type == FD_INODE || f->type == FD_DEVICE;
+}
+
+// Move up to n bytes from in to out, without copying them to
+// user space and back. One of in and out must be a pipe, and
+// the other a different pipe, an inode or a device. Waits
+// for data in a pipe to read, or for room in a pipe to write,
+// like read() and write(), and moves as much as it can
+// without waiting again. If tee is set, in and out must both
+// be pipes, and the data stays in in as well. Returns the
+// number of bytes moved, 0 at end of file, or -1.
+int
+filesplice(struct file *in, struct file *out, int n, int tee)
+{
+  struct iovec iov[PIPEMAX+1];
+  int avail, room, i, r, cnt;
+  uint m, m1;
+  char *p, *q;
+
+  if(in->readable == 0 || out->writable == 0 || n < 0)
+    return -1;
+  r = 0;
+  if(in->type != FD_PIPE && out->type != FD_PIPE)
+    return -1;
+  if(!okend(in) || !okend(out))
+    return -1;
+  if(tee && (in->type != FD_PIPE || out->type != FD_PIPE))
+    return -1;
+  if(in->type == FD_PIPE && out->type == FD_PIPE && in->pipe == out->pipe)
+    return -1;
+
+  if(out->type != FD_PIPE){
+    // pipe to file: write the pipe's pages to the file.
+    if((avail = pipebegin(in->pipe, 0, 1)) < 0)
+      return -1;
+    if(avail > n)
+      avail = n;
+    for(i = 0, cnt = 0; i < avail; i += m, cnt++){
+      iov[cnt].iov_base = pipeptr(in->pipe, 0, i, &m);
+      if(m > avail - i)
+        m = avail - i;
+      iov[cnt].iov_len = m;
+    }
+    r = wrfile(out, 0, iov, cnt, &out->off);
+    pipeend(in->pipe, 0, r > 0 ? r : 0);
+    if(r < 0)
+      return -1;
+    i = r;
+  } else if(in->type != FD_PIPE){
+    // file to pipe: read the file into the pipe's pages.
+    if((room = pipebegin(out->pipe, 1, 1)) < 0)
+      return -1;
+    if(room > n)
+      room = n;
+    for(i = 0, cnt = 0; i < room; i += m, cnt++){
+      iov[cnt].iov_base = pipeptr(out->pipe, 1, i, &m);
+      if(m > room - i)
+        m = room - i;
+      iov[cnt].iov_len = m;
+    }
+    r = rdfile(in, 0, iov, cnt, &in->off);
+    pipeend(out->pipe, 1, r > 0 ? r : 0);
+    if(r < 0)
+      return -1;
+    i = r;
+  } else {
+    // pipe to pipe. never wait for room in out while holding
+    // in's read end: in's readers would wait too, and two
+    // splices in opposite directions would each hold what the
+    // other waits for. instead let go of in, wait for room in
+    // out alone, and start again.
+    for(;;){
+      if((avail = pipebegin(in->pipe, 0, 1)) <= 0){
+        if(avail == 0)
+          pipeend(in->pipe, 0, 0);  // end of file
+        return avail;
+      }
+      if((room = pipebegin(out->pipe, 1, 0)) != -EAGAIN)
+        break;
+      pipeend(in->pipe, 0, 0);
+      if(pipebegin(out->pipe, 1, 1) < 0)
+        return -1;
+      pipeend(out->pipe, 1, 0);
+    }
+    if(room < 0){
+      pipeend(in->pipe, 0, 0);
+      return -1;
+    }
+    if(avail > n)
+      avail = n;
+    if(avail > room)
+      avail = room;
+    for(i = 0; i < avail; i += m){
+      p = pipeptr(in->pipe, 0, i, &m);
+      q = pipeptr(out->pipe, 1, i, &m1);
+      if(m > m1)
+        m = m1;
+      if(m > avail - i)
+        m = avail - i;
+      memmove(q, p, m);
+    }
+    pipeend(out->pipe, 1, i);
+    pipeend(in->pipe, 0, tee ? 0 : i);
+  }
+  return i;
+}
+
+// Copy up to n bytes from file in to file out, both inodes,
+// at and advancing their offsets, without copying the data
+// through user space. Reads WBMAX blocks at a time into
+// kernel pages, and writes them in one transaction of
+// WBOPBLOCKS blocks, rather than filewrite()'s pieces of a
+// few blocks. Returns the number of bytes copied, 0 at end
+// of file, or -1.
+int
+filecopy(struct file *in, struct file *out, int n)
+{
+  char *pg[WBMAX*BSIZE/PGSIZE];
+  int i, j, r, w, k, full;
+
+  if(in->readable == 0 || out->writable == 0 || n < 0)
+    return -1;
+  if(in->type != FD_INODE || out->type != FD_INODE || in->ip == out->ip)
+    return -1;
+  for(j = 0; j < NELEM(pg); j++){
+    if((pg[j] = kalloc()) == 0){
+      while(j > 0)
+        kfree(pg[--j]);
+      return -1;
+    }
+  }
+
+  for(i = 0; i < n && !myproc()->killed; i += w){
+    ilock(in->ip);
+    for(r = 0; r < n - i && r < WBMAX*BSIZE; r += k){
+      k = min(n - i - r, PGSIZE - r%PGSIZE);
+      k = readi(in->ip, 0, (uint64)pg[r/PGSIZE] + r%PGSIZE, in->off + r, k);
+      if(k <= 0)
+        break;
+    }
+    iunlock(in->ip);
+    if(r == 0)
+      break;
+
+    begin_opn(WBOPBLOCKS);
+    ilock(out->ip);
+    for(w = 0; w < r; w += k){
+      k = min(r - w, PGSIZE - w%PGSIZE);
+      k = writei(out->ip, 0, (uint64)pg[w/PGSIZE] + w%PGSIZE, out->off + w, k);
+      if(k <= 0)
+        break;
+    }
+    full = out->ip->ndelay == NDELAY;
+    iunlock(out->ip);
+    end_opn(WBOPBLOCKS);
+
+    in->off += w;
+    out->off += w;
+    if(full){
+      // write back the delayed blocks to make room.
+      iflush(out->ip);
+    } else if(w != r){
+      // error from writei
+      i = (i + w > 0 ? i + w : -1);
+      break;
+    }
+  }
+
+  for(j = 0; j < NELEM(pg); j++)
+    kfree(pg[j]);
+  return i;
+}
@@ -1,10 +1,12 @@
 struct file {
-  enum { FD_NONE, FD_PIPE, FD_INODE, FD_DEVICE } type;
+  enum { FD_NONE, FD_PIPE, FD_INODE, FD_DEVICE, FD_SOCK } type;
   int ref; // reference count
   char readable;
   char writable;
+  char nonblock;     // O_NONBLOCK
   struct pipe *pipe; // FD_PIPE
   struct inode *ip;  // FD_INODE and FD_DEVICE
+  struct sock *sock; // FD_SOCK
   uint off;          // FD_INODE
   short major;       // FD_DEVICE
 };
@@ -13,11 +15,16 @@ struct file {
 #define minor(dev)  ((dev) & 0xFFFF)
 #define	mkdev(m,n)  ((uint)((m)<<16| (n)))
 
+#define DPP 4  // delayed blocks per page: PGSIZE / BSIZE
+
 // in-memory copy of an inode
 struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *hnext; // itable hash chain
+  struct inode *prev; // itable LRU list, if ref is zero
+  struct inode *next;
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -26,13 +33,33 @@ struct inode {
   short minor;
   short nlink;
   uint size;
-  uint addrs[NDIRECT+1];
+  uint flags;
+  uint addrs[NADDRS];
+
+  struct extent last; // extent bmap() last found; len 0 if none
+  struct buf *ind;    // indirect block bmap() last used, pinned
+  uint indfirst;      // first file block that ind maps
+  uint hint;          // next fit: where to allocate ip's next block
+  uint rstart, rlen;  // blocks reserved for bmap() to use
+
+  uint dsize;         // size on disk; the rest is in delay[]
+  uint ndelay;        // blocks from dsize on with no disk block yet
+  char *delay[NDELAY/DPP]; // their data, DPP blocks per page
 };
 
 // map major device number to device functions.
+// A process in poll() waits for a file by putting one of
+// these on the file's wait queue, a list; see poll.c.
+struct pollent {
+  int *woken;            // set to 1, and woken up, by pollwakeup()
+  struct pollent *next;  // next on the queue
+  struct pollent **q;    // the queue it is on, or 0
+};
+
 struct devsw {
-  int (*read)(int, uint64, int);
-  int (*write)(int, uint64, int);
+  int (*read)(int, uint64, int, int);   // last arg: O_NONBLOCK
+  int (*write)(int, uint64, int, int);
+  int (*poll)(struct pollent*);   // 0 if always ready; see poll.c
 };
 
 extern struct devsw devsw[];
@@ -26,6 +26,9 @@
 // only one device
 struct superblock sb; 
 
+static void agload(int);
+static void wbd(void);
+
 // Read the super block.
 static void
 readsb(int dev, struct superblock *sb)
@@ -43,7 +46,11 @@ fsinit(int dev) {
   readsb(dev, &sb);
   if(sb.magic != FSMAGIC)
     panic("invalid file system");
+  if(sb.inodesize < sizeof(struct dinode) || BSIZE % sb.inodesize != 0)
+    panic("fsinit: inode size");
   initlog(dev, &sb);
+  agload(dev);
+  kthread("wbd", wbd);
 }
 
 // Zero a block.
@@ -52,54 +59,175 @@ bzero(int dev, int bno)
 {
   struct buf *bp;
 
-  bp = bread(dev, bno);
+  bp = bnew(dev, bno);
   memset(bp->data, 0, BSIZE);
   log_write(bp);
   brelse(bp);
 }
 
 // Blocks.
+//
+// The disk is divided into allocation groups of AGSIZE
+// blocks. An in-memory summary records how many blocks of
+// each group are free, and where the group's first free block
+// might be, so that the allocator can skip full groups and
+// the full start of a group without reading the bitmap.
+// A group's summary is protected by the sleep-lock of the
+// bitmap block that holds the group's bits; unlocked reads
+// of nfree are only hints.
+
+#define AGSIZE 1024  // blocks per allocation group; divides BPB
+#define NAG ((FSSIZE + AGSIZE - 1) / AGSIZE)
 
-// Allocate a zeroed disk block.
-static uint
-balloc(uint dev)
+struct {
+  int n;            // number of groups
+  uint nfree[NAG];  // free blocks in each group
+  uint first[NAG];  // no free blocks in the group before this
+} ag;
+
+// Build the allocation group summary from the bitmap.
+static void
+agload(int dev)
 {
-  int b, bi, m;
   struct buf *bp;
+  uint b;
+  int g, bi;
 
+  if(sb.size > FSSIZE)
+    panic("agload: disk too big");
+  ag.n = (sb.size + AGSIZE - 1) / AGSIZE;
   bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
-    bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
+  for(b = 0; b < sb.size; b++){
+    g = b / AGSIZE;
+    if(b % AGSIZE == 0){
+      ag.nfree[g] = 0;
+      ag.first[g] = b + AGSIZE;
+    }
+    if(bp == 0 || bp->blockno != BBLOCK(b, sb)){
+      if(bp)
         brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
+      bp = bread(dev, BBLOCK(b, sb));
+    }
+    bi = b % BPB;
+    if((bp->data[bi/8] & (1 << (bi % 8))) == 0){
+      if(ag.nfree[g]++ == 0)
+        ag.first[g] = b;
+    }
+  }
+  if(bp)
+    brelse(bp);
+}
+
+// First block of the allocation group for inode inum,
+// where a new file starts looking for free blocks, so
+// that files written at the same time don't interleave.
+static uint
+agstart(uint inum)
+{
+  return inum % ag.n * AGSIZE;
+}
+
+// Allocate up to *n (at least 1) contiguous disk blocks,
+// starting with the first free block at or after goal
+// in goal's group or, failing that, in the groups after it.
+// Sets *n to the number allocated, and returns the first.
+// The blocks are not zeroed.
+uint
+balloc_run(uint dev, uint goal, uint *n)
+{
+  struct buf *bp;
+  uint b, end, k;
+  int g, i, bi;
+
+  if(goal >= sb.size)
+    goal = 0;
+  g = goal / AGSIZE;
+  // the last pass looks at goal's group again,
+  // in case its free blocks are all before goal.
+  for(i = 0; i <= ag.n; i++, g = (g + 1) % ag.n, goal = 0){
+    if(ag.nfree[g] == 0)
+      continue;
+    bp = bread(dev, BBLOCK(g * AGSIZE, sb));
+    b = goal > ag.first[g] ? goal : ag.first[g];
+    end = min((g + 1) * AGSIZE, sb.size);
+    for(; b < end; b++){
+      bi = b % BPB;
+      if(bi % 8 == 0 && bp->data[bi/8] == 0xff){
+        b += 7;  // skip a byte's worth of allocated blocks
+        continue;
       }
+      if((bp->data[bi/8] & (1 << (bi % 8))) == 0)
+        break;
+    }
+    if(goal <= ag.first[g] && b > ag.first[g])
+      ag.first[g] = b;
+    if(b >= end){
+      brelse(bp);
+      continue;
+    }
+
+    // mark up to *n free blocks from b on allocated.
+    for(k = 0; k < *n && b + k < end; k++){
+      bi = (b + k) % BPB;
+      if(bp->data[bi/8] & (1 << (bi % 8)))
+        break;
+      bp->data[bi/8] |= 1 << (bi % 8);
     }
+    ag.nfree[g] -= k;
+    if(b == ag.first[g])
+      ag.first[g] = b + k;
+    log_write(bp);
     brelse(bp);
+    *n = k;
+    return b;
   }
   panic("balloc: out of blocks");
 }
 
-// Free a disk block.
-static void
-bfree(int dev, uint b)
+// Allocate a zeroed disk block, preferably goal
+// or the first free block after it.
+uint
+balloc(uint dev, uint goal)
+{
+  uint b, n;
+
+  n = 1;
+  b = balloc_run(dev, goal, &n);
+  bzero(dev, b);
+  return b;
+}
+
+// Free disk blocks b..b+n-1.
+void
+bfree(int dev, uint b, uint n)
 {
   struct buf *bp;
-  int bi, m;
-
-  bp = bread(dev, BBLOCK(b, sb));
-  bi = b % BPB;
-  m = 1 << (bi % 8);
-  if((bp->data[bi/8] & m) == 0)
-    panic("freeing free block");
-  bp->data[bi/8] &= ~m;
-  log_write(bp);
-  brelse(bp);
+  int bi, m, g;
+
+  log_free(b, n);
+  bp = 0;
+  for(; n > 0; n--, b++){
+    if(bp == 0 || bp->blockno != BBLOCK(b, sb)){
+      if(bp){
+        log_write(bp);
+        brelse(bp);
+      }
+      bp = bread(dev, BBLOCK(b, sb));
+    }
+    bi = b % BPB;
+    m = 1 << (bi % 8);
+    if((bp->data[bi/8] & m) == 0)
+      panic("freeing free block");
+    bp->data[bi/8] &= ~m;
+    g = b / AGSIZE;
+    ag.nfree[g]++;
+    if(b < ag.first[g])
+      ag.first[g] = b;
+  }
+  if(bp){
+    log_write(bp);
+    brelse(bp);
+  }
 }
 
 // Inodes.
@@ -117,7 +245,10 @@ bfree(int dev, uint b)
 // to provide a place for synchronizing access
 // to inodes used by multiple processes. The in-memory
 // inodes include book-keeping information that is
-// not stored on disk: ip->ref and ip->valid.
+// not stored on disk: ip->ref and ip->valid. The table
+// also caches inodes that are no longer in use, so that
+// looking them up again (as path names do) needn't read
+// the disk.
 //
 // An inode and its in-memory representation go through a
 // sequence of states before they can be used by the
@@ -127,18 +258,19 @@ bfree(int dev, uint b)
 //   is non-zero. ialloc() allocates, and iput() frees if
 //   the reference and link counts have fallen to zero.
 //
-// * Referencing in table: an entry in the inode table
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
-//   the number of in-memory pointers to the entry (open
-//   files and current directories). iget() finds or
-//   creates a table entry and increments its ref; iput()
-//   decrements ref.
+// * Referencing in table: ip->ref tracks the number of
+//   in-memory pointers to the entry (open files and
+//   current directories). iget() finds or creates a table
+//   entry and increments its ref; iput() decrements ref.
+//   An entry whose ref is zero still holds its inode,
+//   until iget() needs the entry for another one.
 //
 // * Valid: the information (type, size, &c) in an inode
 //   table entry is only correct when ip->valid is 1.
-//   ilock() reads the inode from
-//   the disk and sets ip->valid, while iput() clears
-//   ip->valid if ip->ref has fallen to zero.
+//   ilock() reads the inode from the disk and sets
+//   ip->valid, while iput() clears ip->valid when it
+//   frees the inode, and iget() when it recycles the
+//   entry.
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
@@ -162,32 +294,83 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
+// The table finds entries by hashing (dev, inum). It grows
+// a page of entries at a time, up to NINODE entries; after
+// that, iget() recycles the least recently used entry whose
+// ref is zero.
+//
 // The itable.lock spin-lock protects the allocation of itable
-// entries. Since ip->ref indicates whether an entry is free,
+// entries. Since ip->ref indicates whether an entry is in use,
 // and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold itable.lock while using any of those fields.
+// holds, one must hold itable.lock while using any of those
+// fields, or the hash and LRU links.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
+#define NIHASH 127  // inode hash buckets
+#define IHASH(dev, inum) (((dev) * 31 + (inum)) % NIHASH)
+
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *hash[NIHASH]; // chains through ip->hnext
+  struct inode *free; // entries holding no inode, through hnext
+  int n;              // entries allocated
+
+  // Linked list of entries whose ref is zero, through
+  // prev/next. head.next is most recently used, head.prev
+  // least.
+  struct inode head;
 } itable;
 
+// Files with delayed blocks, oldest first, for the writeback
+// daemon; see "Delayed allocation" below. The list holds a
+// reference to each inode on it. Lock order: itable.lock,
+// then wb.lock.
+struct {
+  struct spinlock lock;
+  int n;
+  struct inode *ip[NDIRTY];
+  uint when[NDIRTY];  // ticks when ip[i] joined the list
+} wb;
+
 void
 iinit()
 {
-  int i = 0;
-  
   initlock(&itable.lock, "itable");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&itable.inode[i].lock, "inode");
-  }
+  itable.head.prev = &itable.head;
+  itable.head.next = &itable.head;
+  initlock(&wb.lock, "wb");
+  dcinit();
+  if(DPP * BSIZE != PGSIZE)
+    panic("iinit: DPP");
 }
 
-static struct inode* iget(uint dev, uint inum);
+static void inddrop(struct inode *ip);
+static int wbadd(struct inode *ip);
+static int wbremove(struct inode *ip);
+static char* dblock(struct inode *ip, uint i);
+static void dtrim(struct inode *ip, uint n);
+
+// Return inode inum in bp, the inode block that holds it.
+static struct dinode*
+dinode(struct buf *bp, uint inum)
+{
+  return (struct dinode*)(bp->data + inum%IPB(sb) * sb.inodesize);
+}
+
+// Set up flags and addrs for an empty file with blocks.
+static void
+imapinit(uint *flags, uint *addrs)
+{
+  memset(addrs, 0, NADDRS*sizeof(uint));
+  *flags = 0;
+  if(sb.features & FS_EXTENTS){
+    *flags = I_EXTENTS;
+    ext_initroot(addrs);
+  }
+}
 
 // Allocate an inode on device dev.
 // Mark it as allocated by  giving it type type.
@@ -201,10 +384,14 @@ ialloc(uint dev, short type)
 
   for(inum = 1; inum < sb.ninodes; inum++){
     bp = bread(dev, IBLOCK(inum, sb));
-    dip = (struct dinode*)bp->data + inum%IPB;
+    dip = dinode(bp, inum);
     if(dip->type == 0){  // a free inode
-      memset(dip, 0, sizeof(*dip));
+      memset(dip, 0, sb.inodesize);
       dip->type = type;
+      if(type == T_FILE && (sb.features & FS_INLINE))
+        dip->flags = I_INLINE;
+      else
+        imapinit(&dip->flags, dip->addrs);
       log_write(bp);   // mark it allocated on the disk
       brelse(bp);
       return iget(dev, inum);
@@ -225,48 +412,98 @@ iupdate(struct inode *ip)
   struct dinode *dip;
 
   bp = bread(ip->dev, IBLOCK(ip->inum, sb));
-  dip = (struct dinode*)bp->data + ip->inum%IPB;
+  dip = dinode(bp, ip->inum);
   dip->type = ip->type;
   dip->major = ip->major;
   dip->minor = ip->minor;
   dip->nlink = ip->nlink;
-  dip->size = ip->size;
-  memmove(dip->addrs, ip->addrs, sizeof(ip->addrs));
+  dip->size = ip->dsize;
+  dip->flags = ip->flags;
+  if((ip->flags & I_INLINE) == 0)
+    memmove(dip->addrs, ip->addrs, sizeof(ip->addrs));
   log_write(bp);
   brelse(bp);
 }
 
+// Take ip, whose ref is zero, off the LRU list.
+static void
+lru_remove(struct inode *ip)
+{
+  ip->next->prev = ip->prev;
+  ip->prev->next = ip->next;
+}
+
+// Take ip out of its hash chain.
+static void
+unhash(struct inode *ip)
+{
+  struct inode **pp;
+
+  for(pp = &itable.hash[IHASH(ip->dev, ip->inum)]; *pp != ip; pp = &(*pp)->hnext)
+    ;
+  *pp = ip->hnext;
+}
+
+// Return an entry holding no inode: a free one, one from
+// a new page of entries, or the least recently used one.
+// Caller holds itable.lock.
+static struct inode*
+ientry(void)
+{
+  struct inode *ip;
+  char *page;
+  int i;
+
+  if(itable.free == 0 && itable.n + PGSIZE/sizeof(*ip) <= NINODE && (page = kalloc()) != 0){
+    memset(page, 0, PGSIZE);
+    for(i = 0; i < PGSIZE/sizeof(*ip); i++){
+      ip = (struct inode*)page + i;
+      initsleeplock(&ip->lock, "inode");
+      ip->hnext = itable.free;
+      itable.free = ip;
+    }
+    itable.n += PGSIZE/sizeof(*ip);
+  }
+  if((ip = itable.free) != 0){
+    itable.free = ip->hnext;
+    return ip;
+  }
+  ip = itable.head.prev;
+  if(ip == &itable.head)
+    panic("iget: no inodes");
+  lru_remove(ip);
+  unhash(ip);
+  return ip;
+}
+
 // Find the inode with number inum on device dev
 // and return the in-memory copy. Does not lock
 // the inode and does not read it from disk.
-static struct inode*
+struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip;
 
   acquire(&itable.lock);
 
   // Is the inode already in the table?
-  empty = 0;
-  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
+  for(ip = itable.hash[IHASH(dev, inum)]; ip != 0; ip = ip->hnext){
+    if(ip->dev == dev && ip->inum == inum){
+      if(ip->ref++ == 0)
+        lru_remove(ip);
       release(&itable.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
   // Recycle an inode entry.
-  if(empty == 0)
-    panic("iget: no inodes");
-
-  ip = empty;
+  ip = ientry();
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->hnext = itable.hash[IHASH(dev, inum)];
+  itable.hash[IHASH(dev, inum)] = ip;
   release(&itable.lock);
 
   return ip;
@@ -298,13 +535,17 @@ ilock(struct inode *ip)
 
   if(ip->valid == 0){
     bp = bread(ip->dev, IBLOCK(ip->inum, sb));
-    dip = (struct dinode*)bp->data + ip->inum%IPB;
+    dip = dinode(bp, ip->inum);
     ip->type = dip->type;
     ip->major = dip->major;
     ip->minor = dip->minor;
     ip->nlink = dip->nlink;
-    ip->size = dip->size;
+    ip->size = ip->dsize = dip->size;
+    ip->flags = dip->flags;
     memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
+    ip->last.len = 0;
+    ip->hint = 0;
+    ip->rlen = 0;
     brelse(bp);
     ip->valid = 1;
     if(ip->type == 0)
@@ -334,6 +575,12 @@ iput(struct inode *ip)
 {
   acquire(&itable.lock);
 
+  if(ip->ref == 2 && ip->valid && ip->nlink == 0 && wbremove(ip)){
+    // the writeback list holds the only other reference,
+    // for ip's delayed blocks, which no one can read now.
+    ip->ref--;
+  }
+
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
     // inode has no links and no other references: truncate and free.
 
@@ -343,6 +590,8 @@ iput(struct inode *ip)
 
     release(&itable.lock);
 
+    if(ip->type == T_DIR)
+      dc_forget(ip->dev, ip->inum);
     itrunc(ip);
     ip->type = 0;
     iupdate(ip);
@@ -353,7 +602,22 @@ iput(struct inode *ip)
     acquire(&itable.lock);
   }
 
+  if(ip->ref == 1)
+    inddrop(ip);
   ip->ref--;
+  if(ip->ref == 0){
+    if(ip->valid){
+      // keep the inode cached, as the most recently used.
+      ip->next = itable.head.next;
+      ip->prev = &itable.head;
+      itable.head.next->prev = ip;
+      itable.head.next = ip;
+    } else {
+      unhash(ip);
+      ip->hnext = itable.free;
+      itable.free = ip;
+    }
+  }
   release(&itable.lock);
 }
 
@@ -368,40 +632,209 @@ iunlockput(struct inode *ip)
 // Inode content
 //
 // The content (data) associated with each inode is stored
-// in blocks on the disk. The first NDIRECT block numbers
-// are listed in ip->addrs[].  The next NINDIRECT blocks are
-// listed in block ip->addrs[NDIRECT].
+// in blocks on the disk. If ip->flags has I_EXTENTS, the
+// blocks are mapped by an extent tree rooted in ip->addrs[];
+// see extent.c. Otherwise the first NDIRECT block numbers
+// are listed in ip->addrs[], the next NINDIRECT blocks are
+// listed in the indirect block ip->addrs[NDIRECT], the next
+// NINDIRECT*NINDIRECT in the indirect blocks listed in the
+// double-indirect block ip->addrs[NDIRECT+1], and so on for
+// the triple-indirect block ip->addrs[NDIRECT+2].
+//
+// ip->ind holds a reference to the last indirect block that
+// listed data blocks for bmap(), so that the next bmap() for a
+// nearby block can lock it without searching the buffer cache,
+// or walking down from a double- or triple-indirect block.
 
-// Return the disk block address of the nth block in inode ip.
+// Forget ip->ind.
+static void
+inddrop(struct inode *ip)
+{
+  if(ip->ind){
+    bunpin(ip->ind);
+    ip->ind = 0;
+  }
+}
+
+static uint bmap(struct inode *ip, uint bn, uint *run);
+
+// Where to look for a free block for ip: just past the
+// last block allocated to it (next fit), or past its last
+// block, or, for an empty file, in its allocation group.
+// Calls bmap(), so bmap() itself must not call igoal().
+static uint
+igoal(struct inode *ip)
+{
+  uint run;
+
+  if(ip->hint == 0){
+    if(ip->dsize > 0)
+      ip->hint = bmap(ip, (ip->dsize - 1) / BSIZE, &run) + 1;
+    else
+      ip->hint = agstart(ip->inum);
+  }
+  return ip->hint;
+}
+
+// Reserve n blocks for bmap() to give to ip, all at
+// once and contiguous if possible.
+static void
+reserve(struct inode *ip, uint n)
+{
+  ip->rstart = balloc_run(ip->dev, igoal(ip), &n);
+  ip->rlen = n;
+}
+
+// Free the reserved blocks that bmap() didn't use.
+static void
+unreserve(struct inode *ip)
+{
+  if(ip->rlen > 0){
+    bfree(ip->dev, ip->rstart, ip->rlen);
+    ip->rlen = 0;
+  }
+}
+
+// Allocate a data block for ip: the next of the blocks
+// reserved for it, if any are left, or else a new zeroed
+// block at or after goal (or ip's hint, if goal is 0).
+uint
+dalloc(struct inode *ip, uint goal)
+{
+  uint b;
+
+  if(ip->rlen > 0){
+    b = ip->rstart++;
+    ip->rlen--;
+  } else {
+    if(goal == 0)
+      goal = ip->hint ? ip->hint : agstart(ip->inum);
+    b = balloc(ip->dev, goal);
+  }
+  ip->hint = b + 1;
+  return b;
+}
+
+// Return the disk block address of the nth block in inode ip,
+// and set *run to the number of blocks from there on known to
+// be contiguous on disk (at least 1).
 // If there is no such block, bmap allocates one.
 static uint
-bmap(struct inode *ip, uint bn)
+bmap(struct inode *ip, uint bn, uint *run)
 {
-  uint addr, *a;
+  uint addr, *a, n, base, first, div;
   struct buf *bp;
+  int level, l;
+
+  if(ip->flags & I_INLINE)
+    panic("bmap: inline");
+  if(ip->flags & I_EXTENTS)
+    return ext_bmap(ip, bn, run);
+  *run = 1;
 
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
+      ip->addrs[bn] = addr = dalloc(ip, 0);
     return addr;
   }
   bn -= NDIRECT;
-
-  if(bn < NINDIRECT){
-    // Load indirect block, allocating if necessary.
-    if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
+  base = NDIRECT;
+
+  // single (level 0), double (1) or triple (2) indirect?
+  for(level = 0, n = NINDIRECT; bn >= n; level++){
+    if(level == 2)
+      panic("bmap: out of range");
+    bn -= n;
+    base += n;
+    n *= NINDIRECT;
+  }
+  // the indirect block that lists the data block
+  // maps file blocks from first on.
+  first = base + bn - bn % NINDIRECT;
+
+  if(ip->ind && ip->indfirst == first){
+    bp = bacquire(ip->ind);
+  } else {
+    // Load indirect blocks, allocating if necessary.
+    if((addr = ip->addrs[NDIRECT+level]) == 0)
+      ip->addrs[NDIRECT+level] = addr = balloc(ip->dev, ip->hint);
+    for(l = level; l > 0; l--){
+      for(div = 1, n = 0; n < l; n++)
+        div *= NINDIRECT;
+      bp = bread(ip->dev, addr);
+      a = (uint*)bp->data;
+      if((addr = a[bn / div % NINDIRECT]) == 0){
+        a[bn / div % NINDIRECT] = addr = balloc(ip->dev, ip->hint);
+        log_write(bp);
+      }
+      brelse(bp);
+    }
     bp = bread(ip->dev, addr);
-    a = (uint*)bp->data;
-    if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
-      log_write(bp);
+    inddrop(ip);
+    bpin(bp);
+    ip->ind = bp;
+    ip->indfirst = first;
+  }
+  a = (uint*)bp->data;
+  if((addr = a[bn % NINDIRECT]) == 0){
+    a[bn % NINDIRECT] = addr = dalloc(ip, 0);
+    log_write(bp);
+  }
+  brelse(bp);
+  return addr;
+}
+
+// Free indirect block addr and the blocks it lists,
+// which are themselves indirect if level > 0.
+static void
+indfree(struct inode *ip, uint addr, int level)
+{
+  struct buf *bp;
+  uint *a, start, n;
+  int j;
+
+  bp = bread(ip->dev, addr);
+  a = (uint*)bp->data;
+  start = n = 0;
+  for(j = 0; j < NINDIRECT; j++){
+    if(a[j] == 0)
+      continue;
+    if(level > 0){
+      indfree(ip, a[j], level-1);
+    } else if(n > 0 && a[j] == start + n){
+      n++;
+    } else {
+      // free data blocks a run at a time.
+      if(n > 0)
+        bfree(ip->dev, start, n);
+      start = a[j];
+      n = 1;
     }
-    brelse(bp);
-    return addr;
   }
+  if(n > 0)
+    bfree(ip->dev, start, n);
+  brelse(bp);
+  bfree(ip->dev, addr, 1);
+}
 
-  panic("bmap: out of range");
+// Number of indirect blocks at or below addr.
+static uint
+indcount(struct inode *ip, uint addr, int level)
+{
+  struct buf *bp;
+  uint *a, n;
+  int j;
+
+  if(level == 0)
+    return 1;
+  n = 1;
+  bp = bread(ip->dev, addr);
+  a = (uint*)bp->data;
+  for(j = 0; j < NINDIRECT; j++)
+    if(a[j])
+      n += indcount(ip, a[j], level-1);
+  brelse(bp);
+  return n;
 }
 
 // Truncate inode (discard contents).
@@ -409,30 +842,39 @@ bmap(struct inode *ip, uint bn)
 void
 itrunc(struct inode *ip)
 {
-  int i, j;
-  struct buf *bp;
-  uint *a;
+  int i;
+
+  dtrim(ip, 0);
+  if(ip->flags & I_INLINE){
+    ip->size = ip->dsize = 0;
+    iupdate(ip);
+    return;
+  }
+  if(ip->flags & I_EXTENTS){
+    ext_trunc(ip);
+    goto out;
+  }
 
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
-      bfree(ip->dev, ip->addrs[i]);
+      bfree(ip->dev, ip->addrs[i], 1);
       ip->addrs[i] = 0;
     }
   }
 
-  if(ip->addrs[NDIRECT]){
-    bp = bread(ip->dev, ip->addrs[NDIRECT]);
-    a = (uint*)bp->data;
-    for(j = 0; j < NINDIRECT; j++){
-      if(a[j])
-        bfree(ip->dev, a[j]);
+  inddrop(ip);
+  for(i = 0; i < 3; i++){
+    if(ip->addrs[NDIRECT+i]){
+      indfree(ip, ip->addrs[NDIRECT+i], i);
+      ip->addrs[NDIRECT+i] = 0;
     }
-    brelse(bp);
-    bfree(ip->dev, ip->addrs[NDIRECT]);
-    ip->addrs[NDIRECT] = 0;
   }
 
-  ip->size = 0;
+out:
+  // an empty file can be inline again.
+  if(ip->type == T_FILE && (sb.features & FS_INLINE))
+    ip->flags = I_INLINE;
+  ip->size = ip->dsize = 0;
   iupdate(ip);
 }
 
@@ -441,11 +883,34 @@ itrunc(struct inode *ip)
 void
 stati(struct inode *ip, struct stat *st)
 {
+  uint bn, addr, run, prev;
+
   st->dev = ip->dev;
   st->ino = ip->inum;
   st->type = ip->type;
   st->nlink = ip->nlink;
   st->size = ip->size;
+
+  // count the runs of contiguous disk blocks.
+  st->nextent = 0;
+  st->nmeta = 0;
+  if(ip->flags & I_INLINE)
+    return;
+  prev = 0;
+  for(bn = 0; bn < (ip->dsize + BSIZE - 1) / BSIZE; bn += run){
+    addr = bmap(ip, bn, &run);
+    if(addr != prev)
+      st->nextent++;
+    prev = addr + run;
+  }
+
+  if(ip->flags & I_EXTENTS){
+    st->nmeta = ext_nmeta(ip);
+    return;
+  }
+  for(int i = 0; i < 3; i++)
+    if(ip->addrs[NDIRECT+i])
+      st->nmeta += indcount(ip, ip->addrs[NDIRECT+i], i);
 }
 
 // Read data from inode.
@@ -455,7 +920,7 @@ stati(struct inode *ip, struct stat *st)
 int
 readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, bn, addr, run, ra, dfirst;
   struct buf *bp;
 
   if(off > ip->size || off + n < off)
@@ -463,9 +928,37 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
   if(off + n > ip->size)
     n = ip->size - off;
 
+  if(ip->flags & I_INLINE){
+    bp = bread(ip->dev, IBLOCK(ip->inum, sb));
+    tot = either_copyout(user_dst, dst, (char*)dinode(bp, ip->inum)->addrs + off, n);
+    brelse(bp);
+    return tot == -1 ? -1 : n;
+  }
+
+  ra = 0;  // blocks before ra have been read ahead
+  dfirst = (ip->dsize + BSIZE - 1) / BSIZE;
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+    bn = off/BSIZE;
     m = min(n - tot, BSIZE - off%BSIZE);
+    if(bn >= dfirst){
+      // a delayed block, not on the disk yet.
+      if(either_copyout(user_dst, dst, dblock(ip, bn - dfirst) + off%BSIZE, m) == -1){
+        tot = -1;
+        break;
+      }
+      continue;
+    }
+    addr = bmap(ip, bn, &run);
+    if(bn >= ra && run > 1){
+      // fetch the blocks of this read that are contiguous
+      // with this one in a single disk request.
+      run = min(run, (off + n - tot - 1)/BSIZE - bn + 1);
+      run = min(run, NREADAHEAD);
+      if(run > 1)
+        breadahead(ip->dev, addr, run);
+      ra = bn + run;
+    }
+    bp = bread(ip->dev, addr);
     if(either_copyout(user_dst, dst, bp->data + (off % BSIZE), m) == -1) {
       brelse(bp);
       tot = -1;
@@ -476,47 +969,396 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
   return tot;
 }
 
+// Write n bytes at off to inline file ip, where they fit.
+static int
+iwrite_inline(struct inode *ip, int user_src, uint64 src, uint off, uint n)
+{
+  struct buf *bp;
+
+  bp = bread(ip->dev, IBLOCK(ip->inum, sb));
+  if(either_copyin((char*)dinode(bp, ip->inum)->addrs + off, user_src, src, n) == -1){
+    brelse(bp);
+    return -1;
+  }
+  log_write(bp);
+  brelse(bp);
+  if(off + n > ip->size)
+    ip->size = ip->dsize = off + n;
+  iupdate(ip);
+  return n;
+}
+
+// Move the data of inline file ip, which is about to grow
+// too big for the inode, to its first block. The block goes
+// to the disk now rather than waiting for writeback, so that
+// the data on the disk is never lost in between.
+static void
+iunline(struct inode *ip)
+{
+  struct buf *bp, *ibp;
+  uint addr, run;
+
+  imapinit(&ip->flags, ip->addrs);
+  if(ip->size > 0){
+    // igoal() would look for the file's last block.
+    if(ip->hint == 0)
+      ip->hint = agstart(ip->inum);
+    reserve(ip, 1);
+    addr = bmap(ip, 0, &run);
+    unreserve(ip);
+    bp = bnew(ip->dev, addr);
+    memset(bp->data, 0, BSIZE);
+    ibp = bread(ip->dev, IBLOCK(ip->inum, sb));
+    memmove(bp->data, dinode(ibp, ip->inum)->addrs, ip->size);
+    brelse(ibp);
+    log_data(bp);
+    brelse(bp);
+  }
+  iupdate(ip);
+}
+
 // Write data to inode.
 // Caller must hold ip->lock.
 // If user_src==1, then src is a user virtual address;
 // otherwise, src is a kernel address.
 // Returns the number of bytes successfully written.
 // If the return value is less than the requested n,
-// there was an error of some kind.
+// there was an error of some kind, or ip has as many
+// delayed blocks as it can hold (ip->ndelay == NDELAY),
+// and the caller should iflush() it and write the rest.
 int
 writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, run, bn, addr, osize, odsize, dfirst, nb;
   struct buf *bp;
+  char *d;
+  int delay;
 
   if(off > ip->size || off + n < off)
     return -1;
   if(off + n > MAXFILE*BSIZE)
     return -1;
 
+  if(ip->flags & I_INLINE){
+    if(off + n <= INLINESZ(sb))
+      return iwrite_inline(ip, user_src, src, off, n);
+    iunline(ip);
+  }
+
+  // blocks from dfirst on have no disk blocks, if they
+  // exist at all. file data in new blocks waits for
+  // writeback to give it disk blocks; other new blocks
+  // are reserved all at once, contiguous if possible,
+  // for bmap().
+  osize = ip->size;
+  odsize = ip->dsize;
+  dfirst = (odsize + BSIZE - 1) / BSIZE;
+  nb = (off + n + BSIZE - 1) / BSIZE;
+  delay = 0;
+  if(nb > dfirst){
+    if(ip->type == T_FILE && wbadd(ip))
+      delay = 1;
+    else
+      reserve(ip, nb - dfirst);
+  }
+
+  // file data goes to the disk in place, in one batch.
+  blk_plug();
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+    bn = off/BSIZE;
     m = min(n - tot, BSIZE - off%BSIZE);
+    if(delay && bn >= dfirst){
+      if((d = dblock(ip, bn - dfirst)) == 0)
+        break;
+      if(either_copyin(d + off%BSIZE, user_src, src, m) == -1)
+        break;
+      continue;
+    }
+    addr = bmap(ip, bn, &run);
+    if(bn*BSIZE >= osize){
+      // no part of the file is in this block yet, so
+      // there is no need to read it from the disk.
+      bp = bnew(ip->dev, addr);
+      if(m < BSIZE)
+        memset(bp->data, 0, BSIZE);
+    } else {
+      bp = bread(ip->dev, addr);
+    }
     if(either_copyin(bp->data + (off % BSIZE), user_src, src, m) == -1) {
       brelse(bp);
       break;
     }
-    log_write(bp);
+    if(ip->type == T_FILE)
+      log_data(bp);
+    else
+      log_write(bp);
     brelse(bp);
   }
+  blk_unplug();
+
+  unreserve(ip);
 
   if(off > ip->size)
     ip->size = off;
+  if(delay){
+    // drop a new delayed block that the write failed to fill.
+    nb = (ip->size + BSIZE - 1) / BSIZE - dfirst;
+    if(ip->ndelay > nb)
+      dtrim(ip, nb);
+  }
+  ip->dsize = ip->ndelay > 0 ? dfirst * BSIZE : ip->size;
 
   // write the i-node back to disk even if the size didn't change
   // because the loop above might have called bmap() and added a new
-  // block to ip->addrs[].
-  iupdate(ip);
+  // block to ip->addrs[] (or changed the extent tree root there).
+  // writes to delayed blocks alone change nothing on disk.
+  if(!delay || ip->dsize != odsize)
+    iupdate(ip);
 
   return tot;
 }
 
+// Delayed allocation.
+//
+// Data written past the end of a file's disk blocks doesn't
+// get disk blocks right away. writei() keeps it in memory, in
+// whole pages of "delayed blocks" hanging off the inode, and
+// ip->dsize, the size recorded on disk, stays short of it.
+// Later, the writeback daemon, wbd, gives the delayed blocks
+// disk blocks, all at once, so that they are contiguous, and
+// writes them in place (iflush()). Until then, writes
+// to the delayed blocks cost no disk I/O at all, and a file
+// deleted before writeback never goes to the disk. A crash
+// loses delayed data that no fsync() or sync() has written,
+// but the file system on disk stays consistent.
+//
+// An inode with delayed blocks is on the writeback list,
+// which keeps it in the inode table. wbd writes back a
+// file's blocks once they have waited WBDELAY ticks, or as
+// soon as it can when the list is full, in which case new
+// files get their blocks from writei() as before. A file
+// with NDELAY delayed blocks must be written back before
+// writei() will take more.
+
+// Put ip on the writeback list, with a reference, unless it
+// is already there. Returns 0 if the list is full.
+// Caller holds ip->lock.
+static int
+wbadd(struct inode *ip)
+{
+  int i;
+
+  acquire(&wb.lock);
+  for(i = 0; i < wb.n; i++){
+    if(wb.ip[i] == ip){
+      release(&wb.lock);
+      return 1;
+    }
+  }
+  release(&wb.lock);
+
+  // only writei(), with ip->lock held, adds ip, so it can't
+  // join the list while wb.lock is released here.
+  idup(ip);
+  acquire(&wb.lock);
+  if(wb.n == NDIRTY){
+    release(&wb.lock);
+    iput(ip);  // not the last reference
+    return 0;
+  }
+  wb.ip[wb.n] = ip;
+  wb.when[wb.n] = ticks;
+  wb.n++;
+  release(&wb.lock);
+  return 1;
+}
+
+// Take ip off the writeback list. Returns 1 if it was
+// there, and the caller now owns the list's reference.
+static int
+wbremove(struct inode *ip)
+{
+  int i;
+
+  acquire(&wb.lock);
+  for(i = 0; i < wb.n; i++){
+    if(wb.ip[i] == ip){
+      wb.n--;
+      memmove(&wb.ip[i], &wb.ip[i+1], (wb.n - i) * sizeof(wb.ip[0]));
+      memmove(&wb.when[i], &wb.when[i+1], (wb.n - i) * sizeof(wb.when[0]));
+      release(&wb.lock);
+      return 1;
+    }
+  }
+  release(&wb.lock);
+  return 0;
+}
+
+// Return the data of ip's delayed block i (file block
+// dsize/BSIZE + i), adding a zeroed block if i is
+// ip->ndelay. Returns 0 if ip can't have another.
+// Caller holds ip->lock.
+static char*
+dblock(struct inode *ip, uint i)
+{
+  if(i == ip->ndelay){
+    if(i >= NDELAY)
+      return 0;
+    if(i % DPP == 0 && (ip->delay[i/DPP] = kalloc()) == 0)
+      return 0;
+    memset(ip->delay[i/DPP] + i%DPP*BSIZE, 0, BSIZE);
+    ip->ndelay++;
+  }
+  return ip->delay[i/DPP] + i%DPP*BSIZE;
+}
+
+// Discard ip's delayed blocks from the nth on.
+static void
+dtrim(struct inode *ip, uint n)
+{
+  uint i;
+
+  for(i = (n + DPP - 1) / DPP; i < (ip->ndelay + DPP - 1) / DPP; i++){
+    kfree(ip->delay[i]);
+    ip->delay[i] = 0;
+  }
+  ip->ndelay = n;
+}
+
+// Give the first WBMAX (a multiple of DPP) of ip's delayed
+// blocks disk blocks, and write them in place.
+// Returns the number of delayed blocks left.
+// Caller holds ip->lock and is in a writeback op.
+static uint
+dflush(struct inode *ip)
+{
+  uint dfirst, k, i, run, addr;
+  struct buf *bp;
+
+  if(ip->ndelay == 0)
+    return 0;
+  dfirst = ip->dsize / BSIZE;
+  k = min(ip->ndelay, WBMAX);
+  reserve(ip, k);
+  blk_plug();
+  for(i = 0; i < k; i++){
+    addr = bmap(ip, dfirst + i, &run);
+    bp = bnew(ip->dev, addr);
+    memmove(bp->data, ip->delay[i/DPP] + i%DPP*BSIZE, BSIZE);
+    log_data(bp);
+    brelse(bp);
+  }
+  blk_unplug(); // the data, before the commit of its metadata
+  unreserve(ip);
+
+  if(k == ip->ndelay){
+    dtrim(ip, 0);
+    ip->dsize = ip->size;
+  } else {
+    for(i = 0; i < k / DPP; i++)
+      kfree(ip->delay[i]);
+    memmove(ip->delay, ip->delay + k/DPP, (NDELAY/DPP - k/DPP) * sizeof(ip->delay[0]));
+    ip->ndelay -= k;
+    ip->dsize += k * BSIZE;
+  }
+  iupdate(ip);
+  return ip->ndelay;
+}
+
+// Write ip's delayed blocks to disk, a transaction at a time,
+// and take ip off the writeback list. Blocks that other
+// processes delay meanwhile may be left for later.
+// The caller must hold a reference to ip, but not ip->lock,
+// and must not be in a transaction.
+void
+iflush(struct inode *ip)
+{
+  int i, left, put;
+
+  for(i = 0; i <= NDELAY/WBMAX; i++){
+    begin_opn(WBOPBLOCKS);
+    ilock(ip);
+    left = dflush(ip);
+    put = left == 0 && wbremove(ip);
+    iunlock(ip);
+    if(put)
+      iput(ip);  // the list's reference
+    end_opn(WBOPBLOCKS);
+    if(left == 0)
+      break;
+  }
+}
+
+// Write back the delayed blocks of every file, for sync().
+void
+wbsync(void)
+{
+  struct inode *ip[NDIRTY];
+  int i, n;
+
+  acquire(&itable.lock);
+  acquire(&wb.lock);
+  n = wb.n;
+  for(i = 0; i < n; i++){
+    ip[i] = wb.ip[i];
+    ip[i]->ref++;
+  }
+  release(&wb.lock);
+  release(&itable.lock);
+
+  for(i = 0; i < n; i++){
+    iflush(ip[i]);
+    begin_op();
+    iput(ip[i]);
+    end_op();
+  }
+}
+
+// The writeback daemon: writes back the delayed blocks of
+// the file that has been on the list the longest, once they
+// have waited WBDELAY ticks, or right away if the list is full.
+static void
+wbd(void)
+{
+  struct inode *ip;
+
+  for(;;){
+    acquire(&itable.lock);
+    acquire(&wb.lock);
+    if(wb.n == 0 || ticks - wb.when[0] < (wb.n == NDIRTY ? 1 : WBDELAY)){
+      release(&itable.lock);
+      // clockintr() doesn't hold wb.lock, so a wakeup
+      // might be missed, which just delays writeback.
+      sleep(&ticks, &wb.lock);
+      release(&wb.lock);
+      continue;
+    }
+    // move ip to the end of the list, in case others
+    // delay more of its blocks while it is written.
+    ip = wb.ip[0];
+    ip->ref++;
+    memmove(&wb.ip[0], &wb.ip[1], (wb.n - 1) * sizeof(wb.ip[0]));
+    memmove(&wb.when[0], &wb.when[1], (wb.n - 1) * sizeof(wb.when[0]));
+    wb.ip[wb.n-1] = ip;
+    wb.when[wb.n-1] = ticks;
+    release(&wb.lock);
+    release(&itable.lock);
+
+    iflush(ip);
+    begin_op();
+    iput(ip);
+    end_op();
+  }
+}
+
 // Directories
+//
+// Directories are read and written a block at a time,
+// through the buffer cache rather than readi()/writei(). A
+// directory of one block is searched linearly; one that
+// outgrows it gets a hash index (I_INDEX; see fs.h), so that
+// finding a name, or room for one, reads one or two index
+// blocks and one leaf.
 
 int
 namecmp(const char *s, const char *t)
@@ -524,41 +1366,467 @@ namecmp(const char *s, const char *t)
   return strncmp(s, t, DIRSIZ);
 }
 
+// Length of name, which is NUL-terminated if it is shorter
+// than DIRSIZ.
+static int
+namelen(char *name)
+{
+  int n;
+
+  for(n = 0; n < DIRSIZ && name[n]; n++)
+    ;
+  return n;
+}
+
+static int
+isdots(char *name, int n)
+{
+  return (n == 1 || n == 2) && name[0] == '.' && name[n-1] == '.';
+}
+
+// FNV-1a hash of the n bytes of name; mkfs has a copy.
+static uint
+dxhash(char *name, int n)
+{
+  uint h = 2166136261U;
+  int i;
+
+  for(i = 0; i < n; i++){
+    h ^= (uchar)name[i];
+    h *= 16777619;
+  }
+  return h;
+}
+
+// The entry at offset off of directory block data.
+static struct dirent*
+dirat(uchar *data, uint off)
+{
+  struct dirent *de = (struct dirent*)(data + off);
+
+  if(de->reclen < DIRLEN(0) || de->reclen % 4 != 0 || off + de->reclen > BSIZE ||
+     (de->inum != 0 && de->reclen < DIRLEN(de->namelen)))
+    panic("dirat");
+  return de;
+}
+
+// Return a locked buf with block bn of directory dp.
+static struct buf*
+dirblock(struct inode *dp, uint bn)
+{
+  uint run;
+
+  return bread(dp->dev, bmap(dp, bn, &run));
+}
+
+// Add a block to the end of directory dp, holding one free
+// entry. Returns its number, and the locked buf in *bpp.
+static uint
+dirgrow(struct inode *dp, struct buf **bpp)
+{
+  uint bn, run;
+  struct buf *bp;
+
+  bn = dp->size / BSIZE;
+  bp = bnew(dp->dev, bmap(dp, bn, &run));
+  memset(bp->data, 0, BSIZE);
+  ((struct dirent*)bp->data)->reclen = BSIZE;
+  log_write(bp);
+  dp->size = dp->dsize = (bn + 1) * BSIZE;
+  iupdate(dp);
+  *bpp = bp;
+  return bn;
+}
+
+// Return the offset of the entry for the n bytes of name in
+// directory block bp, or -1.
+static int
+dirfind(struct buf *bp, char *name, int n)
+{
+  struct dirent *de;
+  uint off;
+
+  for(off = 0; off < BSIZE; off += de->reclen){
+    de = dirat(bp->data, off);
+    if(de->inum != 0 && de->namelen == n && memcmp(de->name, name, n) == 0)
+      return off;
+  }
+  return -1;
+}
+
+// Put the entry (name, inum) in directory block bp, in a
+// free entry or the spare room of a used one. Returns 0 if
+// there isn't room.
+static int
+dirput(struct buf *bp, char *name, int n, uint inum)
+{
+  struct dirent *de, *ne;
+  uint off, len, rest;
+
+  for(off = 0; off < BSIZE; off += de->reclen){
+    de = dirat(bp->data, off);
+    len = de->inum ? DIRLEN(de->namelen) : 0;
+    if(de->reclen - len >= DIRLEN(n)){
+      ne = (struct dirent*)(bp->data + off + len);
+      rest = de->reclen - len;
+      de->reclen = len;   // if ne == de, set again below
+      ne->inum = inum;
+      ne->reclen = rest;
+      ne->namelen = n;
+      ne->pad = 0;
+      memmove(ne->name, name, n);
+      log_write(bp);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// The header of index block bp, block bn of its directory.
+static struct dxhead*
+dxhead(struct buf *bp, uint bn)
+{
+  struct dxhead *h;
+
+  h = (struct dxhead*)(bp->data + (bn == 0 ? DX_DOTS : 0));
+  if(h->magic != DX_MAGIC)
+    panic("dxhead");
+  return h;
+}
+
+// The entry in index block h that covers hash.
+static int
+dxsearch(struct dxhead *h, uint hash)
+{
+  struct dxentry *e = (struct dxentry*)(h + 1);
+  int i;
+
+  for(i = 1; i < h->n && e[i].hash <= hash; i++)
+    ;
+  return i - 1;
+}
+
+// Find the leaf of indexed directory dp for hash. Sets
+// *node to the index block that points to the leaf (0, the
+// root, unless the index has two levels), and returns the
+// leaf's block number.
+static uint
+dxfind(struct inode *dp, uint hash, uint *node)
+{
+  struct buf *bp;
+  struct dxhead *h;
+  uint bn;
+  int levels;
+
+  bp = dirblock(dp, 0);
+  h = dxhead(bp, 0);
+  levels = h->levels;
+  bn = ((struct dxentry*)(h + 1))[dxsearch(h, hash)].block;
+  brelse(bp);
+  *node = 0;
+  if(levels > 0){
+    *node = bn;
+    bp = dirblock(dp, bn);
+    h = dxhead(bp, bn);
+    bn = ((struct dxentry*)(h + 1))[dxsearch(h, hash)].block;
+    brelse(bp);
+  }
+  return bn;
+}
+
+// Add an entry for hash, pointing to block bn, to index
+// block bp (block node), which has room.
+static void
+dxinsert(struct buf *bp, uint node, uint hash, uint bn)
+{
+  struct dxhead *h = dxhead(bp, node);
+  struct dxentry *e = (struct dxentry*)(h + 1);
+  int i;
+
+  i = dxsearch(h, hash) + 1;
+  memmove(&e[i+1], &e[i], (h->n - i) * sizeof(*e));
+  e[i].hash = hash;
+  e[i].block = bn;
+  h->n++;
+  log_write(bp);
+}
+
+// Make room in index block node of dp: move the root's
+// entries down to a new node, or split a full node in two.
+// Returns -1 if the index can't grow.
+static int
+dxgrow(struct inode *dp, uint node)
+{
+  struct buf *rbp, *bp, *nbp;
+  struct dxhead *rh, *h, *nh;
+  struct dxentry *re, *e, *ne;
+  uint nbn;
+  int k;
+
+  rbp = dirblock(dp, 0);
+  rh = dxhead(rbp, 0);
+  re = (struct dxentry*)(rh + 1);
+  if(node == 0){
+    // a second level: the root's entries go to a new node.
+    nbn = dirgrow(dp, &nbp);
+    nh = (struct dxhead*)nbp->data;
+    ne = (struct dxentry*)(nh + 1);
+    *nh = *rh;
+    nh->reclen = BSIZE;
+    nh->levels = 0;
+    nh->max = DX_NODE;
+    memmove(ne, re, rh->n * sizeof(*re));
+    log_write(nbp);
+    brelse(nbp);
+    rh->levels = 1;
+    rh->n = 1;
+    memset(re, 0, DX_ROOT * sizeof(*re));
+    re[0].block = nbn;
+    log_write(rbp);
+    brelse(rbp);
+    return 0;
+  }
+  if(rh->n == rh->max){
+    brelse(rbp);
+    return -1;
+  }
+
+  // split the node; the upper half goes to a new one.
+  bp = dirblock(dp, node);
+  h = dxhead(bp, node);
+  e = (struct dxentry*)(h + 1);
+  nbn = dirgrow(dp, &nbp);
+  nh = (struct dxhead*)nbp->data;
+  ne = (struct dxentry*)(nh + 1);
+  k = h->n / 2;
+  *nh = *h;
+  nh->n = h->n - k;
+  memmove(ne, &e[k], nh->n * sizeof(*e));
+  memset(&e[k], 0, nh->n * sizeof(*e));
+  h->n = k;
+  log_write(bp);
+  log_write(nbp);
+  dxinsert(rbp, 0, ne[0].hash, nbn);
+  brelse(nbp);
+  brelse(bp);
+  brelse(rbp);
+  return 0;
+}
+
+// The entries of a directory block, sorted by hash, for
+// dxinit() and dxsplit() to rearrange. Too big for the
+// stack; lives in a page from kalloc().
+struct dxsort {
+  uchar data[BSIZE];  // copy of the block
+  int n;
+  struct {
+    uint hash;
+    ushort off;       // in data
+  } e[BSIZE / DIRLEN(1)];
+};
+
+// Fill s with the entries of bp but "." and "..".
+static void
+dxsort(struct dxsort *s, struct buf *bp)
+{
+  struct dirent *de;
+  uint off, h;
+  int i;
+
+  memmove(s->data, bp->data, BSIZE);
+  s->n = 0;
+  for(off = 0; off < BSIZE; off += de->reclen){
+    de = dirat(s->data, off);
+    if(de->inum == 0 || isdots(de->name, de->namelen))
+      continue;
+    h = dxhash(de->name, de->namelen);
+    for(i = s->n++; i > 0 && s->e[i-1].hash > h; i--)
+      s->e[i] = s->e[i-1];
+    s->e[i].hash = h;
+    s->e[i].off = off;
+  }
+}
+
+// Write entries i..j-1 of s to data, packed, as a whole
+// directory block.
+static void
+dxpack(struct dxsort *s, int i, int j, uchar *data)
+{
+  struct dirent *de, *src;
+  uint off;
+
+  memset(data, 0, BSIZE);
+  de = (struct dirent*)data;
+  for(off = 0; i < j; i++){
+    src = (struct dirent*)(s->data + s->e[i].off);
+    de = (struct dirent*)(data + off);
+    memmove(de, src, DIRLEN(src->namelen));
+    de->reclen = DIRLEN(src->namelen);
+    off += de->reclen;
+  }
+  // the last entry gets the rest of the block.
+  de->reclen += BSIZE - off;
+}
+
+// Split full leaf bn of dp, whose entry is in index block
+// node, which has room: the entries with the higher hashes,
+// about half the bytes, move to a new leaf. Returns -1 if
+// all the entries have the same hash.
+static int
+dxsplit(struct inode *dp, uint node, uint bn)
+{
+  struct dxsort *s;
+  struct buf *bp, *nbp, *ibp;
+  struct dirent *de;
+  uint nbn, sum, half, best;
+  int i, k;
+
+  if((s = (struct dxsort*)kalloc()) == 0)
+    return -1;
+  bp = dirblock(dp, bn);
+  dxsort(s, bp);
+
+  // split between different hashes, as near half as possible.
+  sum = 0;
+  for(i = 0; i < s->n; i++)
+    sum += DIRLEN(((struct dirent*)(s->data + s->e[i].off))->namelen);
+  half = sum / 2;
+  best = sum;
+  k = -1;
+  sum = 0;
+  for(i = 1; i < s->n; i++){
+    de = (struct dirent*)(s->data + s->e[i-1].off);
+    sum += DIRLEN(de->namelen);
+    if(s->e[i].hash != s->e[i-1].hash && (sum > half ? sum - half : half - sum) < best){
+      best = sum > half ? sum - half : half - sum;
+      k = i;
+    }
+  }
+  if(k < 0){
+    brelse(bp);
+    kfree(s);
+    return -1;
+  }
+
+  nbn = dirgrow(dp, &nbp);
+  dxpack(s, 0, k, bp->data);
+  dxpack(s, k, s->n, nbp->data);
+  log_write(bp);
+  log_write(nbp);
+  brelse(nbp);
+  brelse(bp);
+
+  ibp = dirblock(dp, node);
+  dxinsert(ibp, node, s->e[k].hash, nbn);
+  brelse(ibp);
+  kfree(s);
+  return 0;
+}
+
+// Give dp, a full directory of one block, an index,
+// with one leaf that holds all its entries but "." and "..",
+// which mkdir put at the start of the block.
+static int
+dxinit(struct inode *dp)
+{
+  struct dxsort *s;
+  struct buf *bp, *lbp;
+  struct dirent *de;
+  struct dxhead *h;
+  struct dxentry *e;
+  uint lbn;
+
+  if((s = (struct dxsort*)kalloc()) == 0)
+    return -1;
+  bp = dirblock(dp, 0);
+  dxsort(s, bp);
+  lbn = dirgrow(dp, &lbp);
+  dxpack(s, 0, s->n, lbp->data);
+  log_write(lbp);
+  brelse(lbp);
+  kfree(s);
+
+  de = dirat(bp->data, 0);
+  if(de->reclen != DIRLEN(1) || !isdots(de->name, de->namelen))
+    panic("dxinit");
+  de = dirat(bp->data, DIRLEN(1));
+  if(!isdots(de->name, de->namelen))
+    panic("dxinit");
+  de->reclen = DIRLEN(2);
+  h = (struct dxhead*)(bp->data + DX_DOTS);
+  memset(h, 0, BSIZE - DX_DOTS);
+  h->reclen = BSIZE - DX_DOTS;
+  h->levels = 0;
+  h->n = 1;
+  h->max = DX_ROOT;
+  h->magic = DX_MAGIC;
+  e = (struct dxentry*)(h + 1);
+  e[0].block = lbn;
+  log_write(bp);
+  brelse(bp);
+  dp->flags |= I_INDEX;
+  iupdate(dp);
+  return 0;
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
+// Caller holds dp->lock.
 struct inode*
 dirlookup(struct inode *dp, char *name, uint *poff)
 {
-  uint off, inum;
-  struct dirent de;
+  uint bn, nb, node, inum;
+  struct buf *bp;
+  struct inode *ip;
+  int n, off;
 
   if(dp->type != T_DIR)
     panic("dirlookup not DIR");
 
-  for(off = 0; off < dp->size; off += sizeof(de)){
-    if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-      panic("dirlookup read");
-    if(de.inum == 0)
-      continue;
-    if(namecmp(name, de.name) == 0){
+  // the dentry cache doesn't know offsets.
+  if(poff == 0 && dc_lookup(dp, name, &ip))
+    return ip;
+
+  n = namelen(name);
+  if((dp->flags & I_INDEX) == 0){
+    bn = 0;
+    nb = dp->size / BSIZE;
+  } else if(isdots(name, n)){
+    // in block 0, which the index doesn't cover.
+    bn = 0;
+    nb = 1;
+  } else {
+    bn = dxfind(dp, dxhash(name, n), &node);
+    nb = bn + 1;
+  }
+  for(; bn < nb; bn++){
+    bp = dirblock(dp, bn);
+    if((off = dirfind(bp, name, n)) >= 0){
       // entry matches path element
       if(poff)
-        *poff = off;
-      inum = de.inum;
+        *poff = bn*BSIZE + off;
+      inum = ((struct dirent*)(bp->data + off))->inum;
+      brelse(bp);
+      dc_enter(dp, name, inum);
       return iget(dp->dev, inum);
     }
+    brelse(bp);
   }
 
+  dc_enter(dp, name, 0);
   return 0;
 }
 
 // Write a new directory entry (name, inum) into the directory dp.
+// Returns -1 if name is present, or there's no room for it.
 int
 dirlink(struct inode *dp, char *name, uint inum)
 {
-  int off;
-  struct dirent de;
   struct inode *ip;
+  struct buf *bp;
+  struct dxhead *h;
+  uint bn, node, leaf;
+  int n, full;
 
   // Check that name is not present.
   if((ip = dirlookup(dp, name, 0)) != 0){
@@ -566,22 +1834,79 @@ dirlink(struct inode *dp, char *name, uint inum)
     return -1;
   }
 
-  // Look for an empty dirent.
-  for(off = 0; off < dp->size; off += sizeof(de)){
-    if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-      panic("dirlink read");
-    if(de.inum == 0)
-      break;
+  n = namelen(name);
+  if((dp->flags & I_INDEX) == 0){
+    for(bn = 0; bn < dp->size / BSIZE; bn++){
+      bp = dirblock(dp, bn);
+      if(dirput(bp, name, n, inum)){
+        brelse(bp);
+        goto done;
+      }
+      brelse(bp);
+    }
+    if(dp->size != BSIZE){
+      dirgrow(dp, &bp);
+      dirput(bp, name, n, inum);
+      brelse(bp);
+      goto done;
+    }
+    if(dxinit(dp) < 0)
+      return -1;
   }
 
-  strncpy(de.name, name, DIRSIZ);
-  de.inum = inum;
-  if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-    panic("dirlink");
+  for(;;){
+    leaf = dxfind(dp, dxhash(name, n), &node);
+    bp = dirblock(dp, leaf);
+    if(dirput(bp, name, n, inum)){
+      brelse(bp);
+      break;
+    }
+    brelse(bp);
+    // the leaf is full: split it, once its index block has room.
+    bp = dirblock(dp, node);
+    h = dxhead(bp, node);
+    full = h->n == h->max;
+    brelse(bp);
+    if(full){
+      if(dxgrow(dp, node) < 0)
+        return -1;
+    } else if(dxsplit(dp, node, leaf) < 0){
+      return -1;
+    }
+  }
 
+done:
+  dc_enter(dp, name, inum);
   return 0;
 }
 
+// Remove name's entry, at offset off of directory dp: the
+// entry before it in its block takes its space, or, if it is
+// the first, it becomes free.
+// Caller holds dp->lock.
+void
+dirunlink(struct inode *dp, char *name, uint off)
+{
+  struct buf *bp;
+  struct dirent *de, *prev;
+  uint o;
+
+  bp = dirblock(dp, off / BSIZE);
+  prev = 0;
+  for(o = 0; o < off % BSIZE; o += prev->reclen)
+    prev = dirat(bp->data, o);
+  if(o != off % BSIZE)
+    panic("dirunlink");
+  de = dirat(bp->data, o);
+  if(prev)
+    prev->reclen += de->reclen;
+  else
+    de->inum = 0;
+  log_write(bp);
+  brelse(bp);
+  dc_enter(dp, name, 0);
+}
+
 // Paths
 
 // Copy the next path element from path into name.
@@ -625,6 +1950,8 @@ skipelem(char *path, char *name)
 // If parent != 0, return the inode for the parent and copy the final
 // path element into name, which must have room for DIRSIZ bytes.
 // Must be called inside a transaction since it calls iput().
+// Components the dentry cache knows about cost no locking
+// of the directories they are in.
 static struct inode*
 namex(char *path, int nameiparent, char *name)
 {
@@ -636,6 +1963,14 @@ namex(char *path, int nameiparent, char *name)
     ip = idup(myproc()->cwd);
 
   while((path = skipelem(path, name)) != 0){
+    if(!(nameiparent && *path == '\0') && dc_lookup(ip, name, &next)){
+      // ip has cached entries, so it is a directory.
+      iput(ip);
+      if(next == 0)
+        return 0;
+      ip = next;
+      continue;
+    }
     ilock(ip);
     if(ip->type != T_DIR){
       iunlockput(ip);
@@ -660,11 +1995,20 @@ namex(char *path, int nameiparent, char *name)
   return ip;
 }
 
+// namex() needs room for a DIRSIZ-byte path element, which
+// is too big for the kernel stack; it lives in a page from
+// kalloc(). Callers of nameiparent() supply their own.
 struct inode*
 namei(char *path)
 {
-  char name[DIRSIZ];
-  return namex(path, 0, name);
+  struct inode *ip;
+  char *name;
+
+  if((name = kalloc()) == 0)
+    return 0;
+  ip = namex(path, 0, name);
+  kfree(name);
+  return ip;
 }
 
 struct inode*
@@ -20,13 +20,23 @@ struct superblock {
   uint logstart;     // Block number of first log block
   uint inodestart;   // Block number of first inode block
   uint bmapstart;    // Block number of first free map block
+  uint features;     // FS_* flags
+  uint inodesize;    // Bytes per on-disk inode
 };
 
 #define FSMAGIC 0x10203040
 
+#define FS_EXTENTS 0x1  // new files map their blocks with extents
+#define FS_JOURNAL 0x2  // file data goes through the log, like metadata
+#define FS_INLINE  0x4  // new files keep small contents in the inode
+
+#define NADDRS 28
 #define NDIRECT 12
 #define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+#define NDINDIRECT (NINDIRECT * NINDIRECT)
+#define NTINDIRECT (NDINDIRECT * NINDIRECT)
+#define MAXBMAP (NDIRECT + NINDIRECT + NDINDIRECT + NTINDIRECT) // largest block-mapped file
+#define MAXFILE (0xffffffff / BSIZE)   // largest file (size is a uint)
 
 // On-disk inode structure
 struct dinode {
@@ -35,14 +45,56 @@ struct dinode {
   short minor;          // Minor device number (T_DEVICE only)
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
-  uint addrs[NDIRECT+1];   // Data block addresses
+  uint flags;           // I_* flags
+  uint addrs[NADDRS];   // Data block addresses, or extent tree root
+};
+
+// Without I_EXTENTS, addrs[] holds NDIRECT direct block addresses,
+// then those of the single-, double- and triple-indirect blocks.
+
+#define I_EXTENTS 0x1  // addrs[] holds an extent tree root
+#define I_INDEX   0x2  // directory has a hash index; see below
+#define I_INLINE  0x4  // file data is in the inode; see below
+
+// An on-disk inode takes sb.inodesize bytes, a multiple of
+// sizeof(struct dinode) that divides BSIZE (mkfs -s). An
+// inode with I_INLINE has no blocks: its file's data is in
+// the inode, from addrs[] to the end, so it can hold up to
+// INLINESZ(sb) bytes. A file starts out inline, if the file
+// system has FS_INLINE, and moves to blocks when it grows
+// past that.
+#define INLINESZ(sb) ((sb).inodesize - sizeof(struct dinode) + NADDRS*4)
+
+// An inode with I_EXTENTS maps its blocks with a tree of
+// extents whose root node is in addrs[], and whose other
+// nodes are whole blocks. A node is a header followed by
+// entries sorted by lblk. In a leaf (depth 0), an entry maps
+// file blocks lblk..lblk+len-1 to disk blocks pblk..; in an
+// interior node, an entry points to the child node in block
+// pblk, which maps file blocks from lblk up to the lblk of
+// the next entry.
+struct extent_header {
+  ushort magic;  // EXT_MAGIC
+  ushort n;      // entries in use
+  ushort max;    // entries that fit in this node
+  ushort depth;  // levels below this node; 0 for a leaf
+};
+
+struct extent {
+  uint lblk;     // first file block
+  uint len;      // number of blocks (leaves only)
+  uint pblk;     // first disk block, or child node
 };
 
+#define EXT_MAGIC 0xf30a
+#define EXT_ROOT  ((NADDRS*4 - sizeof(struct extent_header)) / sizeof(struct extent))
+#define EXT_NODE  ((BSIZE - sizeof(struct extent_header)) / sizeof(struct extent))
+
 // Inodes per block.
-#define IPB           (BSIZE / sizeof(struct dinode))
+#define IPB(sb)       (BSIZE / (sb).inodesize)
 
 // Block containing inode i
-#define IBLOCK(i, sb)     ((i) / IPB + sb.inodestart)
+#define IBLOCK(i, sb)     ((i) / IPB(sb) + sb.inodestart)
 
 // Bitmap bits per block
 #define BPB           (BSIZE*8)
@@ -50,11 +102,56 @@ struct dinode {
 // Block of free map containing bit for block b
 #define BBLOCK(b, sb) ((b)/BPB + sb.bmapstart)
 
-// Directory is a file containing a sequence of dirent structures.
-#define DIRSIZ 14
+// A directory is a file whose blocks each hold a chain of
+// variable-length entries, as in ext2. An entry's reclen is
+// the distance to the next one, and the entries of a block
+// add up to exactly BSIZE; an entry with inum 0 is free. An
+// entry needs DIRLEN(namelen) bytes, and any more it has is
+// room for new entries. Names are not NUL-terminated on disk.
+#define DIRSIZ 255
 
 struct dirent {
   ushort inum;
-  char name[DIRSIZ];
+  ushort reclen;  // bytes from this entry to the next
+  uchar namelen;
+  uchar pad;
+  char name[];    // namelen bytes
+};
+
+#define DIRLEN(n) ((sizeof(struct dirent) + (n) + 3) & ~3)
+
+// A directory that outgrows its first block is indexed by a
+// hash of the names (an "htree", as in ext3), and has I_INDEX.
+// Its block 0 holds "." and "..", then the root of the index.
+// Its other blocks are leaves, which are ordinary blocks of
+// entries, and, in a big directory, index nodes. An index
+// block is a header and entries sorted by hash; the leaf (or
+// node) for a name is that of the last entry whose hash is
+// <= dxhash(name), FNV-1a of the name's bytes. The root's
+// entries point to nodes if it has levels 1, else to leaves.
+// Names with the same hash are always in the same leaf.
+// A header starts as a free dirent that covers the rest of
+// its block, so that anything that reads the directory as a
+// list of entries, like ls, skips the index.
+
+struct dxhead {
+  ushort zero;   // dirent inum: 0
+  ushort reclen; // dirent reclen: the rest of the block
+  uchar namelen; // dirent namelen: 0
+  uchar pad;
+  ushort levels; // root: index levels below it, 0 or 1
+  ushort n;      // entries in use
+  ushort max;    // entries that fit in this block
+  uint magic;    // DX_MAGIC
+};
+
+struct dxentry {
+  uint hash;     // lowest hash in the block; 0 for the first entry
+  uint block;    // file block number of the leaf or node
 };
 
+#define DX_MAGIC 0x68747265 // "htre"
+#define DX_DOTS  (DIRLEN(1) + DIRLEN(2)) // offset of the root
+#define DX_ROOT  ((BSIZE - DX_DOTS - sizeof(struct dxhead)) / sizeof(struct dxentry))
+#define DX_NODE  ((BSIZE - sizeof(struct dxhead)) / sizeof(struct dxentry))
+
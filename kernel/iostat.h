@@ -0,0 +1,19 @@
+// Disk I/O counters, as returned by the iostat() system call.
+
+#define NLAT 16 // latency histogram buckets
+
+struct iostat {
+  uint64 nreq;    // disk requests issued
+  uint64 nread;   // blocks read
+  uint64 nwrite;  // blocks written
+  uint64 nbytes;  // bytes written
+  uint64 nnotify; // times the device was notified of new requests
+  uint64 nintr;   // completion interrupts taken
+  uint64 npolled; // requests reaped while polling
+  uint64 nqueue;  // device request queues in use
+  uint64 nlog;    // blocks written to the log (with commit blocks)
+  uint64 ninstall; // blocks copied from the log to their homes
+  uint64 ndata;   // file data blocks written in place, not logged
+  uint64 lat[NLAT]; // request latencies: lat[i] counts those
+                    // under 2^i microseconds (the last, any longer)
+};
@@ -4,137 +4,282 @@
 #include "param.h"
 #include "spinlock.h"
 #include "sleeplock.h"
+#include "proc.h"
 #include "fs.h"
 #include "buf.h"
+#include "iostat.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
 // A log transaction contains the updates of multiple FS system
-// calls. The logging system only commits when there are
-// no FS system calls active. Thus there is never
-// any reasoning required about whether a commit might
-// write an uncommitted system call's updates to disk.
+// calls. A transaction is only closed when there are no FS
+// system calls active in it. Thus there is never any reasoning
+// required about whether a commit might write an uncommitted
+// system call's updates to disk.
 //
 // A system call should call begin_op()/end_op() to mark
 // its start and end. Usually begin_op() just increments
-// the count of in-progress FS system calls and returns.
-// But if it thinks the log is close to running out, it
-// sleeps until the last outstanding end_op() commits.
+// the count of in-progress FS system calls, reserves log
+// space for the MAXOPBLOCKS blocks the call might write, and
+// returns. But if it thinks the log is close to running out,
+// it checkpoints the log (see below) first. Operations that
+// write more, like file data writeback, use begin_opn()/
+// end_opn() to reserve a different number of blocks.
 //
 // The log is a physical re-do log containing disk blocks.
-// The on-disk log format:
-//   header block, containing block #s for block A, B, C, ...
+// mkfs chooses its size (sb.nlog). The on-disk log format:
+//   head block, containing the sequence number of the first
+//     transaction since the last checkpoint
+//   commit block for a transaction: its sequence number, its
+//     block #s A, B, ..., and a checksum of all that and of
+//     the blocks' contents
 //   block A
 //   block B
-//   block C
 //   ...
-// Log appends are synchronous.
+//   commit block for the next transaction
+//   ...
+// Recovery replays transactions in order until it finds a
+// commit block with the wrong sequence number or checksum,
+// which marks the end of the log or a torn commit. So a
+// transaction's commit block and blocks can go to the disk in
+// one batch, in any order; the checksum tells whether all of
+// them made it.
+//
+// Commits are asynchronous and grouped. end_op() does not
+// wait for the transaction to commit; the logd kernel thread
+// commits it once it has been open for LOGDELAY ticks, or the
+// op that makes it bigger than half the log commits it
+// itself. log_force() commits in the caller's context.
+//
+// Transactions are double-buffered: committing one first
+// copies its blocks into the log's own buffers, and then lets
+// a new transaction start while it writes those copies to the
+// log.
+//
+// Committed transactions pile up in the log, one after the
+// other, and the cache keeps their blocks pinned. Only when
+// the log is full are they all installed at their home
+// locations (a checkpoint) and the log emptied, by writing a
+// new sequence number to the head block. If a block appears
+// in the log more than once, recovery installs the copies in
+// order, so the last one wins.
+//
+// Log appends plug the block queue so that their writes go to
+// the disk as a few large sorted requests rather than one
+// request per block; so do installs.
+//
+// File data is usually not logged at all (ordered mode).
+// log_data() writes a data block in place, before the op that
+// wrote it ends, so the block is on the disk before the commit
+// of the metadata that points to it. A crash may leave an
+// overwritten block half old and half new, but never leaves a
+// file pointing at a block that holds someone else's data.
+// Data goes through the log after all if the log already holds
+// the block (recovery would replay the old copy over the new
+// data), or if the block was freed by a transaction that has
+// not committed (a crash would give the block back to its old
+// owner, with the new data in it). mkfs -j makes the log take
+// all file data, for comparison.
+
+#define LOGMAGIC 0x4c4f4743 // "LOGC"
 
-// Contents of the header block, used for both the on-disk header block
-// and to keep track in memory of logged block# before commit.
-struct logheader {
-  int n;
-  int block[LOGSIZE];
+// The head block of the log.
+struct loghead {
+  uint seq;     // sequence number of the first transaction
+};
+
+// The commit block in front of each transaction in the log.
+struct logcommit {
+  uint magic;   // LOGMAGIC
+  uint sum;     // checksum of seq, n, block[0..n) and the n blocks
+  uint seq;     // sequence number
+  uint n;       // number of blocks that follow
+  uint block[(BSIZE-4*sizeof(uint))/sizeof(uint)]; // their home block #s
 };
 
 struct log {
   struct spinlock lock;
   int start;
-  int size;
+  int size;        // log blocks, including the head.
   int outstanding; // how many FS sys calls are executing.
-  int committing;  // in commit(), please wait.
+  int reserved;    // log blocks reserved by the executing calls.
+  int closing;     // open transaction is being closed; begin_op() waits.
+  int committing;  // someone is in commit(), please wait.
+  int n;           // blocks logged, in block[].
+  int closed;      // block[0..closed) are in closed transactions.
+  int used;        // log blocks after the head used by closed transactions.
+  uint seq;        // sequence number of the next transaction to write.
+  uint opened;     // ticks when the open transaction logged its first block.
+  int txn;         // number of the open transaction.
+  int done;        // transactions before this one have committed.
   int dev;
-  struct logheader lh;
+  int journal;     // log file data too (FS_JOURNAL).
+  uint64 nlog;     // blocks written to the log, for iostat().
+  uint64 ninstall; // blocks installed from the log.
+  uint64 ndata;    // data blocks written in place by log_data().
+  int block[LOGSIZE]; // home block #s of logged blocks.
 };
 struct log log;
 
+// for each disk block, 1 + the transaction that last freed it.
+static uint freed[FSSIZE];
+
 static void recover_from_log(void);
-static void commit();
+static void commit(int);
+static void logd(void);
 
 void
 initlog(int dev, struct superblock *sb)
 {
-  if (sizeof(struct logheader) >= BSIZE)
-    panic("initlog: too big logheader");
+  if (sizeof(struct logcommit) != BSIZE || LOGSIZE > NELEM(((struct logcommit*)0)->block))
+    panic("initlog: bad logcommit");
 
   initlock(&log.lock, "log");
   log.start = sb->logstart;
   log.size = sb->nlog;
+  if(log.size > LOGSIZE)
+    log.size = LOGSIZE; // use no more than we can track.
+  if(log.size < MAXOPBLOCKS+2 || log.size < WBOPBLOCKS+2)
+    panic("initlog: log too small");
   log.dev = dev;
+  log.journal = (sb->features & FS_JOURNAL) != 0;
   recover_from_log();
+  kthread("logd", logd);
 }
 
-// Copy committed blocks from log to their home location
+// 32-bit FNV-1a hash of n bytes at p, continuing from sum.
+static uint
+cksum(uint sum, void *p, int n)
+{
+  uchar *c = p;
+
+  while(n-- > 0){
+    sum ^= *c++;
+    sum *= 16777619;
+  }
+  return sum;
+}
+#define CKSUM0 2166136261U
+
+// Checkpoint: copy committed blocks to their home locations.
+// With no FS sys calls running, the pinned cache blocks
+// hold the last committed data.
 static void
-install_trans(int recovering)
+install_trans(void)
 {
   int tail;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
+  blk_plug();
+  for (tail = 0; tail < log.n; tail++) {
+    struct buf *dbuf = bread(log.dev, log.block[tail]); // read dst
     bwrite(dbuf);  // write dst to disk
-    if(recovering == 0)
-      bunpin(dbuf);
-    brelse(lbuf);
+    bunpin(dbuf);
     brelse(dbuf);
   }
+  blk_unplug(); // sorted, merged home-location writes
+  acquire(&log.lock);
+  log.ninstall += log.n;
+  release(&log.lock);
 }
 
-// Read the log header from disk into the in-memory log header
+// Write the head block, which discards the transactions
+// in the log: recovery will look for seq next.
 static void
-read_head(void)
+write_head(uint seq)
 {
-  struct buf *buf = bread(log.dev, log.start);
-  struct logheader *lh = (struct logheader *) (buf->data);
-  int i;
-  log.lh.n = lh->n;
-  for (i = 0; i < log.lh.n; i++) {
-    log.lh.block[i] = lh->block[i];
-  }
+  struct buf *buf = bnew(log.dev, log.start);
+  struct loghead *hb = (struct loghead *) (buf->data);
+  memset(buf->data, 0, BSIZE);
+  hb->seq = seq;
+  bwrite(buf);
   brelse(buf);
 }
 
-// Write in-memory log header to disk.
-// This is the true point at which the
-// current transaction commits.
-static void
-write_head(void)
+// Is the transaction whose commit block is at log
+// block pos complete, with the given sequence number?
+static int
+valid_trans(int pos, uint seq)
 {
-  struct buf *buf = bread(log.dev, log.start);
-  struct logheader *hb = (struct logheader *) (buf->data);
+  struct buf *cb = bread(log.dev, log.start+1+pos);
+  struct logcommit *c = (struct logcommit *) (cb->data);
+  uint n = c->n;
+  uint sum = c->sum;
   int i;
-  hb->n = log.lh.n;
-  for (i = 0; i < log.lh.n; i++) {
-    hb->block[i] = log.lh.block[i];
+
+  if(c->magic != LOGMAGIC || c->seq != seq || n < 1 ||
+     n > NELEM(c->block) || pos + 1 + n > log.size - 1){
+    brelse(cb);
+    return 0;
   }
-  bwrite(buf);
-  brelse(buf);
+  uint s = cksum(CKSUM0, &c->seq, (2 + n) * sizeof(uint));
+  brelse(cb);
+  for (i = 0; i < n; i++) {
+    struct buf *lbuf = bread(log.dev, log.start+1+pos+1+i);
+    s = cksum(s, lbuf->data, BSIZE);
+    brelse(lbuf);
+  }
+  return s == sum;
 }
 
+// Replay the complete transactions in the log, in order.
 static void
 recover_from_log(void)
 {
-  read_head();
-  install_trans(1); // if committed, copy from log to disk
-  log.lh.n = 0;
-  write_head(); // clear the log
+  struct buf *hb = bread(log.dev, log.start);
+  uint seq = ((struct loghead *) (hb->data))->seq;
+  int pos, i;
+
+  brelse(hb);
+  blk_plug();
+  for (pos = 0; valid_trans(pos, seq); seq++) {
+    struct buf *cb = bread(log.dev, log.start+1+pos);
+    struct logcommit *c = (struct logcommit *) (cb->data);
+    for (i = 0; i < c->n; i++) {
+      struct buf *lbuf = bread(log.dev, log.start+1+pos+1+i); // read log block
+      struct buf *dbuf = bread(log.dev, c->block[i]); // read dst
+      memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
+      bwrite(dbuf);
+      brelse(lbuf);
+      brelse(dbuf);
+    }
+    pos += 1 + c->n;
+    brelse(cb);
+  }
+  blk_unplug(); // install, before the head discards the log
+  log.seq = seq;
+  write_head(log.seq); // clear the log
 }
 
 // called at the start of each FS system call.
 void
 begin_op(void)
+{
+  begin_opn(MAXOPBLOCKS);
+}
+
+// called at the start of an FS operation that
+// writes at most n blocks.
+void
+begin_opn(int n)
 {
   acquire(&log.lock);
   while(1){
-    if(log.committing){
-      sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
-      // this op might exhaust log space; wait for commit.
+    if(log.closing){
       sleep(&log, &log.lock);
+    } else if(log.used + (log.n - log.closed) + 1 +
+              log.reserved + n > log.size - 1){
+      // this op might exhaust log space; checkpoint.
+      if(log.committing){
+        sleep(&log, &log.lock);
+      } else {
+        log.committing = 1;
+        commit(1);
+        log.committing = 0;
+        wakeup(&log);
+      }
     } else {
       log.outstanding += 1;
+      log.reserved += n;
       release(&log.lock);
       break;
     }
@@ -142,63 +287,189 @@ begin_op(void)
 }
 
 // called at the end of each FS system call.
-// commits if this was the last outstanding operation.
 void
 end_op(void)
 {
-  int do_commit = 0;
+  end_opn(MAXOPBLOCKS);
+}
 
+// called at the end of an FS operation begun with begin_opn(n).
+// commits if the transaction has grown big; otherwise
+// leaves that to logd.
+void
+end_opn(int n)
+{
   acquire(&log.lock);
   log.outstanding -= 1;
-  if(log.committing)
-    panic("log.committing");
-  if(log.outstanding == 0){
-    do_commit = 1;
+  log.reserved -= n;
+  // begin_op() may be waiting for log space, and
+  // decrementing log.outstanding has decreased the
+  // amount of reserved space; commit() may be waiting
+  // for the transaction to quiesce.
+  wakeup(&log);
+  if(log.outstanding == 0 && !log.committing && log.n - log.closed >= log.size/2){
     log.committing = 1;
-  } else {
-    // begin_op() may be waiting for log space,
-    // and decrementing log.outstanding has decreased
-    // the amount of reserved space.
+    commit(0);
+    log.committing = 0;
     wakeup(&log);
   }
   release(&log.lock);
+}
 
-  if(do_commit){
-    // call commit w/o holding locks, since not allowed
-    // to sleep with locks.
-    commit();
-    acquire(&log.lock);
-    log.committing = 0;
-    wakeup(&log);
-    release(&log.lock);
+// Copy block[from..to) from the cache into the log's buffers,
+// after a commit block at log block pos, all of which stay
+// pinned until write_log().
+static void
+snapshot(int from, int to, int pos, uint seq)
+{
+  struct buf *cb = bnew(log.dev, log.start+1+pos);
+  struct logcommit *c = (struct logcommit *) (cb->data);
+  int i;
+
+  memset(cb->data, 0, BSIZE);
+  c->magic = LOGMAGIC;
+  c->seq = seq;
+  c->n = to - from;
+  for (i = 0; i < c->n; i++)
+    c->block[i] = log.block[from+i];
+  uint sum = cksum(CKSUM0, &c->seq, (2 + c->n) * sizeof(uint));
+
+  for (i = 0; i < c->n; i++) {
+    struct buf *lbuf = bnew(log.dev, log.start+1+pos+1+i); // log block
+    struct buf *dbuf = bread(log.dev, log.block[from+i]); // cache block
+    memmove(lbuf->data, dbuf->data, BSIZE);
+    sum = cksum(sum, lbuf->data, BSIZE);
+    bpin(lbuf);
+    brelse(dbuf);
+    brelse(lbuf);
   }
+  c->sum = sum;
+  bpin(cb);
+  brelse(cb);
 }
 
-// Copy modified blocks from cache to log.
+// Write the snapshot's n log blocks, starting at pos, to the
+// log. There's no need to wait for the blocks before writing
+// the commit block: the checksum covers them.
 static void
-write_log(void)
+write_log(int pos, int n)
 {
   int tail;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
-    brelse(from);
-    brelse(to);
+  blk_plug();
+  for (tail = pos; tail < pos + n; tail++) {
+    struct buf *b = bread(log.dev, log.start+1+tail); // still cached
+    bwrite(b);  // write the log
+    bunpin(b);
+    brelse(b);
+  }
+  blk_unplug(); // the log blocks are adjacent: usually one request
+  acquire(&log.lock);
+  log.nlog += n;
+  release(&log.lock);
+}
+
+// Commit the open transaction. With checkpoint, also install
+// everything in the log and empty it. Caller holds log.lock
+// and has set log.committing; commit() releases the lock
+// while it does disk I/O.
+static void
+commit(int checkpoint)
+{
+  struct proc *p = myproc();
+  int from, to, pos;
+
+  // close the open transaction: keep new FS sys calls
+  // out until the running ones have finished.
+  log.closing = 1;
+  while(log.outstanding > 0)
+    sleep(&log, &log.lock);
+  from = log.closed;
+  to = log.n;
+  pos = log.used;
+  release(&log.lock);
+
+  if(to > from)
+    snapshot(from, to, pos, log.seq);
+
+  acquire(&log.lock);
+  log.closed = to;
+  if(to > from){
+    log.used += 1 + to - from;
+    log.seq++;
+  }
+  log.txn++;
+  if(!checkpoint){
+    // start the next transaction while this one is written.
+    log.closing = 0;
+    wakeup(&log);
+  }
+  release(&log.lock);
+
+  // poll for the disk writes, rather than wait for interrupts:
+  // every process in log_force() or begin_op() waits on them.
+  p->iopoll++;
+  if(to > from)
+    write_log(pos, 1 + to - from); // the commit
+  if(checkpoint && to > 0){
+    install_trans();      // Now install writes to home locations
+    write_head(log.seq);  // Erase the transactions from the log
   }
+  p->iopoll--;
+
+  acquire(&log.lock);
+  if(checkpoint){
+    log.n = log.closed = log.used = 0;
+    log.closing = 0;
+  }
+  log.done = log.txn;
+  wakeup(&log);
 }
 
+// Wait until every FS sys call that has finished
+// is committed, committing now if need be.
+// The caller must not be inside begin_op()/end_op().
+void
+log_force(void)
+{
+  int txn;
+
+  acquire(&log.lock);
+  txn = log.txn;
+  if(log.n == log.closed)
+    txn--; // the open transaction is empty.
+  while(log.done <= txn){
+    if(log.committing){
+      sleep(&log, &log.lock);
+    } else {
+      log.committing = 1;
+      commit(0);
+      log.committing = 0;
+      wakeup(&log);
+    }
+  }
+  release(&log.lock);
+}
+
+// The log daemon: commits a transaction once
+// it has been open for LOGDELAY ticks.
 static void
-commit()
+logd(void)
 {
-  if (log.lh.n > 0) {
-    write_log();     // Write modified blocks from cache to log
-    write_head();    // Write header to disk -- the real commit
-    install_trans(0); // Now install writes to home locations
-    log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+  acquire(&log.lock);
+  for(;;){
+    if(log.committing || log.n == log.closed
+       || ticks - log.opened < LOGDELAY){
+      // check again at the next clock tick. clockintr()
+      // doesn't hold log.lock, so a wakeup might be missed,
+      // which just delays the commit by a tick.
+      sleep(&ticks, &log.lock);
+    } else {
+      log.committing = 1;
+      commit(0);
+      log.committing = 0;
+      wakeup(&log);
+    }
   }
 }
 
@@ -217,20 +488,73 @@ log_write(struct buf *b)
   int i;
 
   acquire(&log.lock);
-  if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
+  if (log.used + (log.n - log.closed) + 1 >= log.size - 1)
     panic("too big a transaction");
   if (log.outstanding < 1)
     panic("log_write outside of trans");
 
-  for (i = 0; i < log.lh.n; i++) {
-    if (log.lh.block[i] == b->blockno)   // log absorption
+  // absorb into the open transaction; closed ones
+  // may already be on their way to disk.
+  for (i = log.closed; i < log.n; i++) {
+    if (log.block[i] == b->blockno)   // log absorption
       break;
   }
-  log.lh.block[i] = b->blockno;
-  if (i == log.lh.n) {  // Add new block to log?
+  log.block[i] = b->blockno;
+  if (i == log.n) {  // Add new block to log?
+    if (i == log.closed)
+      log.opened = ticks;
     bpin(b);
-    log.lh.n++;
+    log.n++;
+  }
+  release(&log.lock);
+}
+
+// Caller has modified file data block b->data, and is done
+// with the buffer, like log_write(). Write the block in place
+// before the current op ends, unless it has to be logged (see
+// the comment at the top of this file). If the caller has
+// plugged the block queue, the write happens at blk_unplug(),
+// which must also come before end_op().
+void
+log_data(struct buf *b)
+{
+  int i, logit;
+
+  acquire(&log.lock);
+  if (log.outstanding < 1)
+    panic("log_data outside of trans");
+  logit = log.journal || (b->blockno < FSSIZE && freed[b->blockno] > log.done);
+  for (i = 0; i < log.n && !logit; i++) {
+    if (log.block[i] == b->blockno)
+      logit = 1;
   }
+  if (!logit)
+    log.ndata++;
   release(&log.lock);
+
+  if (logit)
+    log_write(b);
+  else
+    bwrite(b);
 }
 
+// Blocks b..b+n-1 have been freed in the current op.
+void
+log_free(uint b, uint n)
+{
+  acquire(&log.lock);
+  for (; n > 0 && b < FSSIZE; n--, b++)
+    freed[b] = log.txn + 1;
+  release(&log.lock);
+}
+
+// Add the log's counters to *st.
+void
+log_stat(struct iostat *st)
+{
+  acquire(&log.lock);
+  st->nlog = log.nlog;
+  st->ninstall = log.ninstall;
+  st->ndata = log.ndata;
+  release(&log.lock);
+}
@@ -27,6 +27,9 @@ main()
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
+    pollinit();      // poll() wait queues
+    sockinit();      // socket table
+    vdsoinit();      // page of clock ticks for user space
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
     __sync_synchronize();
@@ -29,6 +29,8 @@
 #define CLINT 0x2000000L
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define TIMEBASE 10000000L // CLINT_MTIME (and r_time()) ticks per second.
+#define TICKTIME 1000000L  // CLINT_MTIME ticks per clock interrupt.
 
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
@@ -62,6 +64,12 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   URING (p->uring, if the process has called uring_setup())
+//   VPROC (p->vproc, read-only)
+//   VDSO (the same read-only page in every process)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define VDSO (TRAPFRAME - PGSIZE)
+#define VPROC (VDSO - PGSIZE)
+#define URING (VPROC - PGSIZE)
@@ -1,13 +1,24 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
-#define NOFILE       16  // open files per process
+#define NOFILE       32  // open files per process
 #define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define PIPEMAX      16  // max pages in a pipe's buffer
+#define NSOCK       100  // open sockets per system
+#define SOCKBUF   16384  // bytes in a socket's buffer, each way
+#define NINODE     1000  // maximum number of cached i-nodes
+#define NDENTRY     512  // size of directory entry cache
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
-#define MAXOPBLOCKS  10  // max # of blocks any FS op writes
-#define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
-#define MAXPATH      128   // maximum file path name
+#define MAXOPBLOCKS  14  // max # of blocks any FS op writes
+#define LOGSIZE      128  // max blocks in on-disk log; mkfs picks the size
+#define LOGDELAY     1  // ticks a log transaction may stay open
+#define NBUF         (LOGSIZE*3+MAXOPBLOCKS)  // size of disk block cache
+#define FSSIZE       4000  // size of file system in blocks
+#define NREADAHEAD   32  // max blocks readi() fetches in one go
+#define NDELAY       64  // max file blocks waiting for disk blocks, per file
+#define NDIRTY       16  // max files with blocks waiting for disk blocks
+#define WBDELAY      30  // ticks file data may wait for disk blocks
+#define WBMAX         8  // delayed blocks written back per transaction
+#define WBOPBLOCKS   (2*WBMAX+4)  // max # of blocks a writeback op writes
+#define MAXPATH      512   // maximum file path name
@@ -7,18 +7,105 @@
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "poll.h"
+#include "fcntl.h"
+#include "uio.h"
 
-#define PIPESIZE 512
+// A pipe's data lives in a ring of whole pages, one page
+// unless fcntl(F_SETPIPE_SZ) asks for more, up to PIPEMAX.
+// The number of pages is a power of two, so a byte's place
+// in the ring is its count modulo the size, and the ring
+// wraps at a page boundary: piperead() and pipewrite() copy
+// a page-sized chunk at a time, with one copyin/copyout each.
+//
+// A reader sleeps only while the pipe is empty, and a writer
+// only while it is full, so writers wake readers only when
+// the pipe stops being empty, and readers wake writers only
+// when it stops being full.
+//
+// splice() and tee() (see filesplice()) move data between a
+// pipe's ring and a file, or another pipe, directly, without
+// a copy to user space and back. They can't hold the pipe's
+// spin-lock while they read or write a file, so pipebegin()
+// reserves one end of the pipe instead (rbusy or wbusy), and
+// pipeend() releases it; piperead() and pipewrite() wait for
+// their end to be free, and pipesetsize() for both.
+//
+// A connected socket (see sock.c) is a pair of pipes, one for
+// each direction. A SOCK_SEQPACKET socket's pipes hold whole
+// messages, each a length and then the bytes, which only
+// pipewritemsg() and pipereadmsg() touch.
 
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
+  char *buf[PIPEMAX]; // data pages
+  uint size;      // bytes in buf: a power-of-two number of pages
   uint nread;     // number of bytes read
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
+  int rbusy;      // a splice is reading the pipe
+  int wbusy;      // a splice is writing the pipe
+  struct pollent *pollq; // processes in poll(); see poll.c
 };
 
+// Return the address of byte i of the pipe's ring, and set
+// *m to the number of bytes from there to the end of its page.
+static char*
+at(struct pipe *pi, uint i, uint *m)
+{
+  uint off = i & (pi->size - 1);
+
+  *m = PGSIZE - off % PGSIZE;
+  return pi->buf[off / PGSIZE] + off % PGSIZE;
+}
+
+static uint
+min(uint a, uint b)
+{
+  return a < b ? a : b;
+}
+
+// The pipe has stopped being empty, or the write end closed.
+static void
+wakereaders(struct pipe *pi)
+{
+  wakeup(&pi->nread);
+  pollwakeup(&pi->pollq);
+}
+
+// The pipe has stopped being full, or the read end closed.
+static void
+wakewriters(struct pipe *pi)
+{
+  wakeup(&pi->nwrite);
+  pollwakeup(&pi->pollq);
+}
+
+// Allocate a pipe of one page, with both ends open.
+struct pipe*
+pipenew(void)
+{
+  struct pipe *pi;
+
+  if((pi = (struct pipe*)kalloc()) == 0)
+    return 0;
+  if((pi->buf[0] = kalloc()) == 0){
+    kfree((char*)pi);
+    return 0;
+  }
+  pi->size = PGSIZE;
+  pi->readopen = 1;
+  pi->writeopen = 1;
+  pi->nwrite = 0;
+  pi->nread = 0;
+  pi->rbusy = 0;
+  pi->wbusy = 0;
+  pi->pollq = 0;
+  initlock(&pi->lock, "pipe");
+  return pi;
+}
+
 int
 pipealloc(struct file **f0, struct file **f1)
 {
@@ -28,26 +115,21 @@ pipealloc(struct file **f0, struct file **f1)
   *f0 = *f1 = 0;
   if((*f0 = filealloc()) == 0 || (*f1 = filealloc()) == 0)
     goto bad;
-  if((pi = (struct pipe*)kalloc()) == 0)
+  if((pi = pipenew()) == 0)
     goto bad;
-  pi->readopen = 1;
-  pi->writeopen = 1;
-  pi->nwrite = 0;
-  pi->nread = 0;
-  initlock(&pi->lock, "pipe");
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
   (*f0)->writable = 0;
+  (*f0)->nonblock = 0;
   (*f0)->pipe = pi;
   (*f1)->type = FD_PIPE;
   (*f1)->readable = 0;
   (*f1)->writable = 1;
+  (*f1)->nonblock = 0;
   (*f1)->pipe = pi;
   return 0;
 
  bad:
-  if(pi)
-    kfree((char*)pi);
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -61,70 +143,416 @@ pipeclose(struct pipe *pi, int writable)
   acquire(&pi->lock);
   if(writable){
     pi->writeopen = 0;
-    wakeup(&pi->nread);
+    wakereaders(pi);
   } else {
     pi->readopen = 0;
-    wakeup(&pi->nwrite);
+    wakewriters(pi);
   }
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
+    for(int i = 0; i < pi->size / PGSIZE; i++)
+      kfree(pi->buf[i]);
     kfree((char*)pi);
   } else
     release(&pi->lock);
 }
 
+// Write the cnt user buffers in iov to the pipe, all under
+// one acquire of its lock, unless it has to wait for room.
+// If nonblock is set, write only what fits without waiting,
+// and return -EAGAIN if nothing does.
 int
-pipewrite(struct pipe *pi, uint64 addr, int n)
+pipewritev(struct pipe *pi, struct iovec *iov, int cnt, int nonblock)
 {
-  int i = 0;
+  int i = 0, v;
+  uint j, m;
+  char *p;
   struct proc *pr = myproc();
 
   acquire(&pi->lock);
-  while(i < n){
+  for(v = 0, j = 0; v < cnt; ){
+    if(j == iov[v].iov_len){
+      v++;
+      j = 0;
+      continue;
+    }
     if(pi->readopen == 0 || pr->killed){
       release(&pi->lock);
       return -1;
     }
-    if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
-      wakeup(&pi->nread);
-      sleep(&pi->nwrite, &pi->lock);
-    } else {
-      char ch;
-      if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
-        break;
-      pi->data[pi->nwrite++ % PIPESIZE] = ch;
-      i++;
+    if(pi->wbusy || pi->nwrite == pi->nread + pi->size){ //DOC: pipewrite-full
+      if(nonblock){
+        release(&pi->lock);
+        return i > 0 ? i : -EAGAIN;
+      }
+      if(pi->wbusy)
+        sleep(&pi->wbusy, &pi->lock);
+      else
+        sleep(&pi->nwrite, &pi->lock);
+      continue;
     }
+    p = at(pi, pi->nwrite, &m);
+    m = min(m, min(iov[v].iov_len - j, pi->nread + pi->size - pi->nwrite));
+    if(copyin(pr->pagetable, p, (uint64)iov[v].iov_base + j, m) == -1)
+      break;
+    if(pi->nread == pi->nwrite)
+      wakereaders(pi);
+    pi->nwrite += m;
+    i += m;
+    j += m;
   }
-  wakeup(&pi->nread);
   release(&pi->lock);
 
   return i;
 }
 
+// Read from the pipe into the cnt user buffers in iov, until
+// they are full or the pipe is empty, waiting for data unless
+// nonblock is set, in which case return -EAGAIN.
 int
-piperead(struct pipe *pi, uint64 addr, int n)
+pipereadv(struct pipe *pi, struct iovec *iov, int cnt, int nonblock)
 {
-  int i;
+  int i = 0, v;
+  uint j, m;
+  char *p;
   struct proc *pr = myproc();
-  char ch;
 
   acquire(&pi->lock);
-  while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
+  while((pi->nread == pi->nwrite && pi->writeopen) || pi->rbusy){  //DOC: pipe-empty
     if(pr->killed){
       release(&pi->lock);
       return -1;
     }
-    sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
+    if(nonblock){
+      release(&pi->lock);
+      return -EAGAIN;
+    }
+    if(pi->rbusy)
+      sleep(&pi->rbusy, &pi->lock);
+    else
+      sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(pi->nread == pi->nwrite)
-      break;
-    ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
+  for(v = 0, j = 0; v < cnt && pi->nread != pi->nwrite; ){  //DOC: piperead-copy
+    if(j == iov[v].iov_len){
+      v++;
+      j = 0;
+      continue;
+    }
+    p = at(pi, pi->nread, &m);
+    m = min(m, min(iov[v].iov_len - j, pi->nwrite - pi->nread));
+    if(copyout(pr->pagetable, (uint64)iov[v].iov_base + j, p, m) == -1)
       break;
+    if(pi->nwrite == pi->nread + pi->size)
+      wakewriters(pi);  //DOC: piperead-wakeup
+    pi->nread += m;
+    i += m;
+    j += m;
   }
-  wakeup(&pi->nwrite);  //DOC: piperead-wakeup
   release(&pi->lock);
   return i;
 }
+
+// Copy n bytes between byte i of the pipe's ring and src or
+// dst, a user address if user is set, else a kernel address.
+static int
+ringin(struct pipe *pi, uint i, int user, uint64 src, uint n)
+{
+  uint m;
+  char *p;
+
+  for(; n > 0; i += m, src += m, n -= m){
+    p = at(pi, i, &m);
+    m = min(m, n);
+    if(either_copyin(p, user, src, m) == -1)
+      return -1;
+  }
+  return 0;
+}
+
+static int
+ringout(struct pipe *pi, uint i, int user, uint64 dst, uint n)
+{
+  uint m;
+  char *p;
+
+  for(; n > 0; i += m, dst += m, n -= m){
+    p = at(pi, i, &m);
+    m = min(m, n);
+    if(either_copyout(user, dst, p, m) == -1)
+      return -1;
+  }
+  return 0;
+}
+
+// Write the cnt user buffers in iov to the pipe as a single
+// message, which one pipereadmsg() will read: its length,
+// and then its bytes. Waits until the whole message fits,
+// unless nonblock is set, in which case return -EAGAIN.
+// Returns the length, or -1 if it can never fit.
+int
+pipewritemsg(struct pipe *pi, struct iovec *iov, int cnt, int nonblock)
+{
+  uint n = 0, i;
+  struct proc *pr = myproc();
+
+  for(int v = 0; v < cnt; v++)
+    n += iov[v].iov_len;
+  acquire(&pi->lock);
+  for(;;){
+    if(pi->readopen == 0 || pr->killed || n > pi->size - sizeof(n)){
+      release(&pi->lock);
+      return -1;
+    }
+    if(!pi->wbusy && pi->nread + pi->size - pi->nwrite >= n + sizeof(n))
+      break;
+    if(nonblock){
+      release(&pi->lock);
+      return -EAGAIN;
+    }
+    if(pi->wbusy)
+      sleep(&pi->wbusy, &pi->lock);
+    else
+      sleep(&pi->nwrite, &pi->lock);
+  }
+  // fill in the message, and then make it visible all at once.
+  i = pi->nwrite;
+  ringin(pi, i, 0, (uint64)&n, sizeof(n));
+  i += sizeof(n);
+  for(int v = 0; v < cnt; v++){
+    if(ringin(pi, i, 1, (uint64)iov[v].iov_base, iov[v].iov_len) < 0){
+      release(&pi->lock);
+      return -1;
+    }
+    i += iov[v].iov_len;
+  }
+  if(pi->nread == pi->nwrite)
+    wakereaders(pi);
+  pi->nwrite = i;
+  release(&pi->lock);
+  return n;
+}
+
+// Read the next message from the pipe into the cnt user
+// buffers in iov, discarding whatever doesn't fit. Waits for
+// a message unless nonblock is set, in which case return
+// -EAGAIN. Returns the number of bytes read, 0 if the write
+// end is closed, or -1.
+int
+pipereadmsg(struct pipe *pi, struct iovec *iov, int cnt, int nonblock)
+{
+  uint n, i, m;
+  int tot = 0;
+  struct proc *pr = myproc();
+
+  acquire(&pi->lock);
+  while((pi->nread == pi->nwrite && pi->writeopen) || pi->rbusy){
+    if(pr->killed){
+      release(&pi->lock);
+      return -1;
+    }
+    if(nonblock){
+      release(&pi->lock);
+      return -EAGAIN;
+    }
+    if(pi->rbusy)
+      sleep(&pi->rbusy, &pi->lock);
+    else
+      sleep(&pi->nread, &pi->lock);
+  }
+  if(pi->nread == pi->nwrite){
+    release(&pi->lock);
+    return 0;
+  }
+  ringout(pi, pi->nread, 0, (uint64)&n, sizeof(n));
+  i = pi->nread + sizeof(n);
+  for(int v = 0; v < cnt && tot < n; v++){
+    m = min(iov[v].iov_len, n - tot);
+    if(ringout(pi, i, 1, (uint64)iov[v].iov_base, m) < 0){
+      release(&pi->lock);
+      return -1;
+    }
+    i += m;
+    tot += m;
+  }
+  // a writer may be waiting for room for a whole message,
+  // not just for the pipe to stop being full.
+  wakewriters(pi);
+  pi->nread += sizeof(n) + n;
+  release(&pi->lock);
+  return tot;
+}
+
+// Return the size of the pipe's buffer, in bytes.
+int
+pipesize(struct pipe *pi)
+{
+  int n;
+
+  acquire(&pi->lock);
+  n = pi->size;
+  release(&pi->lock);
+  return n;
+}
+
+// Resize the pipe's buffer to hold at least n bytes, keeping
+// its contents. Returns the new size, or -1 if n is too big,
+// or the pipe holds more than n bytes, or memory runs out.
+int
+pipesetsize(struct pipe *pi, int n)
+{
+  char *buf[PIPEMAX], *p;
+  uint size, i, j, m;
+  int npg;
+
+  if(n < 0 || n > PIPEMAX*PGSIZE)
+    return -1;
+  for(size = PGSIZE; size < n; size *= 2)
+    ;
+  npg = size / PGSIZE;
+  for(i = 0; i < npg; i++){
+    if((buf[i] = kalloc()) == 0){
+      while(i > 0)
+        kfree(buf[--i]);
+      return -1;
+    }
+  }
+
+  acquire(&pi->lock);
+  while(pi->rbusy || pi->wbusy)
+    sleep(pi->rbusy ? &pi->rbusy : &pi->wbusy, &pi->lock);
+  if(pi->nwrite - pi->nread > size){
+    release(&pi->lock);
+    for(i = 0; i < npg; i++)
+      kfree(buf[i]);
+    return -1;
+  }
+  // copy the contents to the start of the new ring.
+  for(i = pi->nread; i != pi->nwrite; i += m){
+    p = at(pi, i, &m);
+    j = i - pi->nread;
+    m = min(m, min(PGSIZE - j % PGSIZE, pi->nwrite - i));
+    memmove(buf[j / PGSIZE] + j % PGSIZE, p, m);
+  }
+  pi->nwrite -= pi->nread;
+  pi->nread = 0;
+  if(size > pi->size)
+    wakewriters(pi);
+  // swap, so that buf holds the old pages to free.
+  for(i = 0; i < PIPEMAX; i++){
+    p = pi->buf[i];
+    pi->buf[i] = i < npg ? buf[i] : 0;
+    buf[i] = p;
+  }
+  npg = pi->size / PGSIZE;
+  pi->size = size;
+  release(&pi->lock);
+
+  for(i = 0; i < npg; i++)
+    kfree(buf[i]);
+  return size;
+}
+
+// Reserve the write end of the pipe (write != 0) or its read
+// end for a splice, which then finds the data or room with
+// pipeptr(), and must call pipeend() when it is done.
+// For writing, return the number of free bytes, or -1 if the
+// read end is closed; if the pipe is full or another splice
+// holds the write end, wait if wait is set, else return
+// -EAGAIN without reserving it. For reading, wait for data
+// if wait is set, and return the number of bytes in the
+// pipe, 0 at end of file. Returns -1 if killed.
+int
+pipebegin(struct pipe *pi, int write, int wait)
+{
+  struct proc *pr = myproc();
+  int n;
+
+  acquire(&pi->lock);
+  for(;;){
+    if(pr->killed || (write && pi->readopen == 0)){
+      release(&pi->lock);
+      return -1;
+    }
+    if(write && !wait && (pi->wbusy || pi->nwrite == pi->nread + pi->size)){
+      release(&pi->lock);
+      return -EAGAIN;
+    }
+    if(write && pi->wbusy)
+      sleep(&pi->wbusy, &pi->lock);
+    else if(write && pi->nwrite == pi->nread + pi->size)
+      sleep(&pi->nwrite, &pi->lock);
+    else if(!write && pi->rbusy)
+      sleep(&pi->rbusy, &pi->lock);
+    else if(!write && wait && pi->nread == pi->nwrite && pi->writeopen)
+      sleep(&pi->nread, &pi->lock);
+    else
+      break;
+  }
+  if(write){
+    pi->wbusy = 1;
+    n = pi->nread + pi->size - pi->nwrite;
+  } else {
+    pi->rbusy = 1;
+    n = pi->nwrite - pi->nread;
+  }
+  release(&pi->lock);
+  return n;
+}
+
+// Return the address of the k'th free byte (write != 0) or
+// the k'th byte of data in a pipe reserved by pipebegin(), and
+// set *m to the number of bytes from there to the end of its
+// page. The holder of an end is the only one that moves it.
+char*
+pipeptr(struct pipe *pi, int write, uint k, uint *m)
+{
+  return at(pi, (write ? pi->nwrite : pi->nread) + k, m);
+}
+
+// Release an end of the pipe reserved by pipebegin(), having
+// written (or consumed) n bytes.
+void
+pipeend(struct pipe *pi, int write, uint n)
+{
+  acquire(&pi->lock);
+  if(write){
+    if(n > 0 && pi->nread == pi->nwrite)
+      wakereaders(pi);
+    pi->nwrite += n;
+    pi->wbusy = 0;
+    wakeup(&pi->wbusy);
+  } else {
+    if(n > 0 && pi->nwrite == pi->nread + pi->size)
+      wakewriters(pi);
+    pi->nread += n;
+    pi->rbusy = 0;
+    wakeup(&pi->rbusy);
+  }
+  release(&pi->lock);
+}
+
+// For poll(): put e on the pipe's wait queue, and return
+// POLLIN if the read end would not block, with POLLHUP if the
+// write end is closed, or POLLOUT if the write end would not
+// block, with POLLERR if the read end is closed.
+int
+pipepoll(struct pipe *pi, int writable, struct pollent *e)
+{
+  int r = 0;
+
+  acquire(&pi->lock);
+  pollwait(&pi->pollq, e);
+  if(writable){
+    if(pi->readopen == 0)
+      r = POLLOUT | POLLERR;
+    else if(pi->nwrite != pi->nread + pi->size)
+      r = POLLOUT;
+  } else {
+    if(pi->nread != pi->nwrite)
+      r = POLLIN;
+    if(pi->writeopen == 0)
+      r = POLLIN | POLLHUP;
+  }
+  release(&pi->lock);
+  return r;
+}
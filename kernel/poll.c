@@ -0,0 +1,183 @@
+//
+// poll(): wait for any of several files to be ready.
+//
+// A process can sleep on only one channel, so a process in
+// poll() can't sleep on the channels that piperead() and the
+// rest sleep on. Instead, each object a process can wait for
+// (a pipe, the console) has a wait queue, a list of pollents.
+// The first time pollfds() checks a file, the file's poll
+// function (pipepoll(), consolepoll()) puts an entry for the
+// process on the queue, with pollwait(), while it holds the
+// lock that protects the file's state, and then checks
+// whether the file is ready. Whatever changes that state
+// later calls pollwakeup(), with the same lock held, which
+// wakes the processes on the queue. So a process that finds
+// nothing ready can't miss the change that makes something
+// ready: it sleeps only if no pollwakeup() has set its woken
+// flag since it began checking.
+//
+// poll.lock protects all the wait queues and woken flags.
+// Lock order: an object's lock (a pipe's, cons.lock,
+// tickslock), then poll.lock.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "poll.h"
+
+// max fds in one poll(): as many pollfds and pairs of pollents
+// (a socket waits on two queues) as fit in the page that
+// pollfds() allocates, with a spare pollent for the clock.
+#define NPOLL ((PGSIZE - sizeof(struct pollent)) / (sizeof(struct pollfd) + 2*sizeof(struct pollent)))
+
+struct {
+  struct spinlock lock;
+  struct pollent *tickq;  // processes in poll() with a timeout
+} poll;
+
+void
+pollinit(void)
+{
+  initlock(&poll.lock, "poll");
+}
+
+// Put e on wait queue q, unless it is on a queue already.
+// The caller holds the lock of the object that q belongs to.
+void
+pollwait(struct pollent **q, struct pollent *e)
+{
+  acquire(&poll.lock);
+  if(e->q == 0){
+    e->q = q;
+    e->next = *q;
+    *q = e;
+  }
+  release(&poll.lock);
+}
+
+// Wake up the processes on wait queue q. The caller holds
+// the lock of the object that q belongs to, so no entry can
+// be added while q looks empty.
+void
+pollwakeup(struct pollent **q)
+{
+  struct pollent *e;
+
+  if(*q == 0)
+    return;
+  acquire(&poll.lock);
+  for(e = *q; e; e = e->next){
+    *e->woken = 1;
+    wakeup(e->woken);
+  }
+  release(&poll.lock);
+}
+
+// Take e off its wait queue, if it is on one.
+static void
+pollunwait(struct pollent *e)
+{
+  struct pollent **pp;
+
+  acquire(&poll.lock);
+  if(e->q){
+    for(pp = e->q; *pp != e; pp = &(*pp)->next)
+      ;
+    *pp = e->next;
+    e->q = 0;
+  }
+  release(&poll.lock);
+}
+
+// Called by clockintr(), with tickslock held.
+void
+polltick(void)
+{
+  pollwakeup(&poll.tickq);
+}
+
+// Check the nfds struct pollfds at user address addr, and
+// set their revents. If none is ready, wait until one is, or
+// for timeout clock ticks if timeout isn't negative. Returns
+// the number of pollfds with events, 0 if the time ran out,
+// or -1.
+int
+pollfds(uint64 addr, int nfds, int timeout)
+{
+  struct proc *p = myproc();
+  struct pollfd *fds;
+  struct pollent *ents;
+  struct file *f;
+  int i, n, woken, r;
+  uint t0;
+
+  if(nfds < 0 || nfds > NPOLL)
+    return -1;
+  if((fds = (struct pollfd*)kalloc()) == 0)
+    return -1;
+  ents = (struct pollent*)(fds + NPOLL);
+  if(copyin(p->pagetable, (char*)fds, addr, nfds*sizeof(struct pollfd)) < 0){
+    kfree((char*)fds);
+    return -1;
+  }
+  for(i = 0; i <= 2*nfds; i++){
+    ents[i].woken = &woken;
+    ents[i].q = 0;
+  }
+  acquire(&tickslock);
+  t0 = ticks;
+  release(&tickslock);
+
+  for(;;){
+    acquire(&poll.lock);
+    woken = 0;
+    release(&poll.lock);
+
+    n = 0;
+    for(i = 0; i < nfds; i++){
+      fds[i].revents = 0;
+      if(fds[i].fd < 0)
+        continue;
+      if(fds[i].fd >= NOFILE || (f = p->ofile[fds[i].fd]) == 0)
+        r = POLLNVAL;
+      else
+        r = filepoll(f, &ents[2*i]) & (fds[i].events | POLLERR | POLLHUP);
+      if((fds[i].revents = r) != 0)
+        n++;
+    }
+    if(n > 0 || timeout == 0)
+      break;
+    if(timeout > 0){
+      acquire(&tickslock);
+      r = ticks - t0 >= timeout;
+      if(!r)
+        pollwait(&poll.tickq, &ents[2*nfds]);
+      release(&tickslock);
+      if(r)
+        break;
+    }
+
+    acquire(&poll.lock);
+    if(!woken)
+      sleep(&woken, &poll.lock);
+    release(&poll.lock);
+    if(p->killed){
+      n = -1;
+      break;
+    }
+  }
+
+  for(i = 0; i <= 2*nfds; i++)
+    pollunwait(&ents[i]);
+  if(n >= 0 && copyout(p->pagetable, addr, (char*)fds, nfds*sizeof(struct pollfd)) < 0)
+    n = -1;
+  kfree((char*)fds);
+  return n;
+}
@@ -0,0 +1,13 @@
+// poll() requests and results.
+
+#define POLLIN   0x001  // there is data to read
+#define POLLOUT  0x004  // writing won't block
+#define POLLERR  0x008  // error: for a pipe, the read end is closed
+#define POLLHUP  0x010  // hang up: the write end of a pipe is closed
+#define POLLNVAL 0x020  // fd isn't open
+
+struct pollfd {
+  int fd;         // file descriptor, or negative to ignore
+  short events;   // POLLIN and/or POLLOUT
+  short revents;  // returned events
+};
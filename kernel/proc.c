@@ -5,6 +5,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "vdso.h"
 
 struct cpu cpus[NCPU];
 
@@ -16,6 +17,7 @@ int nextpid = 1;
 struct spinlock pid_lock;
 
 extern void forkret(void);
+static void kthreadret(void);
 static void freeproc(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
@@ -127,6 +129,15 @@ found:
     return 0;
   }
 
+  // Allocate the process's vDSO page.
+  if((p->vproc = (struct vproc *)kalloc()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+  memset(p->vproc, 0, PGSIZE);
+  p->vproc->pid = p->pid;
+
   // An empty user page table.
   p->pagetable = proc_pagetable(p);
   if(p->pagetable == 0){
@@ -153,9 +164,14 @@ freeproc(struct proc *p)
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
+  if(p->vproc)
+    kfree((void*)p->vproc);
+  p->vproc = 0;
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
+  if(p->uring)
+    uringfree(p);
   p->sz = 0;
   p->pid = 0;
   p->parent = 0;
@@ -163,6 +179,8 @@ freeproc(struct proc *p)
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  p->kfn = 0;
+  p->iopoll = 0;
   p->state = UNUSED;
 }
 
@@ -196,6 +214,14 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the vDSO pages below the trapframe.
+  if(vdsomap(pagetable, p) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
@@ -206,6 +232,9 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  vdsounmap(pagetable);
+  if(walkaddr(pagetable, URING))
+    uvmunmap(pagetable, URING, 1, 0);
   uvmfree(pagetable, sz);
 }
 
@@ -247,6 +276,24 @@ userinit(void)
   release(&p->lock);
 }
 
+// Start a kernel thread: a process that runs fn() in the
+// kernel, never returns to user space, and never exits.
+void
+kthread(char *name, void (*fn)(void))
+{
+  struct proc *p;
+
+  p = allocproc();
+  if(p == 0)
+    panic("kthread");
+  p->kfn = fn;
+  p->context.ra = (uint64)kthreadret;
+  safestrcpy(p->name, name, sizeof(p->name));
+  p->state = RUNNABLE;
+
+  release(&p->lock);
+}
+
 // Grow or shrink user memory by n bytes.
 // Return 0 on success, -1 on failure.
 int
@@ -453,6 +500,7 @@ scheduler(void)
         // before jumping back to us.
         p->state = RUNNING;
         c->proc = p;
+        p->vproc->hart = cpuid();
         swtch(&c->context, &p->context);
 
         // Process is done running for now.
@@ -523,6 +571,18 @@ forkret(void)
   usertrapret();
 }
 
+// A kernel thread's very first scheduling by scheduler()
+// will swtch to kthreadret.
+static void
+kthreadret(void)
+{
+  // Still holding p->lock from scheduler.
+  release(&myproc()->lock);
+
+  myproc()->kfn();
+  panic("kthread returned");
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
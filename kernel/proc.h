@@ -101,8 +101,15 @@ struct proc {
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
+  struct vproc *vproc;         // read-only page for user space, at VPROC
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  struct buf *plug;            // Writes held back by blk_plug()
+  struct snappage *snaps;      // Memory for plug's snapshots
+  int plugged;                 // blk_plug() nesting depth
+  int iopoll;                  // wait for the disk by polling; see blk.c
+  void (*kfn)(void);           // Kernel thread body, if a kernel thread
+  struct uring *uring;         // Shared system call rings, mapped at URING
   char name[16];               // Process name (debugging)
 };
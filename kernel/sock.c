@@ -0,0 +1,302 @@
+//
+// Local sockets.
+//
+// A process names a socket with bind(), which makes a T_SOCK
+// inode at a path, and waits for connections with listen().
+// connect() to that path, from any process, makes a pair of
+// pipes (see pipe.c), one for each direction, and queues a
+// new socket holding the other ends on the listener, for
+// accept() to take. So a connected socket is the read end of
+// one pipe and the write end of another, with SOCKBUF bytes
+// of page-ring buffer each way. A SOCK_SEQPACKET socket reads
+// and writes its pipes a whole message at a time.
+//
+// stable.lock protects the sockets' states and the listeners'
+// queues; the pipes have their own locks.
+// Lock order: stable.lock, then poll.lock.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "poll.h"
+#include "fcntl.h"
+#include "uio.h"
+#include "socket.h"
+
+enum sockstate { SS_FREE, SS_NEW, SS_BINDING, SS_LISTEN, SS_CONNECTED };
+
+struct sock {
+  enum sockstate state;
+  int type;             // SOCK_STREAM or SOCK_SEQPACKET
+  struct inode *ip;     // name, once bound
+  struct sock *queue;   // listener: connections to accept
+  int nqueue;
+  int backlog;          // listener: max nqueue
+  struct pollent *pollq; // listener: processes in poll()
+  struct pipe *rx;      // connected: data from the peer
+  struct pipe *tx;      // connected: data to the peer
+  struct sock *next;    // on a listener's queue
+};
+
+struct {
+  struct spinlock lock;
+  struct sock sock[NSOCK];
+} stable;
+
+void
+sockinit(void)
+{
+  initlock(&stable.lock, "sock");
+}
+
+// Find a free socket. Caller holds stable.lock.
+static struct sock*
+salloc(int type, enum sockstate state)
+{
+  struct sock *s;
+
+  for(s = stable.sock; s < stable.sock + NSOCK; s++){
+    if(s->state == SS_FREE){
+      memset(s, 0, sizeof(*s));
+      s->state = state;
+      s->type = type;
+      return s;
+    }
+  }
+  return 0;
+}
+
+// Allocate a new, unconnected socket.
+struct sock*
+sockalloc(int type)
+{
+  struct sock *s;
+
+  if(type != SOCK_STREAM && type != SOCK_SEQPACKET)
+    return 0;
+  acquire(&stable.lock);
+  s = salloc(type, SS_NEW);
+  release(&stable.lock);
+  return s;
+}
+
+// Close a socket, which no file refers to any more.
+void
+sockclose(struct sock *s)
+{
+  struct sock *q, *next;
+
+  acquire(&stable.lock);
+  q = s->queue;
+  s->queue = 0;
+  if(s->state == SS_LISTEN)
+    s->state = SS_NEW;  // no more connections
+  release(&stable.lock);
+
+  // connections that were never accepted.
+  for(; q; q = next){
+    next = q->next;
+    sockclose(q);
+  }
+  if(s->state == SS_CONNECTED){
+    pipeclose(s->rx, 0);
+    pipeclose(s->tx, 1);
+  }
+  if(s->ip){
+    begin_op();
+    iput(s->ip);
+    end_op();
+  }
+  acquire(&stable.lock);
+  s->state = SS_FREE;
+  release(&stable.lock);
+}
+
+// Start to bind s, before its name is made, so that a socket
+// that can't be bound doesn't leave a name behind.
+int
+sockbind(struct sock *s)
+{
+  int r = -1;
+
+  acquire(&stable.lock);
+  if(s->state == SS_NEW && s->ip == 0){
+    s->state = SS_BINDING;
+    r = 0;
+  }
+  release(&stable.lock);
+  return r;
+}
+
+// Finish binding s: give it the name ip, a T_SOCK inode, or
+// none if ip is 0. Takes over the caller's reference to ip.
+void
+socknamed(struct sock *s, struct inode *ip)
+{
+  acquire(&stable.lock);
+  s->ip = ip;
+  s->state = SS_NEW;
+  release(&stable.lock);
+}
+
+// Let up to backlog connections wait for accept() on s.
+int
+socklisten(struct sock *s, int backlog)
+{
+  int r = -1;
+
+  acquire(&stable.lock);
+  if((s->state == SS_NEW && s->ip) || s->state == SS_LISTEN){
+    s->state = SS_LISTEN;
+    if(backlog < 1)
+      backlog = 1;
+    s->backlog = backlog < SOMAXCONN ? backlog : SOMAXCONN;
+    r = 0;
+  }
+  release(&stable.lock);
+  return r;
+}
+
+// Connect s to the socket listening on ip. Fails if there
+// is none, or its queue is full.
+int
+sockconnect(struct sock *s, struct inode *ip)
+{
+  struct pipe *a, *b;
+  struct sock *l, *n, **pp;
+
+  a = pipenew();
+  b = pipenew();
+  if(a == 0 || b == 0 || pipesetsize(a, SOCKBUF) < 0 || pipesetsize(b, SOCKBUF) < 0)
+    goto bad;
+
+  acquire(&stable.lock);
+  for(l = stable.sock; l < stable.sock + NSOCK; l++)
+    if(l->state == SS_LISTEN && l->ip == ip && l->type == s->type)
+      break;
+  if(s->state != SS_NEW || l == stable.sock + NSOCK || l->nqueue >= l->backlog ||
+     (n = salloc(s->type, SS_CONNECTED)) == 0){
+    release(&stable.lock);
+    goto bad;
+  }
+  n->rx = a;
+  n->tx = b;
+  s->rx = b;
+  s->tx = a;
+  s->state = SS_CONNECTED;
+  for(pp = &l->queue; *pp; pp = &(*pp)->next)
+    ;
+  *pp = n;
+  l->nqueue++;
+  wakeup(l);
+  pollwakeup(&l->pollq);
+  release(&stable.lock);
+  return 0;
+
+ bad:
+  for(int i = 0; i < 2; i++){
+    if(a)
+      pipeclose(a, i);
+    if(b)
+      pipeclose(b, i);
+  }
+  return -1;
+}
+
+// Wait for a connection to listener l, and set *ns to the
+// new socket for it. Returns 0, -1, or -EAGAIN if there is
+// none and nonblock is set.
+int
+sockaccept(struct sock *l, int nonblock, struct sock **ns)
+{
+  struct proc *p = myproc();
+
+  acquire(&stable.lock);
+  while(l->state == SS_LISTEN && l->queue == 0){
+    if(p->killed || nonblock){
+      release(&stable.lock);
+      return p->killed ? -1 : -EAGAIN;
+    }
+    sleep(l, &stable.lock);
+  }
+  if(l->state != SS_LISTEN){
+    release(&stable.lock);
+    return -1;
+  }
+  *ns = l->queue;
+  l->queue = (*ns)->next;
+  l->nqueue--;
+  release(&stable.lock);
+  return 0;
+}
+
+// Set *rx and *tx to the pipes of s, if it is connected;
+// else return -1.
+static int
+sockpipes(struct sock *s, struct pipe **rx, struct pipe **tx)
+{
+  int r = -1;
+
+  acquire(&stable.lock);
+  if(s->state == SS_CONNECTED){
+    *rx = s->rx;
+    *tx = s->tx;
+    r = 0;
+  }
+  release(&stable.lock);
+  return r;
+}
+
+int
+sockread(struct sock *s, struct iovec *iov, int cnt, int nonblock)
+{
+  struct pipe *rx, *tx;
+
+  if(sockpipes(s, &rx, &tx) < 0)
+    return -1;
+  if(s->type == SOCK_SEQPACKET)
+    return pipereadmsg(rx, iov, cnt, nonblock);
+  return pipereadv(rx, iov, cnt, nonblock);
+}
+
+int
+sockwrite(struct sock *s, struct iovec *iov, int cnt, int nonblock)
+{
+  struct pipe *rx, *tx;
+
+  if(sockpipes(s, &rx, &tx) < 0)
+    return -1;
+  if(s->type == SOCK_SEQPACKET)
+    return pipewritemsg(tx, iov, cnt, nonblock);
+  return pipewritev(tx, iov, cnt, nonblock);
+}
+
+// For poll(): a listener is ready for reading when a
+// connection is waiting for accept(); a connected socket is
+// ready when its pipes are. e points to two pollents, one
+// for each pipe.
+int
+sockpoll(struct sock *s, struct pollent *e)
+{
+  struct pipe *rx, *tx;
+  int r;
+
+  acquire(&stable.lock);
+  if(s->state == SS_LISTEN){
+    pollwait(&s->pollq, &e[0]);
+    r = s->queue ? POLLIN : 0;
+    release(&stable.lock);
+    return r;
+  }
+  release(&stable.lock);
+  if(sockpipes(s, &rx, &tx) < 0)
+    return 0;
+  return pipepoll(rx, 0, &e[0]) | pipepoll(tx, 1, &e[1]);
+}
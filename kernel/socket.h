@@ -0,0 +1,7 @@
+// Local sockets; see sock.c.
+
+// socket() types
+#define SOCK_STREAM    1  // a byte stream, like a pipe
+#define SOCK_SEQPACKET 5  // messages, each read whole
+
+#define SOMAXCONN 16  // max connections waiting for accept()
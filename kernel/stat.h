@@ -1,6 +1,7 @@
 #define T_DIR     1   // Directory
 #define T_FILE    2   // File
 #define T_DEVICE  3   // Device
+#define T_SOCK    4   // Name of a local socket
 
 struct stat {
   int dev;     // File system's disk device
@@ -8,4 +9,6 @@ struct stat {
   short type;  // Type of file
   short nlink; // Number of links to file
   uint64 size; // Size of file in bytes
+  uint nmeta;  // Blocks holding the file's block map
+  uint nextent; // Runs of contiguous disk blocks holding the data
 };
@@ -104,6 +104,26 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_wait(void);
 extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
+extern uint64 sys_iostat(void);
+extern uint64 sys_iopoll(void);
+extern uint64 sys_sync(void);
+extern uint64 sys_fsync(void);
+extern uint64 sys_fcntl(void);
+extern uint64 sys_splice(void);
+extern uint64 sys_tee(void);
+extern uint64 sys_copy_file_range(void);
+extern uint64 sys_poll(void);
+extern uint64 sys_readv(void);
+extern uint64 sys_writev(void);
+extern uint64 sys_pread(void);
+extern uint64 sys_pwrite(void);
+extern uint64 sys_uring_setup(void);
+extern uint64 sys_uring_enter(void);
+extern uint64 sys_socket(void);
+extern uint64 sys_bind(void);
+extern uint64 sys_listen(void);
+extern uint64 sys_accept(void);
+extern uint64 sys_connect(void);
 
 static uint64 (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -127,6 +147,26 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_iostat]  sys_iostat,
+[SYS_iopoll]  sys_iopoll,
+[SYS_sync]    sys_sync,
+[SYS_fsync]   sys_fsync,
+[SYS_fcntl]   sys_fcntl,
+[SYS_splice]  sys_splice,
+[SYS_tee]     sys_tee,
+[SYS_copy_file_range] sys_copy_file_range,
+[SYS_poll]    sys_poll,
+[SYS_readv]   sys_readv,
+[SYS_writev]  sys_writev,
+[SYS_pread]   sys_pread,
+[SYS_pwrite]  sys_pwrite,
+[SYS_uring_setup] sys_uring_setup,
+[SYS_uring_enter] sys_uring_enter,
+[SYS_socket]  sys_socket,
+[SYS_bind]    sys_bind,
+[SYS_listen]  sys_listen,
+[SYS_accept]  sys_accept,
+[SYS_connect] sys_connect,
 };
 
 void
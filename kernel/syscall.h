@@ -20,3 +20,23 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_iostat 22
+#define SYS_iopoll 23
+#define SYS_sync   24
+#define SYS_fsync  25
+#define SYS_fcntl  26
+#define SYS_splice 27
+#define SYS_tee    28
+#define SYS_copy_file_range 29
+#define SYS_poll   30
+#define SYS_readv  31
+#define SYS_writev 32
+#define SYS_pread  33
+#define SYS_pwrite 34
+#define SYS_uring_setup 35
+#define SYS_uring_enter 36
+#define SYS_socket  37
+#define SYS_bind    38
+#define SYS_listen  39
+#define SYS_accept  40
+#define SYS_connect 41
@@ -15,6 +15,9 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "uio.h"
+#include "uring.h"
+#include "socket.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -35,6 +38,33 @@ argfd(int n, int *pfd, struct file **pf)
   return 0;
 }
 
+// Path names (MAXPATH bytes) and path elements (DIRSIZ) are
+// too big to keep on the kernel stack, which namex() and the
+// directory code below also need, so system calls keep them
+// in a page from kalloc().
+struct pathbuf {
+  char path[MAXPATH];
+  char path2[MAXPATH];  // link()'s new name
+  char name[DIRSIZ];    // the final element, for nameiparent()
+};
+
+// Fetch the nth system call argument as a path name, into
+// pb->path of a new pathbuf, which the caller must kfree().
+// Returns 0 on error.
+static struct pathbuf*
+argpath(int n)
+{
+  struct pathbuf *pb;
+
+  if((pb = (struct pathbuf*)kalloc()) == 0)
+    return 0;
+  if(argstr(n, pb->path, MAXPATH) < 0){
+    kfree((char*)pb);
+    return 0;
+  }
+  return pb;
+}
+
 // Allocate a file descriptor for the given file.
 // Takes over file reference from caller on success.
 static int
@@ -91,6 +121,137 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+// Fetch the nth word-sized system call argument as an array
+// of *cnt iovecs, which the (n+1)th argument counts, into iov.
+static int
+argiov(int n, struct iovec *iov, int *cnt)
+{
+  uint64 addr, tot;
+
+  if(argaddr(n, &addr) < 0 || argint(n+1, cnt) < 0)
+    return -1;
+  if(*cnt < 0 || *cnt > IOV_MAX)
+    return -1;
+  if(copyin(myproc()->pagetable, (char*)iov, addr, *cnt * sizeof(struct iovec)) < 0)
+    return -1;
+  tot = 0;
+  for(int i = 0; i < *cnt; i++){
+    if(iov[i].iov_len > 0x7fffffff)
+      return -1;
+    tot += iov[i].iov_len;
+  }
+  if(tot > 0x7fffffff)
+    return -1;
+  return 0;
+}
+
+// Read into several buffers at once.
+uint64
+sys_readv(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int cnt;
+
+  if(argfd(0, 0, &f) < 0 || argiov(1, iov, &cnt) < 0)
+    return -1;
+  return filereadv(f, iov, cnt);
+}
+
+// Write from several buffers at once.
+uint64
+sys_writev(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int cnt;
+
+  if(argfd(0, 0, &f) < 0 || argiov(1, iov, &cnt) < 0)
+    return -1;
+  return filewritev(f, iov, cnt);
+}
+
+// Read from a file at a given offset, leaving the file's
+// own offset alone.
+uint64
+sys_pread(void)
+{
+  struct file *f;
+  int n, off;
+  uint64 p;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &p) < 0 || argint(2, &n) < 0 || argint(3, &off) < 0)
+    return -1;
+  if(off < 0)
+    return -1;
+  return filepread(f, p, n, off);
+}
+
+// Write to a file at a given offset, leaving the file's
+// own offset alone.
+uint64
+sys_pwrite(void)
+{
+  struct file *f;
+  int n, off;
+  uint64 p;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &p) < 0 || argint(2, &n) < 0 || argint(3, &off) < 0)
+    return -1;
+  if(off < 0)
+    return -1;
+  return filepwrite(f, p, n, off);
+}
+
+// Move data between a pipe and a file, or two pipes,
+// without copying it through user space.
+uint64
+sys_splice(void)
+{
+  struct file *in, *out;
+  int n;
+
+  if(argfd(0, 0, &in) < 0 || argfd(1, 0, &out) < 0 || argint(2, &n) < 0)
+    return -1;
+  return filesplice(in, out, n, 0);
+}
+
+// Copy data from one pipe to another, leaving it in the first.
+uint64
+sys_tee(void)
+{
+  struct file *in, *out;
+  int n;
+
+  if(argfd(0, 0, &in) < 0 || argfd(1, 0, &out) < 0 || argint(2, &n) < 0)
+    return -1;
+  return filesplice(in, out, n, 1);
+}
+
+// Copy data from one file to another in the kernel.
+uint64
+sys_copy_file_range(void)
+{
+  struct file *in, *out;
+  int n;
+
+  if(argfd(0, 0, &in) < 0 || argfd(1, 0, &out) < 0 || argint(2, &n) < 0)
+    return -1;
+  return filecopy(in, out, n);
+}
+
+// Wait for any of several file descriptors to be ready.
+uint64
+sys_poll(void)
+{
+  uint64 fds;
+  int nfds, timeout;
+
+  if(argaddr(0, &fds) < 0 || argint(1, &nfds) < 0 || argint(2, &timeout) < 0)
+    return -1;
+  return pollfds(fds, nfds, timeout);
+}
+
 uint64
 sys_close(void)
 {
@@ -119,15 +280,20 @@ sys_fstat(void)
 uint64
 sys_link(void)
 {
-  char name[DIRSIZ], new[MAXPATH], old[MAXPATH];
+  struct pathbuf *pb;
   struct inode *dp, *ip;
 
-  if(argstr(0, old, MAXPATH) < 0 || argstr(1, new, MAXPATH) < 0)
+  if((pb = argpath(0)) == 0)
+    return -1;
+  if(argstr(1, pb->path2, MAXPATH) < 0){
+    kfree((char*)pb);
     return -1;
+  }
 
   begin_op();
-  if((ip = namei(old)) == 0){
+  if((ip = namei(pb->path)) == 0){
     end_op();
+    kfree((char*)pb);
     return -1;
   }
 
@@ -135,6 +301,7 @@ sys_link(void)
   if(ip->type == T_DIR){
     iunlockput(ip);
     end_op();
+    kfree((char*)pb);
     return -1;
   }
 
@@ -142,10 +309,10 @@ sys_link(void)
   iupdate(ip);
   iunlock(ip);
 
-  if((dp = nameiparent(new, name)) == 0)
+  if((dp = nameiparent(pb->path2, pb->name)) == 0)
     goto bad;
   ilock(dp);
-  if(dp->dev != ip->dev || dirlink(dp, name, ip->inum) < 0){
+  if(dp->dev != ip->dev || dirlink(dp, pb->name, ip->inum) < 0){
     iunlockput(dp);
     goto bad;
   }
@@ -153,6 +320,7 @@ sys_link(void)
   iput(ip);
 
   end_op();
+  kfree((char*)pb);
 
   return 0;
 
@@ -162,6 +330,7 @@ bad:
   iupdate(ip);
   iunlockput(ip);
   end_op();
+  kfree((char*)pb);
   return -1;
 }
 
@@ -169,13 +338,17 @@ bad:
 static int
 isdirempty(struct inode *dp)
 {
-  int off;
+  uint off;
+  int n;
   struct dirent de;
 
-  for(off=2*sizeof(de); off<dp->size; off+=sizeof(de)){
+  // "." and ".." are the first two entries.
+  for(off = 0, n = 0; off < dp->size; off += de.reclen, n++){
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
       panic("isdirempty: readi");
-    if(de.inum != 0)
+    if(de.reclen == 0)
+      panic("isdirempty: reclen");
+    if(n >= 2 && de.inum != 0)
       return 0;
   }
   return 1;
@@ -185,16 +358,18 @@ uint64
 sys_unlink(void)
 {
   struct inode *ip, *dp;
-  struct dirent de;
-  char name[DIRSIZ], path[MAXPATH];
+  struct pathbuf *pb;
+  char *name;
   uint off;
 
-  if(argstr(0, path, MAXPATH) < 0)
+  if((pb = argpath(0)) == 0)
     return -1;
+  name = pb->name;
 
   begin_op();
-  if((dp = nameiparent(path, name)) == 0){
+  if((dp = nameiparent(pb->path, name)) == 0){
     end_op();
+    kfree((char*)pb);
     return -1;
   }
 
@@ -215,9 +390,7 @@ sys_unlink(void)
     goto bad;
   }
 
-  memset(&de, 0, sizeof(de));
-  if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-    panic("unlink: writei");
+  dirunlink(dp, name, off);
   if(ip->type == T_DIR){
     dp->nlink--;
     iupdate(dp);
@@ -229,22 +402,25 @@ sys_unlink(void)
   iunlockput(ip);
 
   end_op();
+  kfree((char*)pb);
 
   return 0;
 
 bad:
   iunlockput(dp);
   end_op();
+  kfree((char*)pb);
   return -1;
 }
 
+// Create pb->path, using pb->name.
 static struct inode*
-create(char *path, short type, short major, short minor)
+create(struct pathbuf *pb, short type, short major, short minor)
 {
   struct inode *ip, *dp;
-  char name[DIRSIZ];
+  char *name = pb->name;
 
-  if((dp = nameiparent(path, name)) == 0)
+  if((dp = nameiparent(pb->path, name)) == 0)
     return 0;
 
   ilock(dp);
@@ -283,33 +459,29 @@ create(char *path, short type, short major, short minor)
   return ip;
 }
 
-uint64
-sys_open(void)
+// Open pb->path in mode omode, and return a new fd for it, or -1.
+static int
+openpath(struct pathbuf *pb, int omode)
 {
-  char path[MAXPATH];
-  int fd, omode;
+  int fd;
   struct file *f;
   struct inode *ip;
-  int n;
-
-  if((n = argstr(0, path, MAXPATH)) < 0 || argint(1, &omode) < 0)
-    return -1;
 
   begin_op();
 
   if(omode & O_CREATE){
-    ip = create(path, T_FILE, 0, 0);
+    ip = create(pb, T_FILE, 0, 0);
     if(ip == 0){
       end_op();
       return -1;
     }
   } else {
-    if((ip = namei(path)) == 0){
+    if((ip = namei(pb->path)) == 0){
       end_op();
       return -1;
     }
     ilock(ip);
-    if(ip->type == T_DIR && omode != O_RDONLY){
+    if((ip->type == T_DIR || ip->type == T_SOCK) && omode != O_RDONLY){
       iunlockput(ip);
       end_op();
       return -1;
@@ -340,6 +512,7 @@ sys_open(void)
   f->ip = ip;
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+  f->nonblock = (omode & O_NONBLOCK) != 0;
 
   if((omode & O_TRUNC) && ip->type == T_FILE){
     itrunc(ip);
@@ -351,51 +524,67 @@ sys_open(void)
   return fd;
 }
 
+uint64
+sys_open(void)
+{
+  struct pathbuf *pb;
+  int omode, fd;
+
+  if(argint(1, &omode) < 0 || (pb = argpath(0)) == 0)
+    return -1;
+  fd = openpath(pb, omode);
+  kfree((char*)pb);
+  return fd;
+}
+
 uint64
 sys_mkdir(void)
 {
-  char path[MAXPATH];
+  struct pathbuf *pb;
   struct inode *ip;
 
-  begin_op();
-  if(argstr(0, path, MAXPATH) < 0 || (ip = create(path, T_DIR, 0, 0)) == 0){
-    end_op();
+  if((pb = argpath(0)) == 0)
     return -1;
-  }
-  iunlockput(ip);
+  begin_op();
+  ip = create(pb, T_DIR, 0, 0);
+  if(ip)
+    iunlockput(ip);
   end_op();
-  return 0;
+  kfree((char*)pb);
+  return ip ? 0 : -1;
 }
 
 uint64
 sys_mknod(void)
 {
   struct inode *ip;
-  char path[MAXPATH];
+  struct pathbuf *pb;
   int major, minor;
 
-  begin_op();
-  if((argstr(0, path, MAXPATH)) < 0 ||
-     argint(1, &major) < 0 ||
-     argint(2, &minor) < 0 ||
-     (ip = create(path, T_DEVICE, major, minor)) == 0){
-    end_op();
+  if(argint(1, &major) < 0 || argint(2, &minor) < 0 || (pb = argpath(0)) == 0)
     return -1;
-  }
-  iunlockput(ip);
+  begin_op();
+  ip = create(pb, T_DEVICE, major, minor);
+  if(ip)
+    iunlockput(ip);
   end_op();
-  return 0;
+  kfree((char*)pb);
+  return ip ? 0 : -1;
 }
 
 uint64
 sys_chdir(void)
 {
-  char path[MAXPATH];
+  struct pathbuf *pb;
   struct inode *ip;
   struct proc *p = myproc();
   
+  if((pb = argpath(0)) == 0)
+    return -1;
   begin_op();
-  if(argstr(0, path, MAXPATH) < 0 || (ip = namei(path)) == 0){
+  ip = namei(pb->path);
+  kfree((char*)pb);
+  if(ip == 0){
     end_op();
     return -1;
   }
@@ -415,11 +604,12 @@ sys_chdir(void)
 uint64
 sys_exec(void)
 {
-  char path[MAXPATH], *argv[MAXARG];
+  char *argv[MAXARG];
+  struct pathbuf *pb;
   int i;
   uint64 uargv, uarg;
 
-  if(argstr(0, path, MAXPATH) < 0 || argaddr(1, &uargv) < 0){
+  if(argaddr(1, &uargv) < 0 || (pb = argpath(0)) == 0){
     return -1;
   }
   memset(argv, 0, sizeof(argv));
@@ -441,16 +631,18 @@ sys_exec(void)
       goto bad;
   }
 
-  int ret = exec(path, argv);
+  int ret = exec(pb->path, argv);
 
   for(i = 0; i < NELEM(argv) && argv[i] != 0; i++)
     kfree(argv[i]);
+  kfree((char*)pb);
 
   return ret;
 
  bad:
   for(i = 0; i < NELEM(argv) && argv[i] != 0; i++)
     kfree(argv[i]);
+  kfree((char*)pb);
   return -1;
 }
 
@@ -484,3 +676,237 @@ sys_pipe(void)
   }
   return 0;
 }
+
+// Local sockets; see sock.c.
+uint64
+sys_socket(void)
+{
+  int type, fd;
+  struct sock *s;
+  struct file *f;
+
+  if(argint(0, &type) < 0)
+    return -1;
+  if((s = sockalloc(type)) == 0)
+    return -1;
+  if((f = filealloc()) == 0){
+    sockclose(s);
+    return -1;
+  }
+  f->type = FD_SOCK;
+  f->sock = s;
+  f->readable = 1;
+  f->writable = 1;
+  f->nonblock = 0;
+  if((fd = fdalloc(f)) < 0){
+    fileclose(f);
+    return -1;
+  }
+  return fd;
+}
+
+uint64
+sys_bind(void)
+{
+  struct pathbuf *pb;
+  struct file *f;
+  struct inode *ip;
+
+  if(argfd(0, 0, &f) < 0 || f->type != FD_SOCK || (pb = argpath(1)) == 0)
+    return -1;
+  if(sockbind(f->sock) < 0){
+    kfree((char*)pb);
+    return -1;
+  }
+  begin_op();
+  if((ip = create(pb, T_SOCK, 0, 0)) != 0)
+    iunlock(ip);
+  end_op();
+  kfree((char*)pb);
+  socknamed(f->sock, ip);
+  return ip ? 0 : -1;
+}
+
+uint64
+sys_listen(void)
+{
+  struct file *f;
+  int backlog;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &backlog) < 0)
+    return -1;
+  if(f->type != FD_SOCK)
+    return -1;
+  return socklisten(f->sock, backlog);
+}
+
+uint64
+sys_accept(void)
+{
+  struct file *f, *nf;
+  struct sock *ns;
+  int r, fd;
+
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  if(f->type != FD_SOCK)
+    return -1;
+  if((nf = filealloc()) == 0)
+    return -1;
+  if((r = sockaccept(f->sock, f->nonblock, &ns)) < 0){
+    fileclose(nf);
+    return r;
+  }
+  nf->type = FD_SOCK;
+  nf->sock = ns;
+  nf->readable = 1;
+  nf->writable = 1;
+  nf->nonblock = 0;
+  if((fd = fdalloc(nf)) < 0){
+    fileclose(nf);
+    return -1;
+  }
+  return fd;
+}
+
+uint64
+sys_connect(void)
+{
+  struct pathbuf *pb;
+  struct file *f;
+  struct inode *ip;
+  int r;
+
+  if(argfd(0, 0, &f) < 0 || f->type != FD_SOCK || (pb = argpath(1)) == 0)
+    return -1;
+  begin_op();
+  ip = namei(pb->path);
+  kfree((char*)pb);
+  if(ip == 0){
+    end_op();
+    return -1;
+  }
+  r = sockconnect(f->sock, ip);
+  iput(ip);
+  end_op();
+  return r;
+}
+
+// write back all delayed file data, and commit every
+// finished file system operation to the log.
+uint64
+sys_sync(void)
+{
+  wbsync();
+  log_force();
+  return 0;
+}
+
+// write back f's delayed data, and commit every
+// finished file system operation to the log.
+static int
+syncfile(struct file *f)
+{
+  if(f->type == FD_INODE)
+    iflush(f->ip);
+  log_force();
+  return 0;
+}
+
+uint64
+sys_fsync(void)
+{
+  struct file *f;
+
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  return syncfile(f);
+}
+
+uint64
+sys_fcntl(void)
+{
+  struct file *f;
+  int cmd, arg;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &cmd) < 0 || argint(2, &arg) < 0)
+    return -1;
+  switch(cmd){
+  case F_GETFL:
+    return (f->readable ? (f->writable ? O_RDWR : O_RDONLY) : O_WRONLY) |
+           (f->nonblock ? O_NONBLOCK : 0);
+  case F_SETFL:
+    f->nonblock = (arg & O_NONBLOCK) != 0;
+    return 0;
+  case F_GETPIPE_SZ:
+    if(f->type != FD_PIPE)
+      return -1;
+    return pipesize(f->pipe);
+  case F_SETPIPE_SZ:
+    if(f->type != FD_PIPE)
+      return -1;
+    return pipesetsize(f->pipe, arg);
+  }
+  return -1;
+}
+
+// Shared system call rings; see uring.c.
+uint64
+sys_uring_setup(void)
+{
+  return uringsetup();
+}
+
+uint64
+sys_uring_enter(void)
+{
+  int n;
+
+  if(argint(0, &n) < 0)
+    return -1;
+  return uringenter(n);
+}
+
+// Run the system call that sqe e describes, for uringenter(),
+// and return its result.
+int
+uringop(struct sqe *e)
+{
+  struct proc *p = myproc();
+  struct file *f;
+  struct pathbuf *pb;
+  int fd;
+
+  switch(e->op){
+  case UR_NOP:
+    return 0;
+  case UR_OPEN:
+    if((pb = (struct pathbuf*)kalloc()) == 0)
+      return -1;
+    fd = -1;
+    if(fetchstr(e->addr, pb->path, MAXPATH) >= 0)
+      fd = openpath(pb, e->len);
+    kfree((char*)pb);
+    return fd;
+  }
+
+  if(e->fd < 0 || e->fd >= NOFILE || (f = p->ofile[e->fd]) == 0)
+    return -1;
+  switch(e->op){
+  case UR_READ:
+    return fileread(f, e->addr, e->len);
+  case UR_WRITE:
+    return filewrite(f, e->addr, e->len);
+  case UR_PREAD:
+    return filepread(f, e->addr, e->len, e->off);
+  case UR_PWRITE:
+    return filepwrite(f, e->addr, e->len, e->off);
+  case UR_CLOSE:
+    p->ofile[e->fd] = 0;
+    fileclose(f);
+    return 0;
+  case UR_FSYNC:
+    return syncfile(f);
+  }
+  return -1;
+}
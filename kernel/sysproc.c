@@ -6,6 +6,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "iostat.h"
 
 uint64
 sys_exit(void)
@@ -95,3 +96,35 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// copy the disk I/O counters to the user's struct iostat.
+uint64
+sys_iostat(void)
+{
+  uint64 addr; // user pointer to struct iostat
+  struct iostat st;
+
+  if(argaddr(0, &addr) < 0)
+    return -1;
+  virtio_disk_stat(&st);
+  log_stat(&st);
+  if(copyout(myproc()->pagetable, addr, (char *)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
+// make this process wait for its disk requests by polling
+// (on != 0) rather than by sleeping until a completion
+// interrupt; see blk.c. returns the previous setting.
+uint64
+sys_iopoll(void)
+{
+  struct proc *p = myproc();
+  int on, old;
+
+  if(argint(0, &on) < 0)
+    return -1;
+  old = (p->iopoll != 0);
+  p->iopoll = (on != 0);
+  return old;
+}
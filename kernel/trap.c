@@ -164,7 +164,9 @@ clockintr()
 {
   acquire(&tickslock);
   ticks++;
+  vdsotick();
   wakeup(&ticks);
+  polltick();
   release(&tickslock);
 }
 
@@ -0,0 +1,8 @@
+// Buffers for readv() and writev().
+
+#define IOV_MAX 32  // max buffers in one readv() or writev()
+
+struct iovec {
+  void *iov_base;  // address
+  uint64 iov_len;  // length in bytes
+};
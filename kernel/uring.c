@@ -0,0 +1,87 @@
+//
+// Shared rings for batched system calls.
+//
+// uring_setup() maps a page holding a submission ring and a
+// completion ring into the process at URING. The process
+// fills in sqes and advances sq tail; one uring_enter() then
+// runs them all, in order, and posts a cqe for each, which
+// the process reaps by advancing cq head, with no further
+// system call. So a batch of small reads and writes costs
+// one trap instead of one each.
+//
+// The process can change the page at any time, so the kernel
+// copies each sqe before looking at it, and trusts the
+// indices only modulo URING_N.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "uring.h"
+
+// Give the current process its rings, if it has none yet,
+// and return their user address, or -1.
+uint64
+uringsetup(void)
+{
+  struct proc *p = myproc();
+  struct uring *r;
+
+  if(p->uring)
+    return URING;
+  if((r = (struct uring*)kalloc()) == 0)
+    return -1;
+  memset(r, 0, PGSIZE);
+  if(mappages(p->pagetable, URING, PGSIZE, (uint64)r, PTE_R | PTE_W | PTE_U) < 0){
+    kfree((char*)r);
+    return -1;
+  }
+  p->uring = r;
+  return URING;
+}
+
+// Free p's rings. The caller has unmapped them, with
+// proc_freepagetable().
+void
+uringfree(struct proc *p)
+{
+  kfree((char*)p->uring);
+  p->uring = 0;
+}
+
+// Run up to n of the submitted sqes, as long as there is
+// room for their completions. Returns the number run, or -1.
+int
+uringenter(int n)
+{
+  struct proc *p = myproc();
+  struct uring *r = p->uring;
+  struct sqe e;
+  struct cqe *c;
+  uint head, tail;
+  int i;
+
+  if(r == 0 || n < 0)
+    return -1;
+  head = r->sqhead;
+  tail = r->sqtail;
+  __sync_synchronize();  // read the sqes after the tail
+  if(tail - head > URING_N)
+    return -1;
+  for(i = 0; i < n && head != tail && !p->killed; i++){
+    if(r->cqtail - r->cqhead >= URING_N)
+      break;  // completion ring full
+    e = r->sq[head % URING_N];
+    r->sqhead = ++head;
+    c = &r->cq[r->cqtail % URING_N];
+    c->data = e.data;
+    c->res = uringop(&e);
+    __sync_synchronize();  // write the cqe before the tail
+    r->cqtail++;
+  }
+  return i;
+}
@@ -0,0 +1,41 @@
+// Submission and completion rings, shared by a process and
+// the kernel, for batching system calls; see uring.c.
+
+#define URING_N 64  // entries in each ring
+
+// submission opcodes
+#define UR_NOP    0
+#define UR_READ   1  // read(fd, addr, len)
+#define UR_WRITE  2  // write(fd, addr, len)
+#define UR_PREAD  3  // pread(fd, addr, len, off)
+#define UR_PWRITE 4  // pwrite(fd, addr, len, off)
+#define UR_OPEN   5  // open(addr, len)
+#define UR_CLOSE  6  // close(fd)
+#define UR_FSYNC  7  // fsync(fd)
+
+// submission queue entry
+struct sqe {
+  int op;       // UR_*
+  int fd;
+  uint64 addr;  // buffer, or path for UR_OPEN
+  int len;      // byte count, or mode for UR_OPEN
+  uint off;     // file offset for UR_PREAD and UR_PWRITE
+  uint64 data;  // for the caller; copied to the completion
+};
+
+// completion queue entry
+struct cqe {
+  uint64 data;  // from the sqe
+  int res;      // what the system call would have returned
+  int pad;
+};
+
+// The indices run freely, and wrap modulo URING_N.
+struct uring {
+  uint sqhead;  // next sqe for the kernel; the kernel advances it
+  uint sqtail;  // next free sqe; the process advances it
+  uint cqhead;  // next cqe for the process; the process advances it
+  uint cqtail;  // next free cqe; the kernel advances it
+  struct sqe sq[URING_N];
+  struct cqe cq[URING_N];
+};
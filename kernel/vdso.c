@@ -0,0 +1,62 @@
+//
+// The vDSO pages.
+//
+// uptime() and getpid() only read a counter, but a system call
+// costs a trap and, for uptime(), tickslock. Instead, every
+// process has two read-only pages mapped just below its
+// trapframe. VDSO is one page shared by all processes, which
+// clockintr() updates on every tick; VPROC is a page of the
+// process's own, with its pid, and the hart the scheduler
+// last ran it on. ulib's uptime() and getpid() read them.
+// User mode may also read the time CSR itself (see start.c),
+// and VDSO says how fast it runs, for a finer clock.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "vdso.h"
+
+struct vdso *vdso;
+
+void
+vdsoinit(void)
+{
+  if((vdso = (struct vdso*)kalloc()) == 0)
+    panic("vdsoinit");
+  memset(vdso, 0, PGSIZE);
+  vdso->timebase = TIMEBASE;
+  vdso->ticklen = TICKTIME;
+}
+
+// Called by clockintr(), with tickslock held.
+void
+vdsotick(void)
+{
+  vdso->ticks = ticks;
+}
+
+// Map the vDSO pages into pagetable, for process p.
+// Returns 0, or -1 if out of memory.
+int
+vdsomap(pagetable_t pagetable, struct proc *p)
+{
+  if(mappages(pagetable, VDSO, PGSIZE, (uint64)vdso, PTE_R | PTE_U) < 0)
+    return -1;
+  if(mappages(pagetable, VPROC, PGSIZE, (uint64)p->vproc, PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, VDSO, 1, 0);
+    return -1;
+  }
+  return 0;
+}
+
+void
+vdsounmap(pagetable_t pagetable)
+{
+  uvmunmap(pagetable, VDSO, 1, 0);
+  uvmunmap(pagetable, VPROC, 1, 0);
+}
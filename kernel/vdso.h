@@ -0,0 +1,16 @@
+// Pages that the kernel keeps up to date and maps read-only
+// into every process, so that reading the clock or its own
+// pid takes no system call; see vdso.c.
+
+// At VDSO: the same page in every process.
+struct vdso {
+  uint ticks;       // clock ticks since boot, as uptime() counts them
+  uint64 timebase;  // r_time() ticks per second
+  uint64 ticklen;   // r_time() ticks per clock tick
+};
+
+// At VPROC: each process's own page.
+struct vproc {
+  int pid;   // the process's pid
+  int hart;  // the hart it is running on, or last ran on
+};
@@ -27,6 +27,7 @@
 #define VIRTIO_MMIO_INTERRUPT_STATUS	0x060 // read-only
 #define VIRTIO_MMIO_INTERRUPT_ACK	0x064 // write-only
 #define VIRTIO_MMIO_STATUS		0x070 // read/write
+#define VIRTIO_MMIO_CONFIG		0x100 // device-specific configuration space
 
 // status register bits, from qemu virtio_config.h
 #define VIRTIO_CONFIG_S_ACKNOWLEDGE	1
@@ -45,7 +46,12 @@
 
 // this many virtio descriptors.
 // must be a power of two.
-#define NUM 8
+#define NUM 64
+
+// most data segments (blocks) in a single disk request.
+// a request uses one descriptor per segment, plus
+// one for the header and one for the status byte.
+#define MAXSEG 32
 
 // a single descriptor, from the spec.
 struct virtq_desc {
@@ -59,11 +65,12 @@ struct virtq_desc {
 
 // the (entire) avail ring, from the spec.
 struct virtq_avail {
-  uint16 flags; // always zero
+  uint16 flags; // VRING_AVAIL_F_NO_INTERRUPT, or zero
   uint16 idx;   // driver will write ring[idx] next
   uint16 ring[NUM]; // descriptor numbers of chain heads
-  uint16 unused;
+  uint16 used_event; // with EVENT_IDX: interrupt when used idx passes this
 };
+#define VRING_AVAIL_F_NO_INTERRUPT 1 // without EVENT_IDX: don't interrupt
 
 // one entry in the "used" ring, with which the
 // device tells the driver about completed requests.
@@ -76,6 +83,7 @@ struct virtq_used {
   uint16 flags; // always zero
   uint16 idx;   // device increments when it adds a ring[] entry
   struct virtq_used_elem ring[NUM];
+  uint16 avail_event; // with EVENT_IDX: notify when avail idx passes this
 };
 
 // these are specific to virtio block devices, e.g. disks,
@@ -84,9 +92,12 @@ struct virtq_used {
 #define VIRTIO_BLK_T_IN  0 // read the disk
 #define VIRTIO_BLK_T_OUT 1 // write the disk
 
+// offset of num_queues (uint16) in the device configuration.
+#define VIRTIO_BLK_CONFIG_NUM_QUEUES 0x22
+
 // the format of the first descriptor in a disk request.
-// to be followed by two more descriptors containing
-// the block, and a one-byte status.
+// to be followed by one descriptor per data segment
+// (block), and a one-byte status.
 struct virtio_blk_req {
   uint32 type; // VIRTIO_BLK_T_IN or ..._OUT
   uint32 reserved;
@@ -3,7 +3,11 @@
 // uses qemu's mmio interface to virtio.
 // qemu presents a "legacy" virtio interface.
 //
-// qemu ... -drive file=fs.img,if=none,format=raw,id=x0 -device virtio-blk-device,drive=x0,bus=virtio-mmio-bus.0
+// qemu ... -drive file=fs.img,if=none,format=raw,id=x0 -device virtio-blk-device,drive=x0,num-queues=3,bus=virtio-mmio-bus.0
+//
+// with VIRTIO_BLK_F_MQ the device has several request queues.
+// each hart submits requests on its own queue, with its own
+// lock, so harts doing disk I/O at the same time don't contend.
 //
 
 #include "types.h"
@@ -16,15 +20,17 @@
 #include "fs.h"
 #include "buf.h"
 #include "virtio.h"
+#include "iostat.h"
 
 // the address of virtio mmio register r.
 #define R(r) ((volatile uint32 *)(VIRTIO0 + (r)))
 
-static struct disk {
+// one virtqueue.
+struct vq {
   // the virtio driver and device mostly communicate through a set of
-  // structures in RAM. pages[] allocates that memory. pages[] is a
-  // global (instead of calls to kalloc()) because it must consist of
-  // two contiguous pages of page-aligned physical memory.
+  // structures in RAM. pages[] allocates that memory. pages[] is
+  // part of a global (instead of calls to kalloc()) because it must
+  // consist of two contiguous pages of page-aligned physical memory.
   char pages[2*PGSIZE];
 
   // pages[] is divided into three regions (descriptors, avail, and
@@ -54,32 +60,49 @@ static struct disk {
   struct virtq_used *used;
 
   // our own book-keeping.
+  int id;          // queue number, for QUEUE_NOTIFY.
   char free[NUM];  // is a descriptor free?
   uint16 used_idx; // we've looked this far in used[2..NUM].
+  uint16 kick_idx; // avail->idx when we last notified the device.
+  int inflight;    // requests started but not yet reaped.
+  int nsleep;      // processes sleeping until a request completes.
+  uint16 want;     // avail position of the earliest request a sleeper awaits.
 
   // track info about in-flight operations,
   // for use when completion interrupt arrives.
   // indexed by first descriptor index of chain.
   struct {
-    struct buf *b;
+    struct buf *b;   // first of n bufs, linked through b->qnext
+    int n;
+    uint64 start;    // r_time() when the request was started
     char status;
   } info[NUM];
 
   // disk command headers.
   // one-for-one with descriptors, for convenience.
   struct virtio_blk_req ops[NUM];
+
+  struct iostat stat; // this queue's share of the iostat() counters.
   
-  struct spinlock vdisk_lock;
+  struct spinlock lock;
   
-} __attribute__ ((aligned (PGSIZE))) disk;
+} __attribute__ ((aligned (PGSIZE)));
+
+static struct disk {
+  struct vq q[NCPU]; // one per hart, if the device has enough.
+  int nq;          // number of queues in use.
+  int event_idx;   // negotiated VIRTIO_RING_F_EVENT_IDX?
+} disk;
+
+static void disarm(struct vq *);
+static void kick(struct vq *);
+static void reap(struct vq *, int);
 
 void
 virtio_disk_init(void)
 {
   uint32 status = 0;
 
-  initlock(&disk.vdisk_lock, "virtio_disk");
-
   if(*R(VIRTIO_MMIO_MAGIC_VALUE) != 0x74726976 ||
      *R(VIRTIO_MMIO_VERSION) != 1 ||
      *R(VIRTIO_MMIO_DEVICE_ID) != 2 ||
@@ -98,55 +121,74 @@ virtio_disk_init(void)
   features &= ~(1 << VIRTIO_BLK_F_RO);
   features &= ~(1 << VIRTIO_BLK_F_SCSI);
   features &= ~(1 << VIRTIO_BLK_F_CONFIG_WCE);
-  features &= ~(1 << VIRTIO_BLK_F_MQ);
   features &= ~(1 << VIRTIO_F_ANY_LAYOUT);
-  features &= ~(1 << VIRTIO_RING_F_EVENT_IDX);
   features &= ~(1 << VIRTIO_RING_F_INDIRECT_DESC);
   *R(VIRTIO_MMIO_DRIVER_FEATURES) = features;
+  disk.event_idx = (features >> VIRTIO_RING_F_EVENT_IDX) & 1;
+
+  // how many request queues?
+  disk.nq = 1;
+  if(features & (1 << VIRTIO_BLK_F_MQ)){
+    disk.nq = *(volatile uint16 *)(VIRTIO0 + VIRTIO_MMIO_CONFIG + VIRTIO_BLK_CONFIG_NUM_QUEUES);
+    if(disk.nq > NCPU)
+      disk.nq = NCPU;
+    if(disk.nq < 1)
+      disk.nq = 1;
+  }
 
   // tell device that feature negotiation is complete.
   status |= VIRTIO_CONFIG_S_FEATURES_OK;
   *R(VIRTIO_MMIO_STATUS) = status;
 
+  *R(VIRTIO_MMIO_GUEST_PAGE_SIZE) = PGSIZE;
+
+  for(int i = 0; i < disk.nq; i++){
+    struct vq *q = &disk.q[i];
+
+    initlock(&q->lock, "virtio_disk");
+    q->id = i;
+
+    // initialize queue i.
+    *R(VIRTIO_MMIO_QUEUE_SEL) = i;
+    uint32 max = *R(VIRTIO_MMIO_QUEUE_NUM_MAX);
+    if(max == 0)
+      panic("virtio disk has no queue");
+    if(max < NUM)
+      panic("virtio disk max queue too short");
+    *R(VIRTIO_MMIO_QUEUE_NUM) = NUM;
+    memset(q->pages, 0, sizeof(q->pages));
+    *R(VIRTIO_MMIO_QUEUE_PFN) = ((uint64)q->pages) >> PGSHIFT;
+
+    // desc = pages -- num * virtq_desc
+    // avail = pages + 0x40 -- 2 * uint16, then num * uint16
+    // used = pages + 4096 -- 2 * uint16, then num * vRingUsedElem
+
+    q->desc = (struct virtq_desc *) q->pages;
+    q->avail = (struct virtq_avail *)(q->pages + NUM*sizeof(struct virtq_desc));
+    q->used = (struct virtq_used *) (q->pages + PGSIZE);
+
+    // all NUM descriptors start out unused.
+    for(int j = 0; j < NUM; j++)
+      q->free[j] = 1;
+
+    // no interrupts until someone waits for a request.
+    disarm(q);
+  }
+
   // tell device we're completely ready.
   status |= VIRTIO_CONFIG_S_DRIVER_OK;
   *R(VIRTIO_MMIO_STATUS) = status;
 
-  *R(VIRTIO_MMIO_GUEST_PAGE_SIZE) = PGSIZE;
-
-  // initialize queue 0.
-  *R(VIRTIO_MMIO_QUEUE_SEL) = 0;
-  uint32 max = *R(VIRTIO_MMIO_QUEUE_NUM_MAX);
-  if(max == 0)
-    panic("virtio disk has no queue 0");
-  if(max < NUM)
-    panic("virtio disk max queue too short");
-  *R(VIRTIO_MMIO_QUEUE_NUM) = NUM;
-  memset(disk.pages, 0, sizeof(disk.pages));
-  *R(VIRTIO_MMIO_QUEUE_PFN) = ((uint64)disk.pages) >> PGSHIFT;
-
-  // desc = pages -- num * virtq_desc
-  // avail = pages + 0x40 -- 2 * uint16, then num * uint16
-  // used = pages + 4096 -- 2 * uint16, then num * vRingUsedElem
-
-  disk.desc = (struct virtq_desc *) disk.pages;
-  disk.avail = (struct virtq_avail *)(disk.pages + NUM*sizeof(struct virtq_desc));
-  disk.used = (struct virtq_used *) (disk.pages + PGSIZE);
-
-  // all NUM descriptors start out unused.
-  for(int i = 0; i < NUM; i++)
-    disk.free[i] = 1;
-
   // plic.c and trap.c arrange for interrupts from VIRTIO0_IRQ.
 }
 
 // find a free descriptor, mark it non-free, return its index.
 static int
-alloc_desc()
+alloc_desc(struct vq *q)
 {
   for(int i = 0; i < NUM; i++){
-    if(disk.free[i]){
-      disk.free[i] = 0;
+    if(q->free[i]){
+      q->free[i] = 0;
       return i;
     }
   }
@@ -155,28 +197,28 @@ alloc_desc()
 
 // mark a descriptor as free.
 static void
-free_desc(int i)
+free_desc(struct vq *q, int i)
 {
   if(i >= NUM)
     panic("free_desc 1");
-  if(disk.free[i])
+  if(q->free[i])
     panic("free_desc 2");
-  disk.desc[i].addr = 0;
-  disk.desc[i].len = 0;
-  disk.desc[i].flags = 0;
-  disk.desc[i].next = 0;
-  disk.free[i] = 1;
-  wakeup(&disk.free[0]);
+  q->desc[i].addr = 0;
+  q->desc[i].len = 0;
+  q->desc[i].flags = 0;
+  q->desc[i].next = 0;
+  q->free[i] = 1;
+  wakeup(&q->free[0]);
 }
 
 // free a chain of descriptors.
 static void
-free_chain(int i)
+free_chain(struct vq *q, int i)
 {
   while(1){
-    int flag = disk.desc[i].flags;
-    int nxt = disk.desc[i].next;
-    free_desc(i);
+    int flag = q->desc[i].flags;
+    int nxt = q->desc[i].next;
+    free_desc(q, i);
     if(flag & VRING_DESC_F_NEXT)
       i = nxt;
     else
@@ -184,46 +226,146 @@ free_chain(int i)
   }
 }
 
-// allocate three descriptors (they need not be contiguous).
-// disk transfers always use three descriptors.
+// allocate n descriptors (they need not be contiguous).
 static int
-alloc3_desc(int *idx)
+alloc_descs(struct vq *q, int *idx, int n)
 {
-  for(int i = 0; i < 3; i++){
-    idx[i] = alloc_desc();
+  for(int i = 0; i < n; i++){
+    idx[i] = alloc_desc(q);
     if(idx[i] < 0){
       for(int j = 0; j < i; j++)
-        free_desc(idx[j]);
+        free_desc(q, idx[j]);
       return -1;
     }
   }
   return 0;
 }
 
+// the test from Section 2.6.7 of the spec: has the ring
+// index moved from old to new past the event index?
+static int
+vring_need_event(uint16 event, uint16 new, uint16 old)
+{
+  return (uint16)(new - event - 1) < (uint16)(new - old);
+}
+
+// how far past the requests reaped so far is avail ring
+// position x?
+static uint16
+ahead(struct vq *q, uint16 x)
+{
+  return x - q->used_idx;
+}
+
+// ask the device to interrupt when the request at avail ring
+// position want has completed, or an earlier one that another
+// sleeper awaits, but not for every request in flight: other
+// processes' batched writes shouldn't delay a sleeper waiting
+// for its own. the device usually completes requests in order,
+// so used->idx passing want means that one is done; if not, the
+// interrupt re-arms for the next completion. with EVENT_IDX the
+// device interrupts when the used ring index passes
+// avail->used_event.
+// caller holds q->lock.
+static void
+arm(struct vq *q, uint16 want)
+{
+  if(ahead(q, want) >= NUM)
+    want = q->used_idx;  // already done: the next completion
+  if(q->nsleep > 0 && ahead(q, q->want) < ahead(q, want))
+    want = q->want;
+  q->want = want;
+  if(disk.event_idx)
+    q->avail->used_event = want;
+  else
+    q->avail->flags = 0;
+  __sync_synchronize();
+}
+
+// ask the device not to interrupt at all: nobody is asleep
+// waiting for a request, so anyone waiting is polling.
+static void
+disarm(struct vq *q)
+{
+  if(disk.event_idx)
+    q->avail->used_event = q->used_idx - 1;
+  else
+    q->avail->flags = VRING_AVAIL_F_NO_INTERRUPT;
+  __sync_synchronize();
+}
+
+// sleep on chan until woken by reap(), making sure that the
+// device will interrupt once the request at avail position
+// want has completed.
+// caller holds q->lock.
+static void
+sleep_intr(struct vq *q, void *chan, uint16 want)
+{
+  arm(q, want);
+  if(q->used_idx != q->used->idx){
+    // the device may have finished before arm(),
+    // without interrupting.
+    reap(q, 0);
+    return;
+  }
+  q->nsleep++;
+  sleep(chan, &q->lock);
+  q->nsleep--;
+}
+
+// the calling hart's queue.
+static struct vq *
+myqueue(void)
+{
+  int id;
+
+  push_off();
+  id = cpuid();
+  pop_off();
+  return &disk.q[id % disk.nq];
+}
+
+// start a disk request that transfers the n bufs
+// b, b->qnext, b->qnext->qnext, ..., which must hold
+// consecutive blocks, on the calling hart's queue.
+// the device doesn't see the request until
+// virtio_disk_kick(). virtio_disk_intr() or a polling
+// virtio_disk_wait() clears each buf's b->disk when the
+// request has finished. waits for free descriptors by
+// sleeping, since requests in flight will free some soon.
 void
-virtio_disk_rw(struct buf *b, int write)
+virtio_disk_start(struct buf *b, int n, int write)
 {
   uint64 sector = b->blockno * (BSIZE / 512);
+  int idx[MAXSEG+2];
+  struct buf *bp;
+  struct vq *q;
+  int i;
+
+  if(n < 1 || n > MAXSEG)
+    panic("virtio_disk_start");
 
-  acquire(&disk.vdisk_lock);
+  q = myqueue();
+  acquire(&q->lock);
 
   // the spec's Section 5.2 says that legacy block operations use
-  // three descriptors: one for type/reserved/sector, one for the
-  // data, one for a 1-byte status result.
+  // a descriptor for type/reserved/sector, one descriptor for
+  // each data buffer, and one for a 1-byte status result.
 
-  // allocate the three descriptors.
-  int idx[3];
+  // allocate the n+2 descriptors.
   while(1){
-    if(alloc3_desc(idx) == 0) {
+    if(alloc_descs(q, idx, n+2) == 0) {
       break;
     }
-    sleep(&disk.free[0], &disk.vdisk_lock);
+    // make sure requests not yet kicked can finish.
+    kick(q);
+    sleep_intr(q, &q->free[0], q->used_idx);
   }
 
-  // format the three descriptors.
+  // format the descriptors.
   // qemu's virtio-blk.c reads them.
 
-  struct virtio_blk_req *buf0 = &disk.ops[idx[0]];
+  struct virtio_blk_req *buf0 = &q->ops[idx[0]];
 
   if(write)
     buf0->type = VIRTIO_BLK_T_OUT; // write the disk
@@ -232,57 +374,205 @@ virtio_disk_rw(struct buf *b, int write)
   buf0->reserved = 0;
   buf0->sector = sector;
 
-  disk.desc[idx[0]].addr = (uint64) buf0;
-  disk.desc[idx[0]].len = sizeof(struct virtio_blk_req);
-  disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
-  disk.desc[idx[0]].next = idx[1];
+  q->desc[idx[0]].addr = (uint64) buf0;
+  q->desc[idx[0]].len = sizeof(struct virtio_blk_req);
+  q->desc[idx[0]].flags = VRING_DESC_F_NEXT;
+  q->desc[idx[0]].next = idx[1];
+
+  bp = b;
+  for(i = 1; i <= n; i++){
+    q->desc[idx[i]].addr = (uint64) bp->data;
+    q->desc[idx[i]].len = BSIZE;
+    if(write)
+      q->desc[idx[i]].flags = 0; // device reads bp->data
+    else
+      q->desc[idx[i]].flags = VRING_DESC_F_WRITE; // device writes bp->data
+    q->desc[idx[i]].flags |= VRING_DESC_F_NEXT;
+    q->desc[idx[i]].next = idx[i+1];
+    bp->disk = 1;
+    bp->vq = q->id;
+    bp->vqidx = q->avail->idx;
+    bp = bp->qnext;
+  }
 
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
-  if(write)
-    disk.desc[idx[1]].flags = 0; // device reads b->data
-  else
-    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
-  disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-  disk.desc[idx[1]].next = idx[2];
+  q->info[idx[0]].status = 0xff; // device writes 0 on success
+  q->desc[idx[n+1]].addr = (uint64) &q->info[idx[0]].status;
+  q->desc[idx[n+1]].len = 1;
+  q->desc[idx[n+1]].flags = VRING_DESC_F_WRITE; // device writes the status
+  q->desc[idx[n+1]].next = 0;
 
-  disk.info[idx[0]].status = 0xff; // device writes 0 on success
-  disk.desc[idx[2]].addr = (uint64) &disk.info[idx[0]].status;
-  disk.desc[idx[2]].len = 1;
-  disk.desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
-  disk.desc[idx[2]].next = 0;
+  // record the bufs for reap().
+  q->info[idx[0]].b = b;
+  q->info[idx[0]].n = n;
+  q->info[idx[0]].start = r_time();
+  q->inflight++;
 
-  // record struct buf for virtio_disk_intr().
-  b->disk = 1;
-  disk.info[idx[0]].b = b;
+  q->stat.nreq++;
+  if(write)
+    q->stat.nwrite += n;
+  else
+    q->stat.nread += n;
 
   // tell the device the first index in our chain of descriptors.
-  disk.avail->ring[disk.avail->idx % NUM] = idx[0];
+  q->avail->ring[q->avail->idx % NUM] = idx[0];
 
   __sync_synchronize();
 
-  // tell the device another avail ring entry is available.
-  disk.avail->idx += 1; // not % NUM ...
+  // another avail ring entry is available.
+  q->avail->idx += 1; // not % NUM ...
 
+  release(&q->lock);
+}
+
+// notify the device of requests added to the avail ring
+// since the last notification. with EVENT_IDX, the device
+// tells us (in used->avail_event) how far it has read the
+// avail ring; if it hasn't caught up to the last notify yet,
+// it will see the new requests without another one.
+// caller holds q->lock.
+static void
+kick(struct vq *q)
+{
+  uint16 old = q->kick_idx;
+  uint16 new = q->avail->idx;
+
+  if(old == new)
+    return;
   __sync_synchronize();
+  if(!disk.event_idx || vring_need_event(q->used->avail_event, new, old)){
+    *R(VIRTIO_MMIO_QUEUE_NOTIFY) = q->id; // value is queue number
+    q->stat.nnotify++;
+  }
+  q->kick_idx = new;
+}
 
-  *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
+// tell the device about requests started since the last kick.
+// callers start a batch of requests, then kick once.
+// the caller may have moved to another hart since starting
+// them, so look at every queue.
+void
+virtio_disk_kick(void)
+{
+  for(int i = 0; i < disk.nq; i++){
+    struct vq *q = &disk.q[i];
+    if(q->kick_idx == q->avail->idx)
+      continue; // nothing new; a racy but harmless peek.
+    acquire(&q->lock);
+    kick(q);
+    release(&q->lock);
+  }
+}
 
-  // Wait for virtio_disk_intr() to say request has finished.
+// wait for the disk to finish with buf b, started by
+// virtio_disk_start(): by spinning on the used ring if poll
+// is set, else by sleeping until a completion interrupt.
+// polling saves a latency-sensitive waiter, such as a log
+// commit, the interrupt and the wakeup.
+void
+virtio_disk_wait(struct buf *b, int poll)
+{
+  struct vq *q = &disk.q[b->vq];
+
+  acquire(&q->lock);
   while(b->disk == 1) {
-    sleep(b, &disk.vdisk_lock);
+    if(poll){
+      // let other harts in between looks.
+      release(&q->lock);
+      acquire(&q->lock);
+      reap(q, 1);
+    } else {
+      sleep_intr(q, b, b->vqidx);
+    }
+  }
+  release(&q->lock);
+}
+
+void
+virtio_disk_rw(struct buf *b, int write, int poll)
+{
+  virtio_disk_start(b, 1, write);
+  virtio_disk_kick();
+  virtio_disk_wait(b, poll);
+}
+
+// add up the queues' I/O counters into *st.
+void
+virtio_disk_stat(struct iostat *st)
+{
+  memset(st, 0, sizeof(*st));
+  for(int i = 0; i < disk.nq; i++){
+    struct vq *q = &disk.q[i];
+    acquire(&q->lock);
+    st->nreq += q->stat.nreq;
+    st->nread += q->stat.nread;
+    st->nwrite += q->stat.nwrite;
+    st->nnotify += q->stat.nnotify;
+    st->nintr += q->stat.nintr;
+    st->npolled += q->stat.npolled;
+    for(int j = 0; j < NLAT; j++)
+      st->lat[j] += q->stat.lat[j];
+    release(&q->lock);
   }
+  st->nbytes = st->nwrite * BSIZE;
+  st->nqueue = disk.nq;
+}
 
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
+// record how long a request took, in the
+// power-of-two microsecond latency histogram.
+static void
+account(struct vq *q, uint64 start)
+{
+  uint64 us = (r_time() - start) / (TIMEBASE / 1000000);
+  int i;
 
-  release(&disk.vdisk_lock);
+  for(i = 0; i < NLAT-1 && us >= (1L << i); i++)
+    ;
+  q->stat.lat[i]++;
 }
 
+// process the requests the device has finished,
+// waking up anyone waiting for them. polled says
+// whether a polling virtio_disk_wait() found them.
+// caller holds q->lock.
+static void
+reap(struct vq *q, int polled)
+{
+  // the device increments q->used->idx when it
+  // adds an entry to the used ring.
+
+  while(q->used_idx != q->used->idx){
+    __sync_synchronize();
+    int id = q->used->ring[q->used_idx % NUM].id;
+
+    if(q->info[id].status != 0)
+      panic("virtio_disk_intr status");
+
+    struct buf *b = q->info[id].b;
+    for(int i = 0; i < q->info[id].n; i++){
+      struct buf *nb = b->qnext;
+      b->disk = 0;   // disk is done with buf
+      wakeup(b);
+      b = nb;
+    }
+
+    account(q, q->info[id].start);
+    if(polled)
+      q->stat.npolled++;
+    q->info[id].b = 0;
+    free_chain(q, id);
+    q->inflight--;
+
+    q->used_idx += 1;
+  }
+}
+
+// the device has one interrupt for all its queues.
+// start with this hart's own queue, whose requests
+// were most likely submitted here.
 void
 virtio_disk_intr()
 {
-  acquire(&disk.vdisk_lock);
+  struct vq *me = myqueue();
 
   // the device won't raise another interrupt until we tell it
   // we've seen this interrupt, which the following line does.
@@ -294,22 +584,27 @@ virtio_disk_intr()
 
   __sync_synchronize();
 
-  // the device increments disk.used->idx when it
-  // adds an entry to the used ring.
-
-  while(disk.used_idx != disk.used->idx){
-    __sync_synchronize();
-    int id = disk.used->ring[disk.used_idx % NUM].id;
-
-    if(disk.info[id].status != 0)
-      panic("virtio_disk_intr status");
-
-    struct buf *b = disk.info[id].b;
-    b->disk = 0;   // disk is done with buf
-    wakeup(b);
-
-    disk.used_idx += 1;
+  for(int i = 0; i < disk.nq; i++){
+    struct vq *q = &disk.q[(me->id + i) % disk.nq];
+
+    acquire(&q->lock);
+    if(q == me)
+      q->stat.nintr++;
+    while(1){
+      reap(q, 0);
+      if(q->nsleep == 0){
+        disarm(q);
+        break;
+      }
+      // more sleepers: interrupt again for the earliest request
+      // one awaits, if that hasn't completed yet, else for the
+      // next completion. re-check the used ring in case the
+      // device finished something before seeing the new event
+      // index.
+      arm(q, q->want);
+      if(q->used_idx == q->used->idx)
+        break;
+    }
+    release(&q->lock);
   }
-
-  release(&disk.vdisk_lock);
 }
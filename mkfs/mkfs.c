@@ -15,14 +15,18 @@
 #define static_assert(a, b) do { switch (0) case 0: case (a): ; } while (0)
 #endif
 
-#define NINODES 200
 
 // Disk layout:
 // [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
 
 int nbitmap = FSSIZE/(BSIZE*8) + 1;
-int ninodeblocks = NINODES / IPB + 1;
-int nlog = LOGSIZE;
+int ninodes = 200;     // -n overrides
+int ninodeblocks;
+int nlog = LOGSIZE/2;  // -l overrides
+int extents = 1;       // map file blocks with extents; -i for indirect blocks
+int journal = 0;       // -j: log file data too, not just metadata
+int inodesize = sizeof(struct dinode);  // -s overrides
+int inlinedata = 1;    // small files' data in the inode; -I for blocks
 int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap)
 int nblocks;  // Number of data blocks
 
@@ -40,6 +44,14 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+void winline(uint inum, void *p, int n);
+uint ibmap(struct dinode *din, uint fbn);
+uint ebmap(struct dinode *din, uint fbn);
+struct ent {
+  uint inum;
+  char *name;
+};
+void wdir(uint inum, struct ent *de, int n);
 void die(const char *);
 
 // convert to intel byte order
@@ -69,21 +81,65 @@ int
 main(int argc, char *argv[])
 {
   int i, cc, fd;
-  uint rootino, inum, off;
-  struct dirent de;
+  uint rootino, inum;
+  struct ent *de;
+  int nde;
   char buf[BSIZE];
-  struct dinode din;
 
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
+  for(;;){
+    if(argc > 3 && strcmp(argv[1], "-l") == 0){
+      nlog = atoi(argv[2]);
+      argc -= 2;
+      argv += 2;
+    } else if(argc > 3 && strcmp(argv[1], "-s") == 0){
+      inodesize = atoi(argv[2]);
+      argc -= 2;
+      argv += 2;
+    } else if(argc > 2 && strcmp(argv[1], "-I") == 0){
+      inlinedata = 0;
+      argc--;
+      argv++;
+    } else if(argc > 3 && strcmp(argv[1], "-n") == 0){
+      ninodes = atoi(argv[2]);
+      argc -= 2;
+      argv += 2;
+    } else if(argc > 2 && strcmp(argv[1], "-i") == 0){
+      extents = 0;
+      argc--;
+      argv++;
+    } else if(argc > 2 && strcmp(argv[1], "-j") == 0){
+      journal = 1;
+      argc--;
+      argv++;
+    } else
+      break;
+  }
+
   if(argc < 2){
-    fprintf(stderr, "Usage: mkfs fs.img files...\n");
+    fprintf(stderr, "Usage: mkfs [-l logblocks] [-n inodes] [-s inodesize] [-i] [-I] [-j] fs.img files...\n");
+    exit(1);
+  }
+  if(nlog < MAXOPBLOCKS+2 || nlog > LOGSIZE){
+    fprintf(stderr, "mkfs: log must have %d to %d blocks\n", MAXOPBLOCKS+2, LOGSIZE);
     exit(1);
   }
 
+  if(ninodes < ROOTINO+1 || ninodes > FSSIZE){
+    fprintf(stderr, "mkfs: must have %d to %d inodes\n", ROOTINO+1, FSSIZE);
+    exit(1);
+  }
+  if(inodesize < sizeof(struct dinode) || inodesize % sizeof(struct dinode) != 0 ||
+     BSIZE % inodesize != 0){
+    fprintf(stderr, "mkfs: inode size must be a multiple of %d that divides %d\n",
+            (int)sizeof(struct dinode), BSIZE);
+    exit(1);
+  }
+  ninodeblocks = ninodes / (BSIZE / inodesize) + 1;
+
   assert((BSIZE % sizeof(struct dinode)) == 0);
-  assert((BSIZE % sizeof(struct dirent)) == 0);
 
   fsfd = open(argv[1], O_RDWR|O_CREAT|O_TRUNC, 0666);
   if(fsfd < 0)
@@ -96,11 +152,14 @@ main(int argc, char *argv[])
   sb.magic = FSMAGIC;
   sb.size = xint(FSSIZE);
   sb.nblocks = xint(nblocks);
-  sb.ninodes = xint(NINODES);
+  sb.ninodes = xint(ninodes);
   sb.nlog = xint(nlog);
   sb.logstart = xint(2);
   sb.inodestart = xint(2+nlog);
   sb.bmapstart = xint(2+nlog+ninodeblocks);
+  sb.features = xint((extents ? FS_EXTENTS : 0) | (journal ? FS_JOURNAL : 0) |
+                     (inlinedata ? FS_INLINE : 0));
+  sb.inodesize = xint(inodesize);
 
   printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d\n",
          nmeta, nlog, ninodeblocks, nbitmap, nblocks, FSSIZE);
@@ -117,15 +176,14 @@ main(int argc, char *argv[])
   rootino = ialloc(T_DIR);
   assert(rootino == ROOTINO);
 
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, ".");
-  iappend(rootino, &de, sizeof(de));
-
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, "..");
-  iappend(rootino, &de, sizeof(de));
+  de = calloc(argc, sizeof(*de));
+  if(de == 0)
+    die("calloc");
+  de[0].inum = rootino;
+  de[0].name = ".";
+  de[1].inum = rootino;
+  de[1].name = "..";
+  nde = 2;
 
   for(i = 2; i < argc; i++){
     // get rid of "user/"
@@ -149,23 +207,27 @@ main(int argc, char *argv[])
 
     inum = ialloc(T_FILE);
 
-    bzero(&de, sizeof(de));
-    de.inum = xshort(inum);
-    strncpy(de.name, shortname, DIRSIZ);
-    iappend(rootino, &de, sizeof(de));
+    if(strlen(shortname) > DIRSIZ)
+      die("mkfs: name too long");
+    de[nde].inum = inum;
+    de[nde].name = shortname;
+    nde++;
 
-    while((cc = read(fd, buf, sizeof(buf))) > 0)
-      iappend(inum, buf, cc);
+    if(inlinedata && lseek(fd, 0, SEEK_END) <= INLINESZ(sb)){
+      lseek(fd, 0, SEEK_SET);
+      cc = read(fd, buf, sizeof(buf));
+      winline(inum, buf, cc);
+    } else {
+      lseek(fd, 0, SEEK_SET);
+      while((cc = read(fd, buf, sizeof(buf))) > 0)
+        iappend(inum, buf, cc);
+    }
 
     close(fd);
   }
 
-  // fix size of root inode dir
-  rinode(rootino, &din);
-  off = xint(din.size);
-  off = ((off/BSIZE) + 1) * BSIZE;
-  din.size = xint(off);
-  winode(rootino, &din);
+  wdir(rootino, de, nde);
+  free(de);
 
   balloc(freeblock);
 
@@ -190,7 +252,7 @@ winode(uint inum, struct dinode *ip)
 
   bn = IBLOCK(inum, sb);
   rsect(bn, buf);
-  dip = ((struct dinode*)buf) + (inum % IPB);
+  dip = (struct dinode*)(buf + inum % IPB(sb) * inodesize);
   *dip = *ip;
   wsect(bn, buf);
 }
@@ -204,7 +266,7 @@ rinode(uint inum, struct dinode *ip)
 
   bn = IBLOCK(inum, sb);
   rsect(bn, buf);
-  dip = ((struct dinode*)buf) + (inum % IPB);
+  dip = (struct dinode*)(buf + inum % IPB(sb) * inodesize);
   *ip = *dip;
 }
 
@@ -227,6 +289,12 @@ ialloc(ushort type)
   din.type = xshort(type);
   din.nlink = xshort(1);
   din.size = xint(0);
+  if(extents){
+    struct extent_header *h = (struct extent_header*)din.addrs;
+    din.flags = xint(I_EXTENTS);
+    h->magic = xshort(EXT_MAGIC);
+    h->max = xshort(EXT_ROOT);
+  }
   winode(inum, &din);
   return inum;
 }
@@ -249,6 +317,76 @@ balloc(int used)
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+// Return the disk block for file block fbn of an extent-mapped
+// inode, allocating it if need be. mkfs only appends, and a
+// file's blocks are contiguous unless another file's blocks were
+// appended in between, so the extents in the inode suffice.
+uint
+ebmap(struct dinode *din, uint fbn)
+{
+  struct extent_header *h = (struct extent_header*)din->addrs;
+  struct extent *e = (struct extent*)(h + 1);
+  int i, n = xshort(h->n);
+  uint lblk, len, pblk;
+
+  for(i = 0; i < n; i++){
+    lblk = xint(e[i].lblk);
+    if(fbn >= lblk && fbn < lblk + xint(e[i].len))
+      return xint(e[i].pblk) + fbn - lblk;
+  }
+  if(n > 0){
+    lblk = xint(e[n-1].lblk);
+    len = xint(e[n-1].len);
+    pblk = xint(e[n-1].pblk);
+    if(fbn == lblk + len && freeblock == pblk + len){
+      e[n-1].len = xint(len + 1);
+      return freeblock++;
+    }
+  }
+  if(n == EXT_ROOT){
+    fprintf(stderr, "mkfs: too many extents\n");
+    exit(1);
+  }
+  e[n].lblk = xint(fbn);
+  e[n].len = xint(1);
+  e[n].pblk = xint(freeblock);
+  h->n = xshort(n + 1);
+  return freeblock++;
+}
+
+// Return the disk block for file block fbn (>= NDIRECT) of a
+// block-mapped inode, allocating it and the single-, double-
+// or triple-indirect blocks on the way to it if need be.
+uint
+ibmap(struct dinode *din, uint fbn)
+{
+  uint indirect[NINDIRECT];
+  uint bn, n, div, addr, i;
+  int level, l;
+
+  bn = fbn - NDIRECT;
+  for(level = 0, n = NINDIRECT; bn >= n; level++){
+    assert(level < 2);
+    bn -= n;
+    n *= NINDIRECT;
+  }
+  if(xint(din->addrs[NDIRECT+level]) == 0)
+    din->addrs[NDIRECT+level] = xint(freeblock++);
+  addr = xint(din->addrs[NDIRECT+level]);
+  for(l = level; l >= 0; l--){
+    for(div = 1, n = 0; n < l; n++)
+      div *= NINDIRECT;
+    i = bn / div % NINDIRECT;
+    rsect(addr, (char*)indirect);
+    if(indirect[i] == 0){
+      indirect[i] = xint(freeblock++);
+      wsect(addr, (char*)indirect);
+    }
+    addr = xint(indirect[i]);
+  }
+  return addr;
+}
+
 void
 iappend(uint inum, void *xp, int n)
 {
@@ -256,7 +394,6 @@ iappend(uint inum, void *xp, int n)
   uint fbn, off, n1;
   struct dinode din;
   char buf[BSIZE];
-  uint indirect[NINDIRECT];
   uint x;
 
   rinode(inum, &din);
@@ -264,22 +401,15 @@ iappend(uint inum, void *xp, int n)
   // printf("append inum %d at off %d sz %d\n", inum, off, n);
   while(n > 0){
     fbn = off / BSIZE;
-    assert(fbn < MAXFILE);
-    if(fbn < NDIRECT){
+    if(xint(din.flags) & I_EXTENTS){
+      x = ebmap(&din, fbn);
+    } else if(fbn < NDIRECT){
       if(xint(din.addrs[fbn]) == 0){
         din.addrs[fbn] = xint(freeblock++);
       }
       x = xint(din.addrs[fbn]);
     } else {
-      if(xint(din.addrs[NDIRECT]) == 0){
-        din.addrs[NDIRECT] = xint(freeblock++);
-      }
-      rsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      if(indirect[fbn - NDIRECT] == 0){
-        indirect[fbn - NDIRECT] = xint(freeblock++);
-        wsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      }
-      x = xint(indirect[fbn-NDIRECT]);
+      x = ibmap(&din, fbn);
     }
     n1 = min(n, (fbn + 1) * BSIZE - off);
     rsect(x, buf);
@@ -293,6 +423,137 @@ iappend(uint inum, void *xp, int n)
   winode(inum, &din);
 }
 
+// FNV-1a hash of a directory entry name, as in kernel/fs.c.
+uint
+dxhash(char *name)
+{
+  uint h = 2166136261U;
+
+  for(; *name; name++){
+    h ^= (uchar)*name;
+    h *= 16777619;
+  }
+  return h;
+}
+
+int
+dxcmp(const void *a, const void *b)
+{
+  uint ha = dxhash(((struct ent*)a)->name);
+  uint hb = dxhash(((struct ent*)b)->name);
+
+  return ha < hb ? -1 : ha > hb;
+}
+
+// Pack entries de[i..j-1] into directory block buf, the last
+// one taking the rest of the block.
+void
+dpack(char *buf, struct ent *de, int i, int j)
+{
+  struct dirent *d = (struct dirent*)buf;
+  int off, len;
+
+  memset(buf, 0, BSIZE);
+  for(off = 0; i < j; i++, off += len){
+    d = (struct dirent*)(buf + off);
+    len = DIRLEN(strlen(de[i].name));
+    d->inum = xshort(de[i].inum);
+    d->reclen = xshort(i == j-1 ? BSIZE - off : len);
+    d->namelen = strlen(de[i].name);
+    memmove(d->name, de[i].name, d->namelen);
+  }
+  if(off == 0)
+    d->reclen = xshort(BSIZE);
+}
+
+// Return the end of the leaf that starts with de[i]: about
+// 3/4 of a block, so that creating files doesn't have to split
+// leaves at once, and never between names with the same hash.
+int
+dleaf(struct ent *de, int i, int n)
+{
+  int j, len;
+
+  len = 0;
+  for(j = i; j < n; j++){
+    if(j > i && len >= BSIZE*3/4 && dxhash(de[j].name) != dxhash(de[j-1].name))
+      break;
+    len += DIRLEN(strlen(de[j].name));
+    if(len > BSIZE)
+      die("mkfs: too many names with one hash");
+  }
+  return j;
+}
+
+// Write the n entries de[] of directory inum, the first two
+// of which are "." and "..". If they don't fit in one block,
+// give the directory a hash index (see kernel/fs.h).
+void
+wdir(uint inum, struct ent *de, int n)
+{
+  char buf[BSIZE];
+  struct dxhead *h;
+  struct dxentry *e;
+  struct dinode din;
+  int i, len, nleaf;
+
+  len = 0;
+  for(i = 0; i < n; i++)
+    len += DIRLEN(strlen(de[i].name));
+  if(len <= BSIZE){
+    dpack(buf, de, 0, n);
+    iappend(inum, buf, BSIZE);
+    return;
+  }
+
+  qsort(de + 2, n - 2, sizeof(*de), dxcmp);
+  dpack(buf, de, 0, 2);
+  ((struct dirent*)(buf + DIRLEN(1)))->reclen = xshort(DIRLEN(2));
+  h = (struct dxhead*)(buf + DX_DOTS);
+  h->reclen = xshort(BSIZE - DX_DOTS);
+  h->max = xshort(DX_ROOT);
+  h->magic = xint(DX_MAGIC);
+  e = (struct dxentry*)(h + 1);
+  nleaf = 0;
+  for(i = 2; i < n; i = dleaf(de, i, n)){
+    if(nleaf == DX_ROOT)
+      die("mkfs: root directory too big");
+    e[nleaf].hash = xint(nleaf ? dxhash(de[i].name) : 0);
+    e[nleaf].block = xint(nleaf + 1);
+    nleaf++;
+  }
+  h->n = xshort(nleaf);
+  iappend(inum, buf, BSIZE);
+
+  for(i = 2; i < n; i = dleaf(de, i, n)){
+    dpack(buf, de, i, dleaf(de, i, n));
+    iappend(inum, buf, BSIZE);
+  }
+
+  rinode(inum, &din);
+  din.flags = xint(xint(din.flags) | I_INDEX);
+  winode(inum, &din);
+}
+
+// Make file inum, which is empty, hold its n bytes of data
+// p in the inode.
+void
+winline(uint inum, void *p, int n)
+{
+  char buf[BSIZE];
+  uint bn;
+  struct dinode *dip;
+
+  bn = IBLOCK(inum, sb);
+  rsect(bn, buf);
+  dip = (struct dinode*)(buf + inum % IPB(sb) * inodesize);
+  dip->flags = xint(I_INLINE);
+  dip->size = xint(n);
+  memset(dip->addrs, 0, INLINESZ(sb));
+  memmove(dip->addrs, p, n);
+  wsect(bn, buf);
+}
+
 void
 die(const char *s)
 {
@@ -0,0 +1,124 @@
+// Block allocator benchmark.
+//
+//   allocbench [nproc [kbytes]]
+//
+// Forks nproc (default 4) processes that each append kbytes
+// (default 256) to a file of their own in one-block write()s,
+// all at the same time, so that their allocations interleave.
+// Reports blocks allocated per second, and how fragmented the
+// files came out: the number of runs of contiguous disk blocks
+// (extents) holding each file, from fstat(). Then deletes every
+// other file, writes one file into the holes left behind, and
+// reports how fragmented that one is.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+
+char buf[BSIZE];
+
+void
+fill(char *path, int kb)
+{
+  int fd;
+
+  fd = open(path, O_CREATE | O_RDWR);
+  if(fd < 0){
+    fprintf(2, "allocbench: cannot create %s\n", path);
+    exit(1);
+  }
+  for(int i = 0; i < kb*1024/BSIZE; i++){
+    if(write(fd, buf, BSIZE) != BSIZE){
+      fprintf(2, "allocbench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+// runs of contiguous disk blocks holding path.
+int
+extents(char *path)
+{
+  struct stat st;
+
+  if(stat(path, &st) < 0){
+    fprintf(2, "allocbench: cannot stat %s\n", path);
+    exit(1);
+  }
+  return st.nextent;
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[] = "ab0";
+  int nproc, kb, holekb, t0, t, n, max;
+
+  nproc = 4;
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(nproc < 1 || nproc > 10)
+    nproc = 4;
+  kb = 256;
+  if(argc > 2)
+    kb = atoi(argv[2]);
+  if(kb < 1)
+    kb = 1;
+
+  t0 = uptime();
+  for(int i = 0; i < nproc; i++){
+    path[2] = '0' + i;
+    unlink(path);
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "allocbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      fill(path, kb);
+      exit(0);
+    }
+  }
+  for(int i = 0; i < nproc; i++)
+    wait(0);
+  sync();
+  t = uptime() - t0;
+  if(t < 1)
+    t = 1;
+
+  n = max = 0;
+  for(int i = 0; i < nproc; i++){
+    path[2] = '0' + i;
+    int e = extents(path);
+    n += e;
+    if(e > max)
+      max = e;
+  }
+  printf("interleaved: %d blocks in %d ticks, %d blocks/s, %d extents/file (max %d)\n",
+         nproc*kb*1024/BSIZE, t, nproc*kb*1024/BSIZE*HZ/t, n/nproc, max);
+
+  for(int i = 1; i < nproc; i += 2){
+    path[2] = '0' + i;
+    unlink(path);
+  }
+  holekb = nproc/2*kb;
+  if(holekb < kb)
+    holekb = kb;
+  t0 = uptime();
+  fill("abx", holekb);
+  sync();
+  t = uptime() - t0;
+  printf("into holes: %d KB in %d ticks, %d extents\n", holekb, t, extents("abx"));
+
+  unlink("abx");
+  for(int i = 0; i < nproc; i += 2){
+    path[2] = '0' + i;
+    unlink(path);
+  }
+  exit(0);
+}
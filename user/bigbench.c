@@ -0,0 +1,107 @@
+// Large file benchmark.
+//
+//   bigbench [kbytes [iosize]]
+//
+// Streams a file of kbytes (default 2048) to disk sequentially,
+// in write()s of iosize bytes (default 65536) and an fsync(),
+// then reads it back the same way. Reports the throughput and
+// disk requests of each phase, and how many blocks of the file
+// system hold the file's block map (indirect or extent blocks),
+// from fstat().
+// Run it on file systems made with and without extents
+// (make BLOCKMAP=indirect) to compare the two layouts, and
+// with small iosizes to see the cost of mapping each block.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+#define HZ    10          // clock ticks per second; see kernel/start.c
+#define CHUNK (64*1024)
+
+char buf[CHUNK];
+
+void
+report(char *phase, int kb, int t, struct iostat *a, struct iostat *b)
+{
+  int reqs = b->nreq - a->nreq;
+  int blocks = (b->nread - a->nread) + (b->nwrite - a->nwrite);
+
+  if(t < 1)
+    t = 1;
+  printf("%s: %d KB in %d ticks, %d KB/s, %d requests, %d blocks, %d blocks/req\n",
+         phase, kb, t, kb*HZ/t, reqs, blocks, reqs ? blocks/reqs : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *path = "bigbench.tmp";
+  struct iostat s0, s1;
+  struct stat st;
+  int fd, kb, io, n, tot, t0;
+
+  kb = 2048;
+  if(argc > 1)
+    kb = atoi(argv[1]);
+  if(kb < 1)
+    kb = 1;
+  io = CHUNK;
+  if(argc > 2)
+    io = atoi(argv[2]);
+  if(io < 1 || io > CHUNK)
+    io = CHUNK;
+  for(int i = 0; i < CHUNK; i++)
+    buf[i] = 'a' + i % 26;
+
+  unlink(path);
+  fd = open(path, O_CREATE | O_RDWR);
+  if(fd < 0){
+    fprintf(2, "bigbench: cannot create %s\n", path);
+    exit(1);
+  }
+  iostat(&s0);
+  t0 = uptime();
+  for(tot = 0; tot < kb*1024; tot += n){
+    n = kb*1024 - tot;
+    if(n > io)
+      n = io;
+    if(write(fd, buf, n) != n){
+      fprintf(2, "bigbench: write failed\n");
+      exit(1);
+    }
+  }
+  fsync(fd);
+  iostat(&s1);
+  report("write", kb, uptime() - t0, &s0, &s1);
+  if(fstat(fd, &st) < 0){
+    fprintf(2, "bigbench: cannot stat %s\n", path);
+    exit(1);
+  }
+  close(fd);
+  printf("map: %d data blocks, %d block map blocks\n",
+         (int)(st.size / BSIZE), st.nmeta);
+
+  fd = open(path, O_RDONLY);
+  if(fd < 0){
+    fprintf(2, "bigbench: cannot open %s\n", path);
+    exit(1);
+  }
+  iostat(&s0);
+  t0 = uptime();
+  tot = 0;
+  while((n = read(fd, buf, io)) > 0)
+    tot += n;
+  close(fd);
+  iostat(&s1);
+  if(tot != kb*1024){
+    fprintf(2, "bigbench: short read %d\n", tot);
+    exit(1);
+  }
+  report("read", kb, uptime() - t0, &s0, &s1);
+  unlink(path);
+  exit(0);
+}
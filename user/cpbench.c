@@ -0,0 +1,110 @@
+// File copy benchmark.
+//
+//   cpbench [kb]
+//
+// Writes a file of kb (default 512) kilobytes, and copies it,
+// first with a read()/write() loop through a user buffer, and
+// then with copy_file_range(), which copies in the kernel, in
+// bigger transactions. Reports the bandwidth of each, the
+// disk blocks each wrote, and those written to the log; then
+// checks the copies.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+
+char buf[8192];
+
+void
+die(char *msg)
+{
+  fprintf(2, "cpbench: %s\n", msg);
+  exit(1);
+}
+
+void
+copy(char *what, char *to, int kb, int kernel)
+{
+  struct iostat s0, s1;
+  int in, out, n, t0, t;
+
+  iostat(&s0);
+  t0 = uptime();
+  if((in = open("cbf", O_RDONLY)) < 0)
+    die("cannot open cbf");
+  if((out = open(to, O_CREATE | O_TRUNC | O_WRONLY)) < 0)
+    die("cannot create copy");
+  if(kernel){
+    while((n = copy_file_range(in, out, 1<<30)) > 0)
+      ;
+  } else {
+    while((n = read(in, buf, sizeof(buf))) > 0)
+      if(write(out, buf, n) != n)
+        die("write failed");
+  }
+  if(n < 0)
+    die("copy failed");
+  close(in);
+  close(out);
+  sync();
+  if((t = uptime() - t0) < 1)
+    t = 1;
+  iostat(&s1);
+  printf("%s: %d KB in %d ticks, %d KB/s, %d blocks written, %d to the log\n",
+         what, kb, t, kb * HZ / t, (int)(s1.nwrite - s0.nwrite),
+         (int)(s1.nlog - s0.nlog));
+}
+
+// Check that file name holds what main() wrote to cbf.
+void
+check(char *name, int kb)
+{
+  int fd, n, off;
+
+  if((fd = open(name, O_RDONLY)) < 0)
+    die("cannot open copy");
+  for(off = 0; (n = read(fd, buf, sizeof(buf))) > 0; off += n)
+    for(int i = 0; i < n; i++)
+      if(buf[i] != (char)((off + i) / 1024 + (off + i)))
+        die("copy has wrong data");
+  if(off != kb * 1024)
+    die("copy has the wrong size");
+  close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int kb, fd, off;
+
+  kb = 512;
+  if(argc > 1)
+    kb = atoi(argv[1]);
+  if(kb < 1)
+    kb = 512;
+
+  if((fd = open("cbf", O_CREATE | O_TRUNC | O_WRONLY)) < 0)
+    die("cannot create cbf");
+  for(off = 0; off < kb * 1024; off += sizeof(buf)){
+    for(int i = 0; i < sizeof(buf); i++)
+      buf[i] = (off + i) / 1024 + (off + i);
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf))
+      die("write cbf failed");
+  }
+  close(fd);
+  kb = off / 1024;
+  sync();
+
+  copy("read/write", "cbf.1", kb, 0);
+  copy("copy_file_range", "cbf.2", kb, 1);
+  check("cbf.1", kb);
+  check("cbf.2", kb);
+
+  unlink("cbf");
+  unlink("cbf.1");
+  unlink("cbf.2");
+  exit(0);
+}
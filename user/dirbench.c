@@ -0,0 +1,137 @@
+// Big directory benchmark.
+//
+//   dirbench [n]
+//
+// Enters n (default 10000) names in one directory, dbd/, then
+// looks them all up with stat(), in order and then scattered,
+// looks up n names that aren't there, and unlinks them all.
+// Reports the time per operation and the disk blocks each
+// phase read. The names are hard links to one file, so that
+// the benchmark measures the directory rather than inode
+// allocation, and fits in a file system with the default
+// number of inodes. A directory of more than one block is
+// indexed by a hash of the names, so no phase should slow
+// down much as n grows; with linear directories each
+// operation scanned half the directory, on average.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+
+char path[] = "dbd/n00000";
+
+void
+name(int i)
+{
+  for(int j = 9; j >= 5; j--){
+    path[j] = '0' + i % 10;
+    i /= 10;
+  }
+}
+
+void
+report(char *what, int n, int t, struct iostat *a, struct iostat *b)
+{
+  if(t < 1)
+    t = 1;
+  printf("%s: %d in %d ticks, %d us each, %d blocks read\n",
+         what, n, t, t * (1000000 / HZ) / n, (int)(b->nread - a->nread));
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct iostat s0, s1;
+  struct stat st;
+  int n, fd, t0;
+
+  n = 10000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n < 1 || n > 30000) // nlink is a short
+    n = 10000;
+
+  if(mkdir("dbd") < 0){
+    fprintf(2, "dirbench: cannot create dbd\n");
+    exit(1);
+  }
+  if((fd = open("dbf", O_CREATE | O_RDWR)) < 0){
+    fprintf(2, "dirbench: cannot create dbf\n");
+    exit(1);
+  }
+  close(fd);
+
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < n; i++){
+    name(i);
+    if(link("dbf", path) < 0){
+      fprintf(2, "dirbench: cannot link %s\n", path);
+      exit(1);
+    }
+  }
+  sync();
+  iostat(&s1);
+  report("create", n, uptime() - t0, &s0, &s1);
+
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < n; i++){
+    name(i);
+    if(stat(path, &st) < 0){
+      fprintf(2, "dirbench: cannot stat %s\n", path);
+      exit(1);
+    }
+  }
+  iostat(&s1);
+  report("lookup", n, uptime() - t0, &s0, &s1);
+
+  // 7919 is prime, so this visits every name once,
+  // unless n is a multiple of it.
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < n; i++){
+    name((int)((uint)i * 7919 % n));
+    if(stat(path, &st) < 0){
+      fprintf(2, "dirbench: cannot stat %s\n", path);
+      exit(1);
+    }
+  }
+  iostat(&s1);
+  report("lookup scattered", n, uptime() - t0, &s0, &s1);
+
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < n; i++){
+    name(i);
+    path[4] = 'm';
+    if(stat(path, &st) >= 0){
+      fprintf(2, "dirbench: %s exists\n", path);
+      exit(1);
+    }
+  }
+  path[4] = 'n';
+  iostat(&s1);
+  report("lookup missing", n, uptime() - t0, &s0, &s1);
+
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < n; i++){
+    name(i);
+    if(unlink(path) < 0){
+      fprintf(2, "dirbench: cannot unlink %s\n", path);
+      exit(1);
+    }
+  }
+  sync();
+  iostat(&s1);
+  report("unlink", n, uptime() - t0, &s0, &s1);
+
+  unlink("dbf");
+  unlink("dbd");
+  exit(0);
+}
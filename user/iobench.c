@@ -0,0 +1,157 @@
+// Disk throughput benchmark.
+//
+//   iobench [kbytes]
+//
+// Writes a file of kbytes (default 256) sequentially, in
+// write()s of up to 64KB, then reads it back. For each
+// phase, reports throughput and the disk requests issued,
+// from the kernel's iostat() counters.
+//
+// Then does small synchronous writes, first with this process
+// waiting for completion interrupts and then with it polling
+// (see iopoll(); log commits poll either way), and reports
+// interrupts and device notifications per request and request
+// latency percentiles.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+#define HZ    10          // clock ticks per second; see kernel/start.c
+#define CHUNK (64*1024)
+#define NSYNC 200         // small writes per latency phase
+
+char buf[CHUNK];
+
+void
+report(char *phase, int kb, int t, struct iostat *a, struct iostat *b)
+{
+  int reqs = b->nreq - a->nreq;
+  int blocks = (b->nread - a->nread) + (b->nwrite - a->nwrite);
+
+  if(t < 1)
+    t = 1;
+  printf("%s: %d KB in %d ticks, %d KB/s, %d requests (%d req/s), %d blocks, %d blocks/req\n",
+         phase, kb, t, kb*HZ/t, reqs, reqs*HZ/t, blocks, reqs ? blocks/reqs : 0);
+}
+
+// smallest power of two (in microseconds) that at least
+// pct percent of the requests counted in b but not a took
+// less than.
+int
+percentile(struct iostat *a, struct iostat *b, int pct)
+{
+  int i;
+  uint64 n, tot;
+
+  tot = 0;
+  for(i = 0; i < NLAT; i++)
+    tot += b->lat[i] - a->lat[i];
+  n = 0;
+  for(i = 0; i < NLAT-1; i++){
+    n += b->lat[i] - a->lat[i];
+    if(n * 100 >= tot * pct)
+      break;
+  }
+  return 1 << i;
+}
+
+// NSYNC one-block writes, each its own transaction.
+void
+latency(char *mode, char *path, int poll)
+{
+  struct iostat a, b;
+  int fd, reqs, t0, t;
+
+  fd = open(path, O_CREATE | O_RDWR);
+  if(fd < 0){
+    fprintf(2, "iobench: cannot create %s\n", path);
+    exit(1);
+  }
+  iopoll(poll);
+  iostat(&a);
+  t0 = uptime();
+  for(int i = 0; i < NSYNC; i++){
+    if(write(fd, buf, BSIZE) != BSIZE){
+      fprintf(2, "iobench: write failed\n");
+      exit(1);
+    }
+  }
+  t = uptime() - t0;
+  iostat(&b);
+  iopoll(0);
+  close(fd);
+  unlink(path);
+
+  reqs = b.nreq - a.nreq;
+  if(reqs < 1)
+    reqs = 1;
+  printf("%s: %d writes in %d ticks, %d requests, %d intr/100 req, %d notify/100 req, %d polled\n",
+         mode, NSYNC, t, reqs, (int)(b.nintr - a.nintr) * 100 / reqs,
+         (int)(b.nnotify - a.nnotify) * 100 / reqs, (int)(b.npolled - a.npolled));
+  printf("%s: latency p50 < %d us, p90 < %d us, p99 < %d us\n", mode,
+         percentile(&a, &b, 50), percentile(&a, &b, 90), percentile(&a, &b, 99));
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *path = "iobench.tmp";
+  struct iostat s0, s1;
+  int fd, kb, n, tot, t0;
+
+  kb = 256;
+  if(argc > 1)
+    kb = atoi(argv[1]);
+  if(kb < 1 || kb > MAXFILE*BSIZE/1024)
+    kb = MAXFILE*BSIZE/1024;
+  for(int i = 0; i < CHUNK; i++)
+    buf[i] = 'a' + i % 26;
+
+  unlink(path);
+  fd = open(path, O_CREATE | O_RDWR);
+  if(fd < 0){
+    fprintf(2, "iobench: cannot create %s\n", path);
+    exit(1);
+  }
+  iostat(&s0);
+  t0 = uptime();
+  for(tot = 0; tot < kb*1024; tot += n){
+    n = kb*1024 - tot;
+    if(n > CHUNK)
+      n = CHUNK;
+    if(write(fd, buf, n) != n){
+      fprintf(2, "iobench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+  iostat(&s1);
+  report("write", kb, uptime() - t0, &s0, &s1);
+
+  fd = open(path, O_RDONLY);
+  if(fd < 0){
+    fprintf(2, "iobench: cannot open %s\n", path);
+    exit(1);
+  }
+  iostat(&s0);
+  t0 = uptime();
+  tot = 0;
+  while((n = read(fd, buf, CHUNK)) > 0)
+    tot += n;
+  close(fd);
+  iostat(&s1);
+  if(tot != kb*1024){
+    fprintf(2, "iobench: short read %d\n", tot);
+    exit(1);
+  }
+  report("read", kb, uptime() - t0, &s0, &s1);
+  unlink(path);
+
+  latency("interrupt", path, 0);
+  latency("polled", path, 1);
+  exit(0);
+}
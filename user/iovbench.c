@@ -0,0 +1,144 @@
+// readv()/writev() benchmark.
+//
+//   iovbench [nrec]
+//
+// Writes nrec (default 2000) records, each a 16-byte header,
+// a 200-byte body and an 8-byte trailer in separate buffers,
+// the way a logger or a server assembling a reply would:
+// with a write() per buffer, with a writev() per record, and
+// with one writev() per IOV_MAX buffers. First to a file,
+// where each write()'s bytes go in a log transaction of their
+// own but a writev()'s share one, and then through a pipe to
+// a reader that reads it back with readv(), where a writev()
+// takes the pipe's lock once. Reports the time, the system
+// calls, and for the file the blocks written to the disk and
+// to the log, for each.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/iostat.h"
+#include "kernel/uio.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+#define PER (IOV_MAX / 3)  // records per writev() when batching
+
+enum { WRITE, RECORD, BATCH };
+char *how[] = { "write", "writev/record", "writev/batch" };
+
+char hdr[16], body[200], trl[8];
+char buf[8192];
+int nrec;
+
+void
+die(char *msg)
+{
+  fprintf(2, "iovbench: %s\n", msg);
+  exit(1);
+}
+
+// Write the records to fd in the given way, and return the
+// number of system calls it took.
+int
+send(int fd, int mode)
+{
+  struct iovec iov[IOV_MAX];
+  int i, j, k, n, ncall = 0;
+
+  for(i = 0; i < nrec; i += k){
+    k = mode == BATCH ? PER : 1;
+    if(k > nrec - i)
+      k = nrec - i;
+    for(j = 0; j < k; j++){
+      iov[3*j].iov_base = hdr;
+      iov[3*j].iov_len = sizeof(hdr);
+      iov[3*j+1].iov_base = body;
+      iov[3*j+1].iov_len = sizeof(body);
+      iov[3*j+2].iov_base = trl;
+      iov[3*j+2].iov_len = sizeof(trl);
+    }
+    if(mode == WRITE){
+      for(j = 0; j < 3; j++, ncall++)
+        if(write(fd, iov[j].iov_base, iov[j].iov_len) != iov[j].iov_len)
+          die("write failed");
+    } else {
+      n = k * (sizeof(hdr) + sizeof(body) + sizeof(trl));
+      if(writev(fd, iov, 3*k) != n)
+        die("writev failed");
+      ncall++;
+    }
+  }
+  return ncall;
+}
+
+void
+tofile(int mode)
+{
+  struct iostat s0, s1;
+  int fd, t0, t, ncall;
+
+  if((fd = open("iovf", O_CREATE | O_TRUNC | O_WRONLY)) < 0)
+    die("cannot create iovf");
+  sync();
+  iostat(&s0);
+  t0 = uptime();
+  ncall = send(fd, mode);
+  close(fd);
+  sync();
+  t = uptime() - t0;
+  iostat(&s1);
+  printf("file, %s: %d records in %d ticks, %d calls, %d blocks written, %d to the log\n",
+         how[mode], nrec, t, ncall, (int)(s1.nwrite - s0.nwrite),
+         (int)(s1.nlog - s0.nlog));
+  unlink("iovf");
+}
+
+void
+topipe(int mode)
+{
+  struct iovec iov[2];
+  int fds[2], t0, t, ncall, n, nread;
+
+  if(pipe(fds) < 0)
+    die("pipe failed");
+  t0 = uptime();
+  if(fork() == 0){
+    close(fds[0]);
+    send(fds[1], mode);
+    exit(0);
+  }
+  close(fds[1]);
+  iov[0].iov_base = buf;
+  iov[0].iov_len = sizeof(buf) / 2;
+  iov[1].iov_base = buf + sizeof(buf) / 2;
+  iov[1].iov_len = sizeof(buf) / 2;
+  for(nread = 0; (n = readv(fds[0], iov, 2)) > 0; nread++)
+    ;
+  if(n < 0)
+    die("readv failed");
+  close(fds[0]);
+  wait(0);
+  t = uptime() - t0;
+  ncall = mode == WRITE ? 3 * nrec : mode == RECORD ? nrec : (nrec + PER - 1) / PER;
+  printf("pipe, %s: %d records in %d ticks, %d calls, %d readv()s\n",
+         how[mode], nrec, t, ncall, nread);
+}
+
+int
+main(int argc, char *argv[])
+{
+  nrec = 2000;
+  if(argc > 1)
+    nrec = atoi(argv[1]);
+  if(nrec < 1)
+    nrec = 2000;
+  memset(hdr, 'h', sizeof(hdr));
+  memset(body, 'b', sizeof(body));
+  memset(trl, '\n', sizeof(trl));
+
+  for(int mode = WRITE; mode <= BATCH; mode++)
+    tofile(mode);
+  for(int mode = WRITE; mode <= BATCH; mode++)
+    topipe(mode);
+  exit(0);
+}
@@ -0,0 +1,140 @@
+// Path lookup latency benchmark.
+//
+//   lookbench [depth [n]]
+//
+// Makes a chain of depth (default 8) directories under lbd/,
+// with a file at the bottom, and times n (default 1000)
+// open()s of that file by its full path, then n open()s of a
+// name that doesn't exist there. Then, from the bottom
+// directory, it runs echo n/20 times the way a shell that
+// searches for commands would: exec("echo") in the current
+// directory, which fails, and then exec("/echo"). Reports the
+// time per operation and the disk blocks each one read.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+#define MAXDEPTH 20
+
+char path[4 + 2*MAXDEPTH + 8];
+char miss[4 + 2*MAXDEPTH + 8];
+
+void
+report(char *what, int n, int t, struct iostat *a, struct iostat *b)
+{
+  if(t < 1)
+    t = 1;
+  printf("%s: %d in %d ticks, %d us each, %d blocks read\n",
+         what, n, t, t * (1000000 / HZ) / n, (int)(b->nread - a->nread));
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct iostat s0, s1;
+  char *args[] = { "echo", 0 };
+  int depth, n, fd, t0, len, pid, st;
+
+  depth = 8;
+  if(argc > 1)
+    depth = atoi(argv[1]);
+  if(depth < 1 || depth > MAXDEPTH)
+    depth = 8;
+  n = 1000;
+  if(argc > 2)
+    n = atoi(argv[2]);
+  if(n < 20)
+    n = 1000;
+
+  // lbd/a/b/c/...
+  strcpy(path, "lbd");
+  if(mkdir(path) < 0){
+    fprintf(2, "lookbench: cannot create lbd\n");
+    exit(1);
+  }
+  len = 3;
+  for(int i = 0; i < depth; i++){
+    path[len++] = '/';
+    path[len++] = 'a' + i;
+    path[len] = 0;
+    if(mkdir(path) < 0){
+      fprintf(2, "lookbench: cannot create %s\n", path);
+      exit(1);
+    }
+  }
+  strcpy(miss, path);
+  strcpy(path + len, "/file");
+  strcpy(miss + len, "/none");
+  if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+    fprintf(2, "lookbench: cannot create %s\n", path);
+    exit(1);
+  }
+  close(fd);
+  sync();
+
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < n; i++){
+    if((fd = open(path, O_RDONLY)) < 0){
+      fprintf(2, "lookbench: cannot open %s\n", path);
+      exit(1);
+    }
+    close(fd);
+  }
+  iostat(&s1);
+  report("open", n, uptime() - t0, &s0, &s1);
+
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < n; i++){
+    if(open(miss, O_RDONLY) >= 0){
+      fprintf(2, "lookbench: %s exists\n", miss);
+      exit(1);
+    }
+  }
+  iostat(&s1);
+  report("open missing", n, uptime() - t0, &s0, &s1);
+
+  path[len] = 0;
+  if(chdir(path) < 0){
+    fprintf(2, "lookbench: cannot cd to %s\n", path);
+    exit(1);
+  }
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < n/20; i++){
+    if((pid = fork()) < 0){
+      fprintf(2, "lookbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      close(1); // echo prints nothing
+      exec("echo", args);
+      exec("/echo", args);
+      exit(1);
+    }
+    wait(&st);
+    if(st != 0){
+      fprintf(2, "lookbench: exec echo failed\n");
+      exit(1);
+    }
+  }
+  iostat(&s1);
+  report("exec", n/20, uptime() - t0, &s0, &s1);
+
+  // clean up, from the bottom.
+  unlink("file");
+  for(int i = depth - 1; i >= 0; i--){
+    chdir("..");
+    path[0] = 'a' + i;
+    path[1] = 0;
+    unlink(path);
+  }
+  chdir("..");
+  unlink("lbd");
+  exit(0);
+}
@@ -2,11 +2,14 @@
 #include "kernel/stat.h"
 #include "user/user.h"
 #include "kernel/fs.h"
+#include "kernel/param.h"
+
+#define NAMEW 14 // width of the name column
 
 char*
 fmtname(char *path)
 {
-  static char buf[DIRSIZ+1];
+  static char buf[NAMEW+1];
   char *p;
 
   // Find first character after last slash.
@@ -15,19 +18,20 @@ fmtname(char *path)
   p++;
 
   // Return blank-padded name.
-  if(strlen(p) >= DIRSIZ)
+  if(strlen(p) >= NAMEW)
     return p;
   memmove(buf, p, strlen(p));
-  memset(buf+strlen(p), ' ', DIRSIZ-strlen(p));
+  memset(buf+strlen(p), ' ', NAMEW-strlen(p));
   return buf;
 }
 
 void
 ls(char *path)
 {
-  char buf[512], *p;
-  int fd;
-  struct dirent de;
+  static char buf[MAXPATH+1+DIRSIZ+1], blk[BSIZE];
+  char *p;
+  int fd, off;
+  struct dirent *de;
   struct stat st;
 
   if((fd = open(path, 0)) < 0){
@@ -54,16 +58,18 @@ ls(char *path)
     strcpy(buf, path);
     p = buf+strlen(buf);
     *p++ = '/';
-    while(read(fd, &de, sizeof(de)) == sizeof(de)){
-      if(de.inum == 0)
-        continue;
-      memmove(p, de.name, DIRSIZ);
-      p[DIRSIZ] = 0;
-      if(stat(buf, &st) < 0){
-        printf("ls: cannot stat %s\n", buf);
-        continue;
+    while(read(fd, blk, BSIZE) == BSIZE){
+      for(off = 0; off < BSIZE && (de = (struct dirent*)(blk+off))->reclen > 0; off += de->reclen){
+        if(de->inum == 0)
+          continue;
+        memmove(p, de->name, de->namelen);
+        p[de->namelen] = 0;
+        if(stat(buf, &st) < 0){
+          printf("ls: cannot stat %s\n", buf);
+          continue;
+        }
+        printf("%s %d %d %d\n", fmtname(buf), st.type, st.ino, st.size);
       }
-      printf("%s %d %d %d\n", fmtname(buf), st.type, st.ino, st.size);
     }
     break;
   }
@@ -0,0 +1,101 @@
+// File system metadata benchmark.
+//
+//   metabench [nproc [nfiles]]
+//
+// Forks nproc (default 4) processes that each create, write
+// a few bytes to, and then unlink nfiles (default 50) files,
+// all at the same time, like stressfs. Reports operations per
+// second and the disk requests they cost.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+
+void
+child(int id, int nfiles)
+{
+  char path[] = "mb0.000";
+  int fd;
+
+  path[2] = '0' + id % 10;
+  for(int i = 0; i < nfiles; i++){
+    path[4] = '0' + i / 100 % 10;
+    path[5] = '0' + i / 10 % 10;
+    path[6] = '0' + i % 10;
+    fd = open(path, O_CREATE | O_RDWR);
+    if(fd < 0){
+      fprintf(2, "metabench: cannot create %s\n", path);
+      exit(1);
+    }
+    if(write(fd, path, sizeof(path)) != sizeof(path)){
+      fprintf(2, "metabench: write failed\n");
+      exit(1);
+    }
+    close(fd);
+  }
+  for(int i = 0; i < nfiles; i++){
+    path[4] = '0' + i / 100 % 10;
+    path[5] = '0' + i / 10 % 10;
+    path[6] = '0' + i % 10;
+    if(unlink(path) < 0){
+      fprintf(2, "metabench: cannot unlink %s\n", path);
+      exit(1);
+    }
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct iostat s0, s1;
+  int nproc, nfiles, ops, reqs, t0, t, st, failed;
+
+  nproc = 4;
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(nproc < 1 || nproc > 10)
+    nproc = 4;
+  nfiles = 50;
+  if(argc > 2)
+    nfiles = atoi(argv[2]);
+  if(nfiles < 1 || nfiles > 1000)
+    nfiles = 50;
+
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < nproc; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "metabench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      child(i, nfiles);
+  }
+  failed = 0;
+  for(int i = 0; i < nproc; i++){
+    wait(&st);
+    if(st != 0)
+      failed = 1;
+  }
+  t = uptime() - t0;
+  iostat(&s1);
+  if(failed){
+    fprintf(2, "metabench: a child failed\n");
+    exit(1);
+  }
+
+  if(t < 1)
+    t = 1;
+  // each file costs a create, a write and an unlink.
+  ops = 3 * nproc * nfiles;
+  reqs = s1.nreq - s0.nreq;
+  printf("%d procs: %d ops in %d ticks, %d ops/s, %d disk requests, %d blocks written, %d requests/100 ops\n",
+         nproc, ops, t, ops*HZ/t, reqs, (int)(s1.nwrite - s0.nwrite), reqs*100/ops);
+  exit(0);
+}
@@ -0,0 +1,176 @@
+// Event loop benchmark.
+//
+//   nbbench [nclients [nreqs]]
+//
+// nclients (default 8) client processes each send nreqs
+// (default 2000) requests, in bursts of BURST, through a pipe
+// of their own, and read the replies from another. One server
+// process answers them all, three ways: using poll() to find
+// the clients with requests waiting, and reading one request
+// per poll(); using poll(), and then reading the pipes, made
+// O_NONBLOCK, until read() returns -EAGAIN, so that one
+// poll() serves a whole burst; and without poll(), looping
+// over the O_NONBLOCK pipes. Reports the requests per second,
+// and the poll()s or read()s per request, for each.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "kernel/poll.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+#define MAXC ((NOFILE - 3) / 2) // a server holds two fds per client
+#define BURST 16
+
+enum { ONE, DRAIN, SPIN };
+
+int req[MAXC][2], rep[MAXC][2];
+int nclients, nreqs;
+
+void
+die(char *msg)
+{
+  fprintf(2, "nbbench: %s\n", msg);
+  exit(1);
+}
+
+void
+client(int c)
+{
+  int v[BURST], n, m;
+
+  for(int j = 0; j < nclients; j++){
+    close(req[j][0]);
+    close(rep[j][1]);
+    if(j != c){
+      close(req[j][1]);
+      close(rep[j][0]);
+    }
+  }
+  for(int i = 0; i < nreqs; i += BURST){
+    for(int k = 0; k < BURST; k++)
+      v[k] = i + k;
+    if(write(req[c][1], v, sizeof(v)) != sizeof(v))
+      die("client write failed");
+    for(n = 0; n < sizeof(v); n += m)
+      if((m = read(rep[c][0], (char*)v + n, sizeof(v) - n)) <= 0)
+        die("client read failed");
+    for(int k = 0; k < BURST; k++)
+      if(v[k] != i + k + 1)
+        die("bad reply");
+  }
+  exit(0);
+}
+
+// Answer the requests in v[0..n-1] from client c.
+void
+reply(int c, int *v, int n)
+{
+  for(int k = 0; k < n; k++)
+    v[k]++;
+  if(write(rep[c][1], v, n * sizeof(int)) != n * sizeof(int))
+    die("server write failed");
+}
+
+// Serve the clients until they have all gone away, and
+// return the number of poll()s, or of read()s if how is SPIN.
+int
+serve(int how)
+{
+  struct pollfd fds[MAXC];
+  int v[MAXC * BURST], left, n, count;
+
+  for(int c = 0; c < nclients; c++){
+    fds[c].fd = req[c][0];
+    fds[c].events = POLLIN;
+    if(how != ONE)
+      fcntl(fds[c].fd, F_SETFL, O_NONBLOCK);
+  }
+  count = 0;
+  for(left = nclients; left > 0; ){
+    if(how != SPIN){
+      if(poll(fds, nclients, -1) <= 0)
+        die("poll failed");
+      count++;
+    }
+    for(int c = 0; c < nclients; c++){
+      if(fds[c].fd < 0 || (how != SPIN && fds[c].revents == 0))
+        continue;
+      for(;;){
+        if(how == SPIN)
+          count++;
+        n = read(fds[c].fd, v, how == ONE ? sizeof(int) : sizeof(v));
+        if(n == -EAGAIN)
+          break;
+        if(n <= 0){
+          // the client is done.
+          fds[c].fd = -1;
+          left--;
+          break;
+        }
+        if(n % sizeof(int) != 0)
+          die("partial request");
+        reply(c, v, n / sizeof(int));
+        if(how != DRAIN)
+          break;
+      }
+    }
+  }
+  return count;
+}
+
+void
+run(char *what, int how)
+{
+  int t0, t, count;
+
+  for(int c = 0; c < nclients; c++)
+    if(pipe(req[c]) < 0 || pipe(rep[c]) < 0)
+      die("pipe failed");
+  t0 = uptime();
+  for(int c = 0; c < nclients; c++){
+    int pid = fork();
+    if(pid < 0)
+      die("fork failed");
+    if(pid == 0)
+      client(c);
+  }
+  for(int c = 0; c < nclients; c++){
+    close(req[c][1]);
+    close(rep[c][0]);
+  }
+  count = serve(how);
+  for(int c = 0; c < nclients; c++){
+    close(req[c][0]);
+    close(rep[c][1]);
+  }
+  while(wait(0) >= 0)
+    ;
+  if((t = uptime() - t0) < 1)
+    t = 1;
+  printf("%s: %d requests in %d ticks, %d requests/s, %d %s per 100 requests\n",
+         what, nclients * nreqs, t, nclients * nreqs * HZ / t,
+         count * 100 / (nclients * nreqs), how == SPIN ? "reads" : "polls");
+}
+
+int
+main(int argc, char *argv[])
+{
+  nclients = 8;
+  if(argc > 1)
+    nclients = atoi(argv[1]);
+  if(nclients < 1 || nclients > MAXC)
+    nclients = 8;
+  nreqs = 2000;
+  if(argc > 2)
+    nreqs = atoi(argv[2]);
+  if(nreqs < BURST)
+    nreqs = 2000;
+  nreqs -= nreqs % BURST;
+
+  run("poll, one request per read", ONE);
+  run("poll, O_NONBLOCK reads until -EAGAIN", DRAIN);
+  run("O_NONBLOCK reads, no poll", SPIN);
+  exit(0);
+}
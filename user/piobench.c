@@ -0,0 +1,114 @@
+// Parallel disk I/O benchmark.
+//
+//   piobench [nproc [kbytes]]
+//
+// Forks nproc (default 3, one per hart) processes that each
+// write a file of kbytes (default 128) and then read it back,
+// all at the same time. Reports aggregate throughput and the
+// disk requests issued. With a multi-queue disk each hart
+// submits on its own queue; compare against num-queues=1.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+#define HZ    10          // clock ticks per second; see kernel/start.c
+#define CHUNK (16*1024)
+
+char buf[CHUNK];
+
+void
+child(int id, int kb)
+{
+  char path[] = "piobench.0";
+  int fd, n, tot;
+
+  path[9] = '0' + id % 10;
+  for(int i = 0; i < CHUNK; i++)
+    buf[i] = 'a' + (i + id) % 26;
+
+  unlink(path);
+  fd = open(path, O_CREATE | O_RDWR);
+  if(fd < 0){
+    fprintf(2, "piobench: cannot create %s\n", path);
+    exit(1);
+  }
+  for(tot = 0; tot < kb*1024; tot += n){
+    n = kb*1024 - tot;
+    if(n > CHUNK)
+      n = CHUNK;
+    if(write(fd, buf, n) != n){
+      fprintf(2, "piobench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+
+  fd = open(path, O_RDONLY);
+  if(fd < 0){
+    fprintf(2, "piobench: cannot open %s\n", path);
+    exit(1);
+  }
+  tot = 0;
+  while((n = read(fd, buf, CHUNK)) > 0)
+    tot += n;
+  close(fd);
+  unlink(path);
+  if(tot != kb*1024){
+    fprintf(2, "piobench: short read %d\n", tot);
+    exit(1);
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct iostat s0, s1;
+  int nproc, kb, t0, t, st, reqs, failed;
+
+  nproc = 3;
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(nproc < 1 || nproc > 10)
+    nproc = 3;
+  kb = 128;
+  if(argc > 2)
+    kb = atoi(argv[2]);
+  if(kb < 1 || kb > MAXFILE*BSIZE/1024)
+    kb = MAXFILE*BSIZE/1024;
+
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < nproc; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "piobench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      child(i, kb);
+  }
+  failed = 0;
+  for(int i = 0; i < nproc; i++){
+    wait(&st);
+    if(st != 0)
+      failed = 1;
+  }
+  t = uptime() - t0;
+  iostat(&s1);
+  if(failed){
+    fprintf(2, "piobench: a child failed\n");
+    exit(1);
+  }
+
+  if(t < 1)
+    t = 1;
+  reqs = s1.nreq - s0.nreq;
+  printf("%d procs, %d queues: %d KB written and read in %d ticks, %d KB/s, %d requests (%d req/s)\n",
+         nproc, (int)s1.nqueue, 2*nproc*kb, t, 2*nproc*kb*HZ/t, reqs, reqs*HZ/t);
+  exit(0);
+}
@@ -0,0 +1,122 @@
+// Pipe benchmark.
+//
+//   pipebench [kb [n]]
+//
+// Sends kb (default 4096) kilobytes from a child to its parent
+// through a pipe, for several sizes of write() and of the
+// pipe's buffer (see fcntl(F_SETPIPE_SZ)), and reports the
+// bandwidth. Then two processes pass a byte back and forth
+// through a pair of pipes n (default 2000) times, and it
+// reports the time per round trip. A pipe copies data a page
+// at a time, so bandwidth should grow with the write size up
+// to the buffer size, and a bigger buffer means fewer switches
+// between writer and reader.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+
+char buf[65536];
+
+void
+die(char *msg)
+{
+  fprintf(2, "pipebench: %s\n", msg);
+  exit(1);
+}
+
+void
+bandwidth(int kb, int wsize, int psize)
+{
+  int fds[2], pid, n, t0, t;
+  uint64 total, left;
+
+  if(pipe(fds) < 0)
+    die("pipe failed");
+  if(fcntl(fds[1], F_SETPIPE_SZ, psize) < 0)
+    die("F_SETPIPE_SZ failed");
+  total = (uint64)kb * 1024;
+  t0 = uptime();
+  if((pid = fork()) < 0)
+    die("fork failed");
+  if(pid == 0){
+    close(fds[0]);
+    for(left = total; left > 0; left -= n){
+      n = left < wsize ? left : wsize;
+      if(write(fds[1], buf, n) != n)
+        die("write failed");
+    }
+    exit(0);
+  }
+  close(fds[1]);
+  for(left = total; left > 0; left -= n){
+    if((n = read(fds[0], buf, sizeof(buf))) <= 0)
+      die("read failed");
+  }
+  close(fds[0]);
+  wait(0);
+  if((t = uptime() - t0) < 1)
+    t = 1;
+  printf("write %d, pipe %d: %d KB in %d ticks, %d KB/s\n",
+         wsize, psize, kb, t, kb * HZ / t);
+}
+
+void
+pingpong(int n)
+{
+  int a[2], b[2], pid, t0, t;
+  char c;
+
+  if(pipe(a) < 0 || pipe(b) < 0)
+    die("pipe failed");
+  if((pid = fork()) < 0)
+    die("fork failed");
+  if(pid == 0){
+    close(a[1]);
+    close(b[0]);
+    while(read(a[0], &c, 1) == 1)
+      write(b[1], &c, 1);
+    exit(0);
+  }
+  close(a[0]);
+  close(b[1]);
+  t0 = uptime();
+  for(int i = 0; i < n; i++){
+    if(write(a[1], &c, 1) != 1 || read(b[0], &c, 1) != 1)
+      die("ping-pong failed");
+  }
+  if((t = uptime() - t0) < 1)
+    t = 1;
+  close(a[1]);
+  close(b[0]);
+  wait(0);
+  printf("ping-pong: %d round trips in %d ticks, %d us each\n",
+         n, t, t * (1000000 / HZ) / n);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int wsizes[] = { 64, 512, 4096, 16384 };
+  int psizes[] = { 4096, 65536 };
+  int kb, n;
+
+  kb = 4096;
+  if(argc > 1)
+    kb = atoi(argv[1]);
+  if(kb < 1)
+    kb = 4096;
+  n = 2000;
+  if(argc > 2)
+    n = atoi(argv[2]);
+  if(n < 1)
+    n = 2000;
+
+  for(int i = 0; i < sizeof(psizes)/sizeof(psizes[0]); i++)
+    for(int j = 0; j < sizeof(wsizes)/sizeof(wsizes[0]); j++)
+      bandwidth(kb, wsizes[j], psizes[i]);
+  pingpong(n);
+  exit(0);
+}
@@ -0,0 +1,158 @@
+// poll() benchmark.
+//
+//   pollbench [nclients [nreqs]]
+//
+// nclients (default 8) client processes each send nreqs
+// (default 500) requests, one at a time, each through a pipe
+// of its own, and wait for each reply on another pipe. First
+// one server process answers them all, using poll() to find
+// the clients with requests waiting; then, the way a server
+// without poll() must, one server process per client answers
+// them. Reports the requests per second for each.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/poll.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+#define MAXC ((NOFILE - 3) / 2) // a server holds two fds per client
+
+int req[MAXC][2], rep[MAXC][2];
+int nclients, nreqs;
+
+void
+die(char *msg)
+{
+  fprintf(2, "pollbench: %s\n", msg);
+  exit(1);
+}
+
+void
+client(int c)
+{
+  int r;
+
+  for(int j = 0; j < nclients; j++){
+    close(req[j][0]);
+    close(rep[j][1]);
+    if(j != c){
+      close(req[j][1]);
+      close(rep[j][0]);
+    }
+  }
+  for(int i = 0; i < nreqs; i++){
+    if(write(req[c][1], &i, sizeof(i)) != sizeof(i))
+      die("client write failed");
+    if(read(rep[c][0], &r, sizeof(r)) != sizeof(r) || r != i + 1)
+      die("bad reply");
+  }
+  exit(0);
+}
+
+// Answer the requests from client c until it goes away.
+void
+serve(int c)
+{
+  int v;
+
+  while(read(req[c][0], &v, sizeof(v)) == sizeof(v)){
+    v++;
+    if(write(rep[c][1], &v, sizeof(v)) != sizeof(v))
+      die("server write failed");
+  }
+}
+
+// Answer the requests from all the clients.
+void
+pollserve(void)
+{
+  struct pollfd fds[MAXC];
+  int left, v;
+
+  for(int c = 0; c < nclients; c++){
+    fds[c].fd = req[c][0];
+    fds[c].events = POLLIN;
+  }
+  for(left = nclients; left > 0; ){
+    if(poll(fds, nclients, -1) <= 0)
+      die("poll failed");
+    for(int c = 0; c < nclients; c++){
+      if(fds[c].revents == 0)
+        continue;
+      if(read(fds[c].fd, &v, sizeof(v)) != sizeof(v)){
+        // the client is done.
+        fds[c].fd = -1;
+        left--;
+        continue;
+      }
+      v++;
+      if(write(rep[c][1], &v, sizeof(v)) != sizeof(v))
+        die("server write failed");
+    }
+  }
+}
+
+void
+run(char *what, int usepoll)
+{
+  int t0, t;
+
+  for(int c = 0; c < nclients; c++)
+    if(pipe(req[c]) < 0 || pipe(rep[c]) < 0)
+      die("pipe failed");
+  t0 = uptime();
+  for(int c = 0; c < nclients; c++){
+    int pid = fork();
+    if(pid < 0)
+      die("fork failed");
+    if(pid == 0)
+      client(c);
+  }
+  for(int c = 0; c < nclients; c++){
+    close(req[c][1]);
+    close(rep[c][0]);
+  }
+  if(usepoll){
+    pollserve();
+  } else {
+    for(int c = 0; c < nclients; c++){
+      int pid = fork();
+      if(pid < 0)
+        die("fork failed");
+      if(pid == 0){
+        serve(c);
+        exit(0);
+      }
+    }
+  }
+  for(int c = 0; c < nclients; c++){
+    close(req[c][0]);
+    close(rep[c][1]);
+  }
+  while(wait(0) >= 0)
+    ;
+  if((t = uptime() - t0) < 1)
+    t = 1;
+  printf("%s: %d clients, %d requests in %d ticks, %d requests/s\n",
+         what, nclients, nclients * nreqs, t, nclients * nreqs * HZ / t);
+}
+
+int
+main(int argc, char *argv[])
+{
+  nclients = 8;
+  if(argc > 1)
+    nclients = atoi(argv[1]);
+  if(nclients < 1 || nclients > MAXC)
+    nclients = 8;
+  nreqs = 500;
+  if(argc > 2)
+    nreqs = atoi(argv[2]);
+  if(nreqs < 1)
+    nreqs = 500;
+
+  run("poll, one server", 1);
+  run("no poll, a server per client", 0);
+  exit(0);
+}
@@ -0,0 +1,122 @@
+// Parallel random-read benchmark.
+//
+//   prbench [kb [nreads]]
+//
+// Writes a file of kb (default 512) kilobytes, and then 1, 2
+// and 4 processes, forked with one shared file descriptor,
+// make nreads (default 2000) reads of a block between them at
+// random offsets with pread(), which doesn't use the
+// descriptor's offset, and check what they read. For
+// comparison, the same processes then read the file through
+// the shared descriptor with read(), where each read() takes
+// whatever block the shared offset has reached. Reports the
+// reads per second and the blocks read from the disk.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+
+char buf[BSIZE];
+int kb, nreads;
+
+void
+die(char *msg)
+{
+  fprintf(2, "prbench: %s\n", msg);
+  exit(1);
+}
+
+void
+fill(int b)
+{
+  for(int i = 0; i < BSIZE; i++)
+    buf[i] = b + i;
+}
+
+// Run nproc children on fd, with pread() or read(), and
+// report how it went. Each child exits with the number of
+// reads it made.
+void
+run(int fd, int nproc, int usepread)
+{
+  struct iostat s0, s1;
+  int t0, t, i, n, xst, nblocks;
+  uint x;
+
+  nblocks = kb * 1024 / BSIZE;
+  iostat(&s0);
+  t0 = uptime();
+  for(int k = 0; k < nproc; k++){
+    if(fork() == 0){
+      x = k * 7919 + 1;
+      for(i = 0; i < nreads / nproc; i++){
+        if(usepread){
+          x = x * 1103515245 + 12345;
+          int b = (x >> 8) % nblocks;
+          if(pread(fd, buf, BSIZE, b * BSIZE) != BSIZE || buf[0] != (char)b){
+            fprintf(2, "prbench: pread got wrong data\n");
+            exit(-1);
+          }
+        } else if(read(fd, buf, BSIZE) <= 0){
+          break;
+        }
+      }
+      exit(i);
+    }
+  }
+  n = 0;
+  for(int k = 0; k < nproc; k++){
+    wait(&xst);
+    if(xst < 0)
+      exit(1);
+    n += xst;
+  }
+  if((t = uptime() - t0) < 1)
+    t = 1;
+  iostat(&s1);
+  printf("%s, %d procs: %d reads in %d ticks, %d reads/s, %d blocks from disk\n",
+         usepread ? "pread" : "read", nproc, n, t, n * HZ / t,
+         (int)(s1.nread - s0.nread));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd;
+
+  kb = 512;
+  if(argc > 1)
+    kb = atoi(argv[1]);
+  if(kb < 1)
+    kb = 512;
+  nreads = 2000;
+  if(argc > 2)
+    nreads = atoi(argv[2]);
+  if(nreads < 4)
+    nreads = 2000;
+
+  if((fd = open("prf", O_CREATE | O_TRUNC | O_WRONLY)) < 0)
+    die("cannot create prf");
+  for(int b = 0; b < kb * 1024 / BSIZE; b++){
+    fill(b);
+    if(write(fd, buf, BSIZE) != BSIZE)
+      die("write prf failed");
+  }
+  close(fd);
+  sync();
+
+  for(int usepread = 1; usepread >= 0; usepread--){
+    for(int nproc = 1; nproc <= 4; nproc *= 2){
+      if((fd = open("prf", O_RDONLY)) < 0)
+        die("cannot open prf");
+      run(fd, nproc, usepread);
+      close(fd);
+    }
+  }
+  unlink("prf");
+  exit(0);
+}
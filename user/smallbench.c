@@ -0,0 +1,119 @@
+// Small file benchmark.
+//
+//   smallbench [nfiles [size]]
+//
+// Creates nfiles (default 100) files of size (default 100)
+// bytes in sfd/, then reads them all back, and reports the
+// files per second and the disk blocks written and read for
+// each phase, and the disk blocks that hold the data. A file
+// that fits in its inode (see kernel/fs.h) needs no data
+// block at all, so creating it writes only the inode and
+// the directory, and reading it needs only the inode, which
+// open() has read anyway. How much fits depends on the inode
+// size: make INODESIZE=512 for up to 496 bytes, or make
+// INLINE=off to compare with every file in a block of its own.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+
+char path[] = "sfd/f000";
+char buf[BSIZE];
+
+void
+name(int i)
+{
+  path[5] = '0' + i / 100 % 10;
+  path[6] = '0' + i / 10 % 10;
+  path[7] = '0' + i % 10;
+}
+
+void
+report(char *phase, int n, int t, struct iostat *a, struct iostat *b)
+{
+  if(t < 1)
+    t = 1;
+  printf("%s: %d files in %d ticks, %d files/s, %d blocks written, %d read\n",
+         phase, n, t, n*HZ/t, (int)(b->nwrite - a->nwrite),
+         (int)(b->nread - a->nread));
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct iostat s0, s1;
+  struct stat st;
+  int nfiles, size, n, fd, t0, nblocks, ninline;
+
+  nfiles = 100;
+  if(argc > 1)
+    nfiles = atoi(argv[1]);
+  if(nfiles < 1 || nfiles > 1000)
+    nfiles = 100;
+  size = 100;
+  if(argc > 2)
+    size = atoi(argv[2]);
+  if(size < 1 || size > BSIZE)
+    size = 100;
+  for(int i = 0; i < size; i++)
+    buf[i] = 'a' + i % 26;
+
+  if(mkdir("sfd") < 0){
+    fprintf(2, "smallbench: cannot create sfd\n");
+    exit(1);
+  }
+  sync();
+
+  iostat(&s0);
+  t0 = uptime();
+  for(n = 0; n < nfiles; n++){
+    name(n);
+    if((fd = open(path, O_CREATE | O_RDWR)) < 0)
+      break;  // out of inodes
+    if(write(fd, buf, size) != size){
+      fprintf(2, "smallbench: write %s failed\n", path);
+      exit(1);
+    }
+    close(fd);
+  }
+  sync();
+  iostat(&s1);
+  if(n == 0){
+    fprintf(2, "smallbench: cannot create any files\n");
+    exit(1);
+  }
+  report("create", n, uptime() - t0, &s0, &s1);
+
+  iostat(&s0);
+  t0 = uptime();
+  nblocks = ninline = 0;
+  for(int i = 0; i < n; i++){
+    name(i);
+    if((fd = open(path, O_RDONLY)) < 0 || read(fd, buf, BSIZE) != size){
+      fprintf(2, "smallbench: read %s failed\n", path);
+      exit(1);
+    }
+    fstat(fd, &st);
+    if(st.nextent == 0)
+      ninline++;
+    else
+      nblocks += (st.size + BSIZE - 1) / BSIZE + st.nmeta;
+    close(fd);
+  }
+  iostat(&s1);
+  report("read", n, uptime() - t0, &s0, &s1);
+  printf("disk: %d of %d files inline, %d data blocks, %d KB\n",
+         ninline, n, nblocks, nblocks * BSIZE / 1024);
+
+  for(int i = 0; i < n; i++){
+    name(i);
+    unlink(path);
+  }
+  unlink("sfd");
+  exit(0);
+}
@@ -0,0 +1,131 @@
+// Local socket benchmark.
+//
+//   sockbench [n [size]]
+//
+// A client process sends n (default 10000) requests of size
+// (default 64) bytes to a server process, which sends each one
+// back, and waits for each reply before sending the next
+// request. The two talk over a pair of pipes, over a stream
+// socket, and over a seqpacket socket, and each reports the
+// average round trip, timed with rdtime().
+
+#include "kernel/types.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/vdso.h"
+#include "kernel/socket.h"
+#include "user/user.h"
+
+#define MAXSIZE 4096
+
+char buf[MAXSIZE];
+int n, size;
+
+void
+die(char *msg)
+{
+  fprintf(2, "sockbench: %s\n", msg);
+  exit(1);
+}
+
+// Read exactly size bytes from fd.
+int
+readall(int fd)
+{
+  int m, tot;
+
+  for(tot = 0; tot < size; tot += m)
+    if((m = read(fd, buf + tot, size - tot)) <= 0)
+      return -1;
+  return 0;
+}
+
+// Send each of n requests on wfd, and wait for its reply
+// on rfd.
+void
+client(int rfd, int wfd, char *what)
+{
+  uint64 t0, ns;
+
+  t0 = rdtime();
+  for(int i = 0; i < n; i++){
+    buf[0] = i;
+    if(write(wfd, buf, size) != size || readall(rfd) < 0 || buf[0] != (char)i)
+      die("bad reply");
+  }
+  ns = (rdtime() - t0) * 1000000000 / ((struct vdso*)VDSO)->timebase;
+  printf("%s: %d round trips of %d bytes, %d ns each\n", what, n, size, (int)(ns / n));
+}
+
+// Echo requests from rfd to wfd until the client goes away.
+void
+server(int rfd, int wfd)
+{
+  while(readall(rfd) == 0)
+    if(write(wfd, buf, size) != size)
+      die("server write failed");
+  exit(0);
+}
+
+void
+pipes(void)
+{
+  int req[2], rep[2];
+
+  if(pipe(req) < 0 || pipe(rep) < 0)
+    die("pipe failed");
+  if(fork() == 0){
+    close(req[1]);
+    close(rep[0]);
+    server(req[0], rep[1]);
+  }
+  close(req[0]);
+  close(rep[1]);
+  client(rep[0], req[1], "pipes");
+  close(req[1]);
+  close(rep[0]);
+  wait(0);
+}
+
+void
+sock(int type, char *what)
+{
+  int ls, c, s;
+
+  unlink("sockbench.sock");
+  if((ls = socket(type)) < 0 || bind(ls, "sockbench.sock") < 0 || listen(ls, 1) < 0)
+    die("listen failed");
+  if(fork() == 0){
+    if((s = accept(ls)) < 0)
+      die("accept failed");
+    close(ls);
+    server(s, s);
+  }
+  if((c = socket(type)) < 0 || connect(c, "sockbench.sock") < 0)
+    die("connect failed");
+  close(ls);
+  client(c, c, what);
+  close(c);
+  wait(0);
+  unlink("sockbench.sock");
+}
+
+int
+main(int argc, char *argv[])
+{
+  n = 10000;
+  size = 64;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(argc > 2)
+    size = atoi(argv[2]);
+  if(n < 1)
+    n = 10000;
+  if(size < 1 || size > MAXSIZE)
+    size = 64;
+
+  pipes();
+  sock(SOCK_STREAM, "stream socket");
+  sock(SOCK_SEQPACKET, "seqpacket socket");
+  exit(0);
+}
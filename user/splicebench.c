@@ -0,0 +1,136 @@
+// splice() benchmark.
+//
+//   splicebench [kb]
+//
+// Writes a file of kb (default 1024) kilobytes, and then, the
+// way cat file | wc would, sends it through a pipe to a reader
+// process, first with read() and write() through a user
+// buffer, and then with splice(), which moves it from the
+// buffer cache straight into the pipe's pages. Then the same
+// in the other direction, from a pipe into a file. Reports
+// the bandwidth of each, and checks that the copy is intact.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+
+char buf[8192];
+
+void
+die(char *msg)
+{
+  fprintf(2, "splicebench: %s\n", msg);
+  exit(1);
+}
+
+void
+report(char *what, int kb, int t)
+{
+  if(t < 1)
+    t = 1;
+  printf("%s: %d KB in %d ticks, %d KB/s\n", what, kb, t, kb * HZ / t);
+}
+
+// Copy from in to out, with splice() or with read() and write().
+void
+copy(int in, int out, int usesplice)
+{
+  int n;
+
+  if(usesplice){
+    while((n = splice(in, out, sizeof(buf))) > 0)
+      ;
+  } else {
+    while((n = read(in, buf, sizeof(buf))) > 0)
+      if(write(out, buf, n) != n)
+        die("write failed");
+  }
+  if(n < 0)
+    die("copy failed");
+}
+
+// Send file name through a pipe from a child to a process
+// that copies it to file out, or just reads it if out is 0.
+void
+run(char *what, char *name, char *out, int kb, int splicein, int spliceout)
+{
+  int fds[2], fd, t0;
+
+  if(pipe(fds) < 0)
+    die("pipe failed");
+  t0 = uptime();
+  if(fork() == 0){
+    close(fds[0]);
+    if((fd = open(name, O_RDONLY)) < 0)
+      die("cannot open file");
+    copy(fd, fds[1], splicein);
+    exit(0);
+  }
+  close(fds[1]);
+  if(out == 0){
+    while(read(fds[0], buf, sizeof(buf)) > 0)
+      ;
+  } else {
+    if((fd = open(out, O_CREATE | O_TRUNC | O_WRONLY)) < 0)
+      die("cannot create copy");
+    copy(fds[0], fd, spliceout);
+    close(fd);
+  }
+  close(fds[0]);
+  wait(0);
+  report(what, kb, uptime() - t0);
+}
+
+// Check that file name holds the pattern writefile() wrote.
+void
+check(char *name, int kb)
+{
+  int fd, n, off;
+
+  if((fd = open(name, O_RDONLY)) < 0)
+    die("cannot open copy");
+  for(off = 0; (n = read(fd, buf, sizeof(buf))) > 0; off += n)
+    for(int i = 0; i < n; i++)
+      if(buf[i] != (char)((off + i) / 1024 + (off + i)))
+        die("copy has wrong data");
+  if(off != kb * 1024)
+    die("copy has the wrong size");
+  close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int kb, fd, off;
+
+  kb = 1024;
+  if(argc > 1)
+    kb = atoi(argv[1]);
+  if(kb < 1)
+    kb = 1024;
+
+  if((fd = open("sbf", O_CREATE | O_TRUNC | O_WRONLY)) < 0)
+    die("cannot create sbf");
+  for(off = 0; off < kb * 1024; off += sizeof(buf)){
+    for(int i = 0; i < sizeof(buf); i++)
+      buf[i] = (off + i) / 1024 + (off + i);
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf))
+      die("write sbf failed");
+  }
+  close(fd);
+  kb = off / 1024;
+  sync();
+
+  run("file to pipe, read/write", "sbf", 0, kb, 0, 0);
+  run("file to pipe, splice", "sbf", 0, kb, 1, 0);
+  run("pipe to file, read/write", "sbf", "sbf.copy", kb, 1, 0);
+  check("sbf.copy", kb);
+  run("pipe to file, splice", "sbf", "sbf.copy", kb, 1, 1);
+  check("sbf.copy", kb);
+
+  unlink("sbf");
+  unlink("sbf.copy");
+  exit(0);
+}
@@ -0,0 +1,117 @@
+// Path lookup benchmark.
+//
+//   statbench [ndirs [nfiles [npass]]]
+//
+// Makes a tree of ndirs (default 10) directories under sbd/,
+// each with nfiles (default 100) empty files, then stat()s
+// every file by its full path npass (default 5) times over.
+// Reports the stats per second, and the disk blocks read per
+// stat, for each pass. Each stat looks up four inodes: /,
+// sbd, the directory, and the file, so once the inode table
+// holds the whole tree, a pass should read nothing from the
+// disk. The tree stops growing if the disk runs out of
+// inodes; make NINODES=2000 builds a file system with room
+// for the default tree.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+
+char path[] = "/sbd/d00/f000";
+
+void
+name(int d, int f)
+{
+  path[6] = '0' + d / 10 % 10;
+  path[7] = '0' + d % 10;
+  path[10] = '0' + f / 100 % 10;
+  path[11] = '0' + f / 10 % 10;
+  path[12] = '0' + f % 10;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct iostat s0, s1;
+  struct stat st;
+  int ndirs, nfiles, npass, n, fd, t, t0;
+
+  ndirs = 10;
+  if(argc > 1)
+    ndirs = atoi(argv[1]);
+  if(ndirs < 1 || ndirs > 100)
+    ndirs = 10;
+  nfiles = 100;
+  if(argc > 2)
+    nfiles = atoi(argv[2]);
+  if(nfiles < 1 || nfiles > 1000)
+    nfiles = 100;
+  npass = 5;
+  if(argc > 3)
+    npass = atoi(argv[3]);
+  if(npass < 1)
+    npass = 5;
+
+  if(mkdir("/sbd") < 0){
+    fprintf(2, "statbench: cannot create /sbd\n");
+    exit(1);
+  }
+  n = 0;
+  for(int d = 0; d < ndirs; d++){
+    name(d, 0);
+    path[8] = 0;
+    if(mkdir(path) < 0)
+      break;
+    path[8] = '/';
+    for(int f = 0; f < nfiles; f++){
+      name(d, f);
+      if((fd = open(path, O_CREATE | O_RDWR)) < 0)
+        break;
+      close(fd);
+      n++;
+    }
+  }
+  sync();
+  if(n == 0){
+    fprintf(2, "statbench: cannot create any files\n");
+    exit(1);
+  }
+  printf("statbench: %d files in %d directories\n", n, (n + nfiles - 1) / nfiles);
+
+  for(int p = 0; p < npass; p++){
+    iostat(&s0);
+    t0 = uptime();
+    for(int i = 0; i < n; i++){
+      name(i / nfiles, i % nfiles);
+      if(stat(path, &st) < 0){
+        fprintf(2, "statbench: cannot stat %s\n", path);
+        exit(1);
+      }
+    }
+    t = uptime() - t0;
+    iostat(&s1);
+    if(t < 1)
+      t = 1;
+    printf("pass %d: %d stats in %d ticks, %d stats/s, %d blocks read, %d.%d%d per stat\n",
+           p, n, t, n*HZ/t, (int)(s1.nread - s0.nread),
+           (int)(s1.nread - s0.nread) / n, (int)(s1.nread - s0.nread) * 10 / n % 10,
+           (int)(s1.nread - s0.nread) * 100 / n % 10);
+  }
+
+  for(int i = 0; i < n; i++){
+    name(i / nfiles, i % nfiles);
+    unlink(path);
+  }
+  for(int d = 0; d < ndirs; d++){
+    name(d, 0);
+    path[8] = 0;
+    unlink(path);
+    path[8] = '/';
+  }
+  unlink("/sbd");
+  exit(0);
+}
@@ -0,0 +1,81 @@
+// Log commit benchmark.
+//
+//   syncbench [n]
+//
+// First creates, writes and unlinks n (default 100) files
+// without waiting for the log, to measure metadata throughput.
+// Then does n small appends each followed by sync(), to
+// measure the latency of a durable update. Reports disk
+// requests from iostat(): a commit is one batch of adjacent
+// log blocks, so a sync should cost about one request.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+
+int
+main(int argc, char *argv[])
+{
+  struct iostat s0, s1;
+  char path[] = "sb.000";
+  int n, fd, t0, t, reqs;
+
+  n = 100;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n < 1 || n > 1000)
+    n = 100;
+
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < n; i++){
+    path[3] = '0' + i / 100 % 10;
+    path[4] = '0' + i / 10 % 10;
+    path[5] = '0' + i % 10;
+    fd = open(path, O_CREATE | O_RDWR);
+    if(fd < 0 || write(fd, path, sizeof(path)) != sizeof(path)){
+      fprintf(2, "syncbench: cannot create %s\n", path);
+      exit(1);
+    }
+    close(fd);
+    if(unlink(path) < 0){
+      fprintf(2, "syncbench: cannot unlink %s\n", path);
+      exit(1);
+    }
+  }
+  sync();
+  t = uptime() - t0;
+  iostat(&s1);
+  if(t < 1)
+    t = 1;
+  reqs = s1.nreq - s0.nreq;
+  printf("metadata: %d create/write/unlink in %d ticks, %d ops/s, %d disk requests\n",
+         n, t, 3*n*HZ/t, reqs);
+
+  fd = open("sb.log", O_CREATE | O_RDWR);
+  if(fd < 0){
+    fprintf(2, "syncbench: cannot create sb.log\n");
+    exit(1);
+  }
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < n; i++){
+    if(write(fd, path, sizeof(path)) != sizeof(path)){
+      fprintf(2, "syncbench: write failed\n");
+      exit(1);
+    }
+    sync();
+  }
+  t = uptime() - t0;
+  iostat(&s1);
+  close(fd);
+  unlink("sb.log");
+  reqs = s1.nreq - s0.nreq;
+  printf("sync: %d write+sync in %d ticks, %d us each, %d disk requests, %d requests/sync\n",
+         n, t, t * (1000000/HZ) / n, reqs, reqs / n);
+  exit(0);
+}
@@ -1,6 +1,9 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/vdso.h"
 #include "user/user.h"
 
 char*
@@ -134,3 +137,34 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// These read the pages that the kernel keeps at VDSO and
+// VPROC, instead of making a system call; see kernel/vdso.c.
+
+int
+uptime(void)
+{
+  return ((volatile struct vdso*)VDSO)->ticks;
+}
+
+int
+getpid(void)
+{
+  return ((struct vproc*)VPROC)->pid;
+}
+
+// The hart this process is running on, or was a moment ago.
+int
+gethart(void)
+{
+  return ((volatile struct vproc*)VPROC)->hart;
+}
+
+// The time CSR: ((struct vdso*)VDSO)->timebase per second.
+uint64
+rdtime(void)
+{
+  uint64 x;
+  asm volatile("rdtime %0" : "=r" (x));
+  return x;
+}
@@ -0,0 +1,169 @@
+// Shared-ring system call benchmark.
+//
+//   uringbench [nops [batch]]
+//
+// Makes nops (default 4000) small system calls of several
+// kinds, first one trap each, and then through the rings of
+// uring_setup(), batch (default 32) to a uring_enter(): no-ops
+// (getpid() for the plain calls), 64-byte write()s to a file,
+// 64-byte pread()s at random offsets in it, and open()s and
+// close()s. Reports the operations per second for each, and
+// how many traps they took.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/uring.h"
+#include "user/user.h"
+
+#define HZ 10 // clock ticks per second; see kernel/start.c
+#define SZ 64 // bytes per read or write
+
+char buf[SZ];
+struct uring *r;
+int nops, batch;
+
+void
+die(char *msg)
+{
+  fprintf(2, "uringbench: %s\n", msg);
+  exit(1);
+}
+
+void
+report(char *what, int t, int ntrap)
+{
+  if(t < 1)
+    t = 1;
+  printf("%s: %d ops in %d ticks, %d ops/s, %d traps\n",
+         what, nops, t, nops * HZ / t, ntrap);
+}
+
+// Run the submitted sqes, and check their completions
+// against want, or just that they didn't fail if want < 0.
+void
+flush(int want)
+{
+  struct cqe *c;
+  int n = r->sqtail - r->sqhead;
+
+  if(uring_enter(n) != n)
+    die("uring_enter failed");
+  while(r->cqhead != r->cqtail){
+    c = &r->cq[r->cqhead++ % URING_N];
+    if(want >= 0 ? c->res != want : c->res < 0)
+      die("ring operation failed");
+  }
+}
+
+void
+submit(int op, int fd, void *addr, int len, uint off)
+{
+  struct sqe *e = &r->sq[r->sqtail % URING_N];
+
+  e->op = op;
+  e->fd = fd;
+  e->addr = (uint64)addr;
+  e->len = len;
+  e->off = off;
+  e->data = 0;
+  r->sqtail++;
+}
+
+// Run nops operations of kind op: one trap each if ring is
+// 0, else batch sqes to a trap. An open/close is two.
+void
+run(char *what, int op, int ring)
+{
+  int fd, fd1, t0, i, ntrap = 0;
+  uint x = 1;
+
+  if((fd = open("urf", O_RDWR)) < 0)
+    die("cannot open urf");
+  t0 = uptime();
+  for(i = 0; i < nops; i++){
+    x = x * 1103515245 + 12345;
+    if(ring){
+      if(r->sqtail - r->sqhead + 2 > batch){
+        flush(op == UR_OPEN ? -1 : op == UR_NOP ? 0 : SZ);
+        ntrap++;
+      }
+      switch(op){
+      case UR_NOP:
+      case UR_WRITE:
+        submit(op, fd, buf, SZ, 0);
+        break;
+      case UR_PREAD:
+        submit(op, fd, buf, SZ, (x >> 8) % (nops * SZ - SZ));
+        break;
+      case UR_OPEN:
+        // the sqes run in order, so the open gets the
+        // lowest free fd, the one above fd, for the close.
+        submit(UR_OPEN, 0, "urf", O_RDONLY, 0);
+        submit(UR_CLOSE, fd + 1, 0, 0, 0);
+        break;
+      }
+    } else {
+      switch(op){
+      case UR_NOP:
+        getpid();
+        break;
+      case UR_WRITE:
+        if(write(fd, buf, SZ) != SZ)
+          die("write failed");
+        break;
+      case UR_PREAD:
+        if(pread(fd, buf, SZ, (x >> 8) % (nops * SZ - SZ)) != SZ)
+          die("pread failed");
+        break;
+      case UR_OPEN:
+        if((fd1 = open("urf", O_RDONLY)) < 0)
+          die("open failed");
+        close(fd1);
+        ntrap++;
+        break;
+      }
+      ntrap++;
+    }
+  }
+  if(ring){
+    flush(op == UR_OPEN ? -1 : op == UR_NOP ? 0 : SZ);
+    ntrap++;
+  }
+  report(what, uptime() - t0, ntrap);
+  close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd;
+
+  nops = 4000;
+  if(argc > 1)
+    nops = atoi(argv[1]);
+  if(nops < 2)
+    nops = 4000;
+  batch = 32;
+  if(argc > 2)
+    batch = atoi(argv[2]);
+  if(batch < 2 || batch > URING_N)
+    batch = 32;
+  if((r = uring_setup()) == (struct uring*)-1)
+    die("uring_setup failed");
+
+  if((fd = open("urf", O_CREATE | O_TRUNC | O_WRONLY)) < 0)
+    die("cannot create urf");
+  close(fd);
+  memset(buf, 'u', SZ);
+
+  run("getpid", UR_NOP, 0);
+  run("ring nop", UR_NOP, 1);
+  run("write", UR_WRITE, 0);
+  run("ring write", UR_WRITE, 1);
+  run("pread", UR_PREAD, 0);
+  run("ring pread", UR_PREAD, 1);
+  run("open/close", UR_OPEN, 0);
+  run("ring open/close", UR_OPEN, 1);
+  unlink("urf");
+  exit(0);
+}
@@ -1,5 +1,9 @@
 struct stat;
 struct rtcdate;
+struct iostat;
+struct pollfd;
+struct iovec;
+struct uring;
 
 // system calls
 int fork(void);
@@ -19,10 +23,30 @@ int link(const char*, const char*);
 int mkdir(const char*);
 int chdir(const char*);
 int dup(int);
-int getpid(void);
+int sys_getpid(void);
 char* sbrk(int);
 int sleep(int);
-int uptime(void);
+int sys_uptime(void);
+int iostat(struct iostat*);
+int iopoll(int);
+int sync(void);
+int fsync(int);
+int fcntl(int, int, int);
+int splice(int, int, int);
+int tee(int, int, int);
+int copy_file_range(int, int, int);
+int poll(struct pollfd*, int, int);
+int readv(int, struct iovec*, int);
+int writev(int, struct iovec*, int);
+int pread(int, void*, int, int);
+int pwrite(int, const void*, int, int);
+struct uring* uring_setup(void);
+int uring_enter(int);
+int socket(int);
+int bind(int, const char*);
+int listen(int, int);
+int accept(int);
+int connect(int, const char*);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -40,3 +64,7 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+int getpid(void);
+int uptime(void);
+int gethart(void);
+uint64 rdtime(void);
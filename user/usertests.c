@@ -4,6 +4,11 @@
 #include "user/user.h"
 #include "kernel/fs.h"
 #include "kernel/fcntl.h"
+#include "kernel/poll.h"
+#include "kernel/uio.h"
+#include "kernel/uring.h"
+#include "kernel/vdso.h"
+#include "kernel/socket.h"
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
@@ -569,6 +574,10 @@ writetest(char *s)
   }
 }
 
+// writebig's file has this many blocks, enough to need
+// a double-indirect block, if the file system uses them.
+#define BIGFILE (NDIRECT + NINDIRECT + 100)
+
 void
 writebig(char *s)
 {
@@ -580,7 +589,7 @@ writebig(char *s)
     exit(1);
   }
 
-  for(i = 0; i < MAXFILE; i++){
+  for(i = 0; i < BIGFILE; i++){
     ((int*)buf)[0] = i;
     if(write(fd, buf, BSIZE) != BSIZE){
       printf("%s: error: write big file failed\n", s, i);
@@ -600,7 +609,7 @@ writebig(char *s)
   for(;;){
     i = read(fd, buf, BSIZE);
     if(i == 0){
-      if(n == MAXFILE - 1){
+      if(n != BIGFILE){
         printf("%s: read only %d blocks from big", s, n);
         exit(1);
       }
@@ -623,6 +632,102 @@ writebig(char *s)
   }
 }
 
+// fsync() writes back data that is waiting for disk blocks,
+// and the data reads back the same before and after.
+void
+fsynctest(char *s)
+{
+  struct stat st;
+  int i, fd;
+
+  if(fsync(-1) >= 0){
+    printf("%s: fsync(-1) succeeded\n", s);
+    exit(1);
+  }
+  fd = open("fsyncf", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create fsyncf failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 20; i++){
+    memset(buf, 'a' + i, BSIZE);
+    if(write(fd, buf, BSIZE - i) != BSIZE - i){
+      printf("%s: write fsyncf failed\n", s);
+      exit(1);
+    }
+  }
+  if(fsync(fd) < 0 || fstat(fd, &st) < 0){
+    printf("%s: fsync fsyncf failed\n", s);
+    exit(1);
+  }
+  if(st.size != 20*BSIZE - 190 || st.nextent < 1){
+    printf("%s: fsyncf has size %d, %d extents\n", s, (int)st.size, st.nextent);
+    exit(1);
+  }
+  close(fd);
+
+  fd = open("fsyncf", O_RDONLY);
+  for(i = 0; i < 20; i++){
+    if(read(fd, buf, BSIZE - i) != BSIZE - i || buf[0] != 'a' + i || buf[BSIZE-i-1] != 'a' + i){
+      printf("%s: fsyncf has wrong content\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink("fsyncf");
+}
+
+// file data is written in place, not through the log: an
+// overwrite reads back, and so does a file that reuses the
+// blocks of one deleted in a transaction that may not have
+// committed yet.
+void
+ordertest(char *s)
+{
+  int i, fd, round;
+
+  for(round = 0; round < 2; round++){
+    fd = open("orderf", O_CREATE|O_RDWR);
+    if(fd < 0){
+      printf("%s: create orderf failed\n", s);
+      exit(1);
+    }
+    for(i = 0; i < 16; i++){
+      memset(buf, 'a' + round + i, BSIZE);
+      if(write(fd, buf, BSIZE) != BSIZE){
+        printf("%s: write orderf failed\n", s);
+        exit(1);
+      }
+    }
+    fsync(fd);
+    close(fd);
+
+    // overwrite blocks 4..7, which now have disk blocks.
+    fd = open("orderf", O_RDWR);
+    for(i = 0; i < 4; i++)
+      read(fd, buf, BSIZE);
+    for(i = 4; i < 8; i++){
+      memset(buf, 'A' + i, BSIZE);
+      if(write(fd, buf, BSIZE) != BSIZE){
+        printf("%s: overwrite orderf failed\n", s);
+        exit(1);
+      }
+    }
+    close(fd);
+
+    fd = open("orderf", O_RDONLY);
+    for(i = 0; i < 16; i++){
+      int c = i >= 4 && i < 8 ? 'A' + i : 'a' + round + i;
+      if(read(fd, buf, BSIZE) != BSIZE || buf[0] != c || buf[BSIZE-1] != c){
+        printf("%s: orderf block %d has wrong content\n", s, i);
+        exit(1);
+      }
+    }
+    close(fd);
+    unlink("orderf");
+  }
+}
+
 // many creates, followed by unlink test
 void
 createtest(char *s)
@@ -653,128 +758,907 @@ void dirtest(char *s)
     exit(1);
   }
 
-  if(chdir("dir0") < 0){
-    printf("%s: chdir dir0 failed\n", s);
+  if(chdir("dir0") < 0){
+    printf("%s: chdir dir0 failed\n", s);
+    exit(1);
+  }
+
+  if(chdir("..") < 0){
+    printf("%s: chdir .. failed\n", s);
+    exit(1);
+  }
+
+  if(unlink("dir0") < 0){
+    printf("%s: unlink dir0 failed\n", s);
+    exit(1);
+  }
+}
+
+void
+exectest(char *s)
+{
+  int fd, xstatus, pid;
+  char *echoargv[] = { "echo", "OK", 0 };
+  char buf[3];
+
+  unlink("echo-ok");
+  pid = fork();
+  if(pid < 0) {
+     printf("%s: fork failed\n", s);
+     exit(1);
+  }
+  if(pid == 0) {
+    close(1);
+    fd = open("echo-ok", O_CREATE|O_WRONLY);
+    if(fd < 0) {
+      printf("%s: create failed\n", s);
+      exit(1);
+    }
+    if(fd != 1) {
+      printf("%s: wrong fd\n", s);
+      exit(1);
+    }
+    if(exec("echo", echoargv) < 0){
+      printf("%s: exec echo failed\n", s);
+      exit(1);
+    }
+    // won't get to here
+  }
+  if (wait(&xstatus) != pid) {
+    printf("%s: wait failed!\n", s);
+  }
+  if(xstatus != 0)
+    exit(xstatus);
+
+  fd = open("echo-ok", O_RDONLY);
+  if(fd < 0) {
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  if (read(fd, buf, 2) != 2) {
+    printf("%s: read failed\n", s);
+    exit(1);
+  }
+  unlink("echo-ok");
+  if(buf[0] == 'O' && buf[1] == 'K')
+    exit(0);
+  else {
+    printf("%s: wrong output\n", s);
+    exit(1);
+  }
+
+}
+
+// simple fork and pipe read/write
+
+void
+pipe1(char *s)
+{
+  int fds[2], pid, xstatus;
+  int seq, i, n, cc, total;
+  enum { N=5, SZ=1033 };
+  
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  seq = 0;
+  if(pid == 0){
+    close(fds[0]);
+    for(n = 0; n < N; n++){
+      for(i = 0; i < SZ; i++)
+        buf[i] = seq++;
+      if(write(fds[1], buf, SZ) != SZ){
+        printf("%s: pipe1 oops 1\n", s);
+        exit(1);
+      }
+    }
+    exit(0);
+  } else if(pid > 0){
+    close(fds[1]);
+    total = 0;
+    cc = 1;
+    while((n = read(fds[0], buf, cc)) > 0){
+      for(i = 0; i < n; i++){
+        if((buf[i] & 0xff) != (seq++ & 0xff)){
+          printf("%s: pipe1 oops 2\n", s);
+          return;
+        }
+      }
+      total += n;
+      cc = cc * 2;
+      if(cc > sizeof(buf))
+        cc = sizeof(buf);
+    }
+    if(total != N * SZ){
+      printf("%s: pipe1 oops 3 total %d\n", total);
+      exit(1);
+    }
+    close(fds[0]);
+    wait(&xstatus);
+    exit(xstatus);
+  } else {
+    printf("%s: fork() failed\n", s);
+    exit(1);
+  }
+}
+
+// resize a pipe's buffer with fcntl(F_SETPIPE_SZ), and check
+// that what it holds survives, and that it holds what it says.
+void
+pipesize(char *s)
+{
+  int fds[2], fd, i, n;
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[0], F_GETPIPE_SZ, 0) != 4096){
+    printf("%s: default pipe size %d\n", s, fcntl(fds[0], F_GETPIPE_SZ, 0));
+    exit(1);
+  }
+  for(i = 0; i < 3000; i++)
+    buf[i] = i;
+  if(write(fds[1], buf, 3000) != 3000){
+    printf("%s: pipe write failed\n", s);
+    exit(1);
+  }
+  // rounds up to a power-of-two number of pages.
+  if(fcntl(fds[1], F_SETPIPE_SZ, 9000) != 16384 ||
+     fcntl(fds[0], F_GETPIPE_SZ, 0) != 16384){
+    printf("%s: F_SETPIPE_SZ 9000 failed\n", s);
+    exit(1);
+  }
+  // fill it, without a reader to make room.
+  for(i = 3000; i < 16384; i++)
+    buf[i] = i;
+  if(write(fds[1], buf + 3000, 16384 - 3000) != 16384 - 3000){
+    printf("%s: pipe write failed\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[1], F_SETPIPE_SZ, 4096) != -1){
+    printf("%s: shrank a full pipe\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[1], F_SETPIPE_SZ, 1<<30) != -1){
+    printf("%s: F_SETPIPE_SZ 1<<30 succeeded\n", s);
+    exit(1);
+  }
+  memset(buf, 0, 16384);
+  for(i = 0; i < 16384; i += n){
+    if((n = read(fds[0], buf + i, 16384 - i)) <= 0){
+      printf("%s: pipe read failed\n", s);
+      exit(1);
+    }
+  }
+  for(i = 0; i < 16384; i++){
+    if((buf[i] & 0xff) != (i & 0xff)){
+      printf("%s: wrong data at %d\n", s, i);
+      exit(1);
+    }
+  }
+  if(fcntl(fds[0], F_SETPIPE_SZ, 0) != 4096){
+    printf("%s: F_SETPIPE_SZ 0 failed\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  fd = open("echo", O_RDONLY);
+  if(fd < 0 || fcntl(fd, F_GETPIPE_SZ, 0) != -1){
+    printf("%s: F_GETPIPE_SZ on a file\n", s);
+    exit(1);
+  }
+  close(fd);
+}
+
+// splice() a file into a pipe, tee() it into another pipe,
+// and splice() both out to files.
+void
+splicetest(char *s)
+{
+  int a[2], b[2], fd, out, i, n;
+  enum { SZ = 3000 };
+
+  fd = open("spl", O_CREATE|O_RDWR);
+  for(i = 0; i < SZ; i++)
+    buf[i] = i * 7;
+  if(fd < 0 || write(fd, buf, SZ) != SZ){
+    printf("%s: create spl failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(pipe(a) != 0 || pipe(b) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+
+  fd = open("spl", O_RDONLY);
+  if(splice(fd, a[1], 100) != 100 || splice(fd, a[1], SZ) != SZ - 100 ||
+     splice(fd, a[1], SZ) != 0){
+    printf("%s: splice file to pipe failed\n", s);
+    exit(1);
+  }
+  if(splice(fd, fd, 10) != -1 || tee(fd, a[1], 10) != -1 ||
+     splice(a[0], a[1], 10) != -1 || splice(a[1], b[1], 10) != -1){
+    printf("%s: bad splice succeeded\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  if(tee(a[0], b[1], SZ) != SZ){
+    printf("%s: tee failed\n", s);
+    exit(1);
+  }
+  out = open("spl.a", O_CREATE|O_RDWR);
+  if(splice(a[0], out, SZ) != SZ){
+    printf("%s: splice pipe to file failed\n", s);
+    exit(1);
+  }
+  close(out);
+  close(b[1]);
+  out = open("spl.b", O_CREATE|O_RDWR);
+  for(i = 0; (n = splice(b[0], out, 1000)) > 0; i += n)
+    ;
+  if(n != 0 || i != SZ){
+    printf("%s: splice pipe to file failed\n", s);
+    exit(1);
+  }
+  close(out);
+  close(a[0]);
+  close(a[1]);
+  close(b[0]);
+
+  for(i = 0; i < 2; i++){
+    fd = open(i == 0 ? "spl.a" : "spl.b", O_RDONLY);
+    memset(buf, 0, SZ);
+    if(read(fd, buf, SZ + 1) != SZ){
+      printf("%s: spliced file has the wrong size\n", s);
+      exit(1);
+    }
+    for(n = 0; n < SZ; n++){
+      if((buf[n] & 0xff) != ((n * 7) & 0xff)){
+        printf("%s: spliced file has wrong data\n", s);
+        exit(1);
+      }
+    }
+    close(fd);
+  }
+  unlink("spl");
+  unlink("spl.a");
+  unlink("spl.b");
+}
+
+// two splices in opposite directions between two full pipes
+// must neither deadlock nor keep plain readers out.
+void
+crossplicetest(char *s)
+{
+  int p[2][2], pid[2], n, xst;
+
+  for(int i = 0; i < 2; i++){
+    if(pipe(p[i]) != 0 || (n = fcntl(p[i][1], F_GETPIPE_SZ, 0)) <= 0){
+      printf("%s: pipe() failed\n", s);
+      exit(1);
+    }
+    memset(buf, 'a' + i, n);
+    if(write(p[i][1], buf, n) != n){
+      printf("%s: cannot fill pipe\n", s);
+      exit(1);
+    }
+  }
+  for(int i = 0; i < 2; i++){
+    if((pid[i] = fork()) < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid[i] == 0)
+      exit(splice(p[i][0], p[1-i][1], 100) == 100 ? 0 : 1);
+  }
+  sleep(2);  // let both splices wait for room
+  for(int i = 0; i < 2; i++){
+    if(read(p[i][0], buf, 200) != 200 || buf[0] != 'a' + i){
+      printf("%s: read of a spliced pipe failed\n", s);
+      exit(1);
+    }
+  }
+  for(int i = 0; i < 2; i++){
+    wait(&xst);
+    if(xst != 0){
+      printf("%s: crossed splice failed\n", s);
+      exit(1);
+    }
+  }
+  for(int i = 0; i < 2; i++){
+    close(p[i][0]);
+    close(p[i][1]);
+  }
+}
+
+// copy a file with copy_file_range(), in two pieces.
+void
+copyrange(char *s)
+{
+  int in, out, fds[2], i, n;
+  enum { SZ = 3*BSIZE + 100 };
+
+  in = open("cfr", O_CREATE|O_RDWR);
+  for(i = 0; i < SZ; i++)
+    buf[i] = i * 3;
+  if(in < 0 || write(in, buf, SZ) != SZ){
+    printf("%s: create cfr failed\n", s);
+    exit(1);
+  }
+  close(in);
+
+  in = open("cfr", O_RDONLY);
+  out = open("cfr.copy", O_CREATE|O_RDWR);
+  if(copy_file_range(in, out, 1000) != 1000 ||
+     copy_file_range(in, out, SZ) != SZ - 1000 ||
+     copy_file_range(in, out, SZ) != 0){
+    printf("%s: copy_file_range failed\n", s);
+    exit(1);
+  }
+  if(copy_file_range(in, in, 10) != -1 || copy_file_range(out, in, 10) != -1){
+    printf("%s: bad copy_file_range succeeded\n", s);
+    exit(1);
+  }
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  if(copy_file_range(fds[0], out, 10) != -1){
+    printf("%s: copy_file_range from a pipe succeeded\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+  close(in);
+  close(out);
+
+  out = open("cfr.copy", O_RDONLY);
+  memset(buf, 0, SZ);
+  if(read(out, buf, SZ + 1) != SZ){
+    printf("%s: copy has the wrong size\n", s);
+    exit(1);
+  }
+  for(n = 0; n < SZ; n++){
+    if((buf[n] & 0xff) != ((n * 3) & 0xff)){
+      printf("%s: copy has wrong data\n", s);
+      exit(1);
+    }
+  }
+  close(out);
+  unlink("cfr");
+  unlink("cfr.copy");
+}
+
+// poll() pipes for reading and writing.
+void
+polltest(char *s)
+{
+  struct pollfd fds[3];
+  int a[2], b[2], pid, xstatus;
+  char c;
+
+  if(pipe(a) != 0 || pipe(b) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  fds[0].fd = a[0];
+  fds[0].events = POLLIN;
+  fds[1].fd = b[0];
+  fds[1].events = POLLIN;
+  fds[2].fd = a[1];
+  fds[2].events = POLLOUT;
+  if(poll(fds, 2, 0) != 0 || poll(fds, 2, 2) != 0 || fds[0].revents != 0){
+    printf("%s: poll of empty pipes found something\n", s);
+    exit(1);
+  }
+  if(poll(fds, 3, -1) != 1 || fds[2].revents != POLLOUT){
+    printf("%s: poll for POLLOUT failed\n", s);
+    exit(1);
+  }
+
+  // wait for a child to write.
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    sleep(2);
+    write(b[1], "x", 1);
+    exit(0);
+  }
+  if(poll(fds, 2, -1) != 1 || fds[0].revents != 0 || fds[1].revents != POLLIN){
+    printf("%s: poll didn't see the write\n", s);
+    exit(1);
+  }
+  if(read(b[0], &c, 1) != 1 || c != 'x'){
+    printf("%s: read after poll failed\n", s);
+    exit(1);
+  }
+  wait(&xstatus);
+
+  close(b[1]);
+  if(poll(fds, 2, -1) != 1 || fds[1].revents != (POLLIN|POLLHUP)){
+    printf("%s: poll didn't see the close\n", s);
+    exit(1);
+  }
+  close(a[0]);
+  fds[0].fd = -1;
+  if(poll(fds, 3, 0) != 2 || fds[0].revents != 0 || fds[2].revents != (POLLOUT|POLLERR)){
+    printf("%s: poll of a pipe without a reader\n", s);
+    exit(1);
+  }
+  close(a[1]);
+  close(b[0]);
+  fds[0].fd = a[1];
+  if(poll(fds, 1, 0) != 1 || fds[0].revents != POLLNVAL){
+    printf("%s: poll of a closed fd\n", s);
+    exit(1);
+  }
+}
+
+// read() and write() on O_NONBLOCK pipes and files.
+void
+nonblock(char *s)
+{
+  int fds[2], fd;
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[0], F_GETFL, 0) != O_RDONLY || fcntl(fds[1], F_GETFL, 0) != O_WRONLY){
+    printf("%s: F_GETFL of a pipe\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[0], F_SETFL, O_NONBLOCK) != 0 || fcntl(fds[1], F_SETFL, O_NONBLOCK) != 0 ||
+     fcntl(fds[0], F_GETFL, 0) != (O_RDONLY|O_NONBLOCK)){
+    printf("%s: F_SETFL O_NONBLOCK failed\n", s);
+    exit(1);
+  }
+  if(read(fds[0], buf, 10) != -EAGAIN){
+    printf("%s: read of an empty pipe didn't return -EAGAIN\n", s);
+    exit(1);
+  }
+  if(write(fds[1], buf, 5000) != 4096 || write(fds[1], buf, 10) != -EAGAIN){
+    printf("%s: write to a full pipe didn't stop\n", s);
+    exit(1);
+  }
+  if(read(fds[0], buf, 5000) != 4096 || read(fds[0], buf, 10) != -EAGAIN){
+    printf("%s: read of the pipe failed\n", s);
+    exit(1);
+  }
+  close(fds[1]);
+  if(read(fds[0], buf, 10) != 0){
+    printf("%s: no end of file after close\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+
+  fd = open("nbf", O_CREATE|O_RDWR|O_NONBLOCK);
+  if(fd < 0 || fcntl(fd, F_GETFL, 0) != (O_RDWR|O_NONBLOCK) ||
+     write(fd, "abc", 3) != 3){
+    printf("%s: O_NONBLOCK file failed\n", s);
+    exit(1);
+  }
+  if(fcntl(fd, F_SETFL, 0) != 0 || fcntl(fd, F_GETFL, 0) != O_RDWR){
+    printf("%s: F_SETFL 0 failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("nbf");
+}
+
+// readv() and writev() on a file and a pipe, with buffers
+// that cross block and page boundaries.
+void
+iovtest(char *s)
+{
+  struct iovec iov[4];
+  static char a[3000], b[7000];
+  int fds[2], fd, n;
+
+  for(int i = 0; i < sizeof(a); i++)
+    a[i] = 'a' + i % 23;
+  for(int i = 0; i < sizeof(b); i++)
+    b[i] = 'A' + i % 19;
+  iov[0].iov_base = a;
+  iov[0].iov_len = sizeof(a);
+  iov[1].iov_base = a;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = b;
+  iov[2].iov_len = sizeof(b);
+  n = sizeof(a) + sizeof(b);
+
+  fd = open("iovf", O_CREATE|O_RDWR);
+  if(fd < 0 || writev(fd, iov, 3) != n){
+    printf("%s: writev to a file failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(writev(fd, iov, 3) != -1 || writev(1, iov, -1) != -1 || writev(1, iov, IOV_MAX+1) != -1){
+    printf("%s: bad writev succeeded\n", s);
+    exit(1);
+  }
+  fd = open("iovf", O_RDONLY);
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 100;
+  iov[1].iov_base = buf + 100;
+  iov[1].iov_len = n;
+  if(fd < 0 || readv(fd, iov, 2) != n || readv(fd, iov, 2) != 0){
+    printf("%s: readv of a file failed\n", s);
+    exit(1);
+  }
+  if(memcmp(buf, a, sizeof(a)) != 0 || memcmp(buf + sizeof(a), b, sizeof(b)) != 0){
+    printf("%s: readv of a file has wrong data\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("iovf");
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  iov[0].iov_base = a;
+  iov[0].iov_len = 10;
+  iov[1].iov_base = b;
+  iov[1].iov_len = 20;
+  if(writev(fds[1], iov, 2) != 30){
+    printf("%s: writev to a pipe failed\n", s);
+    exit(1);
+  }
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 5;
+  iov[1].iov_base = buf + 5;
+  iov[1].iov_len = 100;
+  if(readv(fds[0], iov, 2) != 30 || memcmp(buf, a, 10) != 0 || memcmp(buf + 10, b, 20) != 0){
+    printf("%s: readv of a pipe failed\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// pread() and pwrite() don't use or move the file offset,
+// so forked children can share one fd for random reads.
+void
+preadtest(char *s)
+{
+  int fd, fds[2], pid, xst;
+  char c;
+
+  fd = open("prf", O_CREATE|O_RDWR);
+  for(int i = 0; i < 4*BSIZE; i++)
+    buf[i] = i % 101;
+  if(fd < 0 || write(fd, buf, 4*BSIZE) != 4*BSIZE){
+    printf("%s: create prf failed\n", s);
+    exit(1);
+  }
+  if(pread(fd, &c, 1, 1000) != 1 || c != 1000 % 101 ||
+     pread(fd, buf, 10, 4*BSIZE) != 0 || pread(fd, buf, 10, -1) != -1){
+    printf("%s: pread failed\n", s);
+    exit(1);
+  }
+  c = 'x';
+  if(pwrite(fd, &c, 1, 7) != 1 || pwrite(fd, &c, 1, 4*BSIZE+1) != -1){
+    printf("%s: pwrite failed\n", s);
+    exit(1);
+  }
+  // the offset is still at the end, where write() left it.
+  if(read(fd, buf, 1) != 0 || write(fd, "y", 1) != 1 ||
+     pread(fd, &c, 1, 4*BSIZE) != 1 || c != 'y'){
+    printf("%s: pread/pwrite moved the offset\n", s);
+    exit(1);
+  }
+
+  for(int k = 0; k < 4; k++){
+    if((pid = fork()) < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      for(int i = 0; i < 200; i++){
+        int off = (i * 997 + k * 131) % (4*BSIZE);
+        if(pread(fd, &c, 1, off) != 1 || c != (off == 7 ? 'x' : off % 101))
+          exit(1);
+      }
+      exit(0);
+    }
+  }
+  for(int k = 0; k < 4; k++){
+    wait(&xst);
+    if(xst != 0){
+      printf("%s: parallel pread got wrong data\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink("prf");
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  if(pwrite(fds[1], "a", 1, 0) != -1 || pread(fds[0], &c, 1, 0) != -1){
+    printf("%s: pread/pwrite of a pipe succeeded\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+static void
+ursubmit(struct uring *r, int op, int fd, void *addr, int len, uint off)
+{
+  struct sqe *e = &r->sq[r->sqtail % URING_N];
+
+  e->op = op;
+  e->fd = fd;
+  e->addr = (uint64)addr;
+  e->len = len;
+  e->off = off;
+  e->data = r->sqtail;
+  r->sqtail++;
+}
+
+// system calls through the shared rings.
+void
+uringtest(char *s)
+{
+  struct uring *r;
+  int fd, pid, xst;
+  int want[] = { 5, 5, 1, 0, 0, -1, -1 };
+
+  r = uring_setup();
+  if(r == (struct uring*)-1 || uring_setup() != r || r->sqhead != 0 || r->cqtail != 0){
+    printf("%s: uring_setup failed\n", s);
+    exit(1);
+  }
+  ursubmit(r, UR_OPEN, 0, "urf", O_CREATE|O_RDWR, 0);
+  ursubmit(r, UR_NOP, 0, 0, 0, 0);
+  if(uring_enter(10) != 2 || r->cqtail != 2 || r->sqhead != 2 ||
+     (fd = r->cq[0].res) < 0 || r->cq[1].res != 0 || r->cq[1].data != 1){
+    printf("%s: uring open failed\n", s);
+    exit(1);
+  }
+  r->cqhead = 2;
+
+  ursubmit(r, UR_WRITE, fd, "hello", 5, 0);
+  ursubmit(r, UR_PREAD, fd, buf, 5, 0);
+  ursubmit(r, UR_PWRITE, fd, "J", 1, 0);
+  ursubmit(r, UR_FSYNC, fd, 0, 0, 0);
+  ursubmit(r, UR_CLOSE, fd, 0, 0, 0);
+  ursubmit(r, UR_READ, fd, buf, 5, 0);
+  ursubmit(r, 99, 0, 0, 0, 0);
+  if(uring_enter(1) != 1 || uring_enter(100) != 6){
+    printf("%s: uring_enter didn't run the batch\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < sizeof(want)/sizeof(want[0]); i++){
+    struct cqe *c = &r->cq[r->cqhead++ % URING_N];
+    if(c->data != 2 + i || c->res != want[i]){
+      printf("%s: uring op %d returned %d\n", s, i, c->res);
+      exit(1);
+    }
+  }
+  if(memcmp(buf, "hello", 5) != 0){
+    printf("%s: uring pread got wrong data\n", s);
+    exit(1);
+  }
+  fd = open("urf", O_RDONLY);
+  if(fd < 0 || read(fd, buf, 10) != 5 || memcmp(buf, "Jello", 5) != 0){
+    printf("%s: uring write wrote wrong data\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("urf");
+
+  // a child doesn't share its parent's rings.
+  if((pid = fork()) < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0)
+    exit(uring_enter(0) == -1 ? 0 : 1);
+  wait(&xst);
+  if(xst != 0){
+    printf("%s: child has its parent's rings\n", s);
+    exit(1);
+  }
+}
+
+// uptime() and getpid() from the vDSO pages agree with the
+// system calls, and the pages are read-only.
+void
+vdsotest(char *s)
+{
+  int pid, ppid, xst, t0, t1;
+  uint64 c0;
+
+  t0 = sys_uptime();
+  t1 = uptime();
+  if(t1 < t0 || t1 > t0 + 1 || getpid() != sys_getpid()){
+    printf("%s: vDSO disagrees with the system calls\n", s);
+    exit(1);
+  }
+  if(gethart() < 0 || gethart() >= NCPU ||
+     ((struct vdso*)VDSO)->timebase == 0 || ((struct vdso*)VDSO)->ticklen == 0){
+    printf("%s: bad vDSO contents\n", s);
+    exit(1);
+  }
+  c0 = rdtime();
+  while(uptime() < t1 + 2)
+    ;
+  if(rdtime() - c0 < ((struct vdso*)VDSO)->ticklen){
+    printf("%s: rdtime() is too slow\n", s);
+    exit(1);
+  }
+
+  ppid = getpid();
+  if((pid = fork()) < 0){
+    printf("%s: fork failed\n", s);
     exit(1);
   }
-
-  if(chdir("..") < 0){
-    printf("%s: chdir .. failed\n", s);
+  if(pid == 0)
+    exit(getpid() == sys_getpid() && getpid() != ppid ? 0 : 1);
+  wait(&xst);
+  if(xst != 0){
+    printf("%s: child has the wrong pid in its vDSO\n", s);
     exit(1);
   }
 
-  if(unlink("dir0") < 0){
-    printf("%s: unlink dir0 failed\n", s);
-    exit(1);
+  for(int i = 0; i < 2; i++){
+    if((pid = fork()) < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      *(int*)(i == 0 ? VDSO : VPROC) = 1;
+      exit(0);
+    }
+    wait(&xst);
+    if(xst != -1){
+      printf("%s: wrote the vDSO\n", s);
+      exit(1);
+    }
   }
 }
 
+// local sockets: a stream to a forked child, and messages.
 void
-exectest(char *s)
+socktest(char *s)
 {
-  int fd, xstatus, pid;
-  char *echoargv[] = { "echo", "OK", 0 };
-  char buf[3];
+  static char big[40000];
+  struct pollfd pfd;
+  int ls, c, ns, pid, xst, n, tot, fds[2];
 
-  unlink("echo-ok");
-  pid = fork();
-  if(pid < 0) {
-     printf("%s: fork failed\n", s);
-     exit(1);
+  unlink("sockf");
+  unlink("sockp");
+  ls = socket(SOCK_STREAM);
+  if(ls < 0 || bind(ls, "sockf") != 0 || listen(ls, 4) != 0){
+    printf("%s: stream socket setup failed\n", s);
+    exit(1);
   }
-  if(pid == 0) {
-    close(1);
-    fd = open("echo-ok", O_CREATE|O_WRONLY);
-    if(fd < 0) {
-      printf("%s: create failed\n", s);
-      exit(1);
-    }
-    if(fd != 1) {
-      printf("%s: wrong fd\n", s);
+  c = socket(SOCK_STREAM);
+  if(socket(0) != -1 || bind(c, "sockf") != -1 || open("sockf", O_RDWR) != -1 ||
+     bind(ls, "sockg") != -1 || open("sockg", O_RDONLY) != -1 ||
+     connect(c, "nosock") != -1 || connect(c, "README") != -1 || accept(c) != -1){
+    printf("%s: bad socket call succeeded\n", s);
+    exit(1);
+  }
+  close(c);
+  pfd.fd = ls;
+  pfd.events = POLLIN;
+  if(poll(&pfd, 1, 0) != 0){
+    printf("%s: idle listener is ready\n", s);
+    exit(1);
+  }
+
+  for(int i = 0; i < sizeof(big); i++)
+    big[i] = i % 101;
+  if((pid = fork()) < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    close(ls);
+    c = socket(SOCK_STREAM);
+    if(connect(c, "sockf") != 0 || write(c, "hello", 5) != 5 ||
+       read(c, buf, 5) != 5 || memcmp(buf, "HELLO", 5) != 0 ||
+       write(c, big, sizeof(big)) != sizeof(big))
       exit(1);
-    }
-    if(exec("echo", echoargv) < 0){
-      printf("%s: exec echo failed\n", s);
+    exit(0);
+  }
+  if(poll(&pfd, 1, -1) != 1 || pfd.revents != POLLIN || (ns = accept(ls)) < 0){
+    printf("%s: accept failed\n", s);
+    exit(1);
+  }
+  if(read(ns, buf, 5) != 5 || memcmp(buf, "hello", 5) != 0 || write(ns, "HELLO", 5) != 5){
+    printf("%s: stream exchange failed\n", s);
+    exit(1);
+  }
+  for(tot = 0; (n = read(ns, buf, 1000)) > 0; tot += n){
+    if(tot + n > sizeof(big) || memcmp(buf, big + tot, n) != 0){
+      printf("%s: stream has wrong data\n", s);
       exit(1);
     }
-    // won't get to here
   }
-  if (wait(&xstatus) != pid) {
-    printf("%s: wait failed!\n", s);
+  wait(&xst);
+  if(n != 0 || tot != sizeof(big) || xst != 0){
+    printf("%s: stream transfer failed\n", s);
+    exit(1);
   }
-  if(xstatus != 0)
-    exit(xstatus);
+  close(ns);
+  close(ls);
 
-  fd = open("echo-ok", O_RDONLY);
-  if(fd < 0) {
-    printf("%s: open failed\n", s);
+  ls = socket(SOCK_SEQPACKET);
+  c = socket(SOCK_SEQPACKET);
+  if(bind(ls, "sockp") != 0 || listen(ls, 1) != 0 || connect(c, "sockp") != 0 ||
+     (ns = accept(ls)) < 0){
+    printf("%s: seqpacket socket setup failed\n", s);
     exit(1);
   }
-  if (read(fd, buf, 2) != 2) {
-    printf("%s: read failed\n", s);
+  if(write(c, "abc", 3) != 3 || write(c, "defgh", 5) != 5 || write(c, "xyz", 3) != 3 ||
+     read(ns, buf, 100) != 3 || memcmp(buf, "abc", 3) != 0 ||
+     read(ns, buf, 2) != 2 || memcmp(buf, "de", 2) != 0 ||
+     read(ns, buf, 100) != 3 || memcmp(buf, "xyz", 3) != 0){
+    printf("%s: seqpacket lost a message boundary\n", s);
     exit(1);
   }
-  unlink("echo-ok");
-  if(buf[0] == 'O' && buf[1] == 'K')
-    exit(0);
-  else {
-    printf("%s: wrong output\n", s);
+  if(write(ns, "", 0) != 0 || write(ns, "q", 1) != 1 || read(c, buf, 100) != 0 ||
+     read(c, buf, 100) != 1 || buf[0] != 'q'){
+    printf("%s: seqpacket reply failed\n", s);
     exit(1);
   }
+  if(pipe(fds) != 0 || write(fds[1], "abc", 3) != 3){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if(splice(fds[0], c, 3) != -1 || splice(ns, fds[1], 3) != -1 || tee(fds[0], c, 3) != -1){
+    printf("%s: spliced a socket\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+  close(c);
+  if(read(ns, buf, 100) != 0){
+    printf("%s: no EOF after close\n", s);
+    exit(1);
+  }
+  close(ns);
 
-}
-
-// simple fork and pipe read/write
-
-void
-pipe1(char *s)
-{
-  int fds[2], pid, xstatus;
-  int seq, i, n, cc, total;
-  enum { N=5, SZ=1033 };
-  
-  if(pipe(fds) != 0){
-    printf("%s: pipe() failed\n", s);
+  // backlog of 1; accept without waiting.
+  c = socket(SOCK_SEQPACKET);
+  ns = socket(SOCK_SEQPACKET);
+  if(fcntl(ls, F_SETFL, O_NONBLOCK) != 0 || accept(ls) != -EAGAIN ||
+     connect(c, "sockp") != 0 || connect(ns, "sockp") != -1){
+    printf("%s: backlog not enforced\n", s);
     exit(1);
   }
-  pid = fork();
-  seq = 0;
-  if(pid == 0){
-    close(fds[0]);
-    for(n = 0; n < N; n++){
-      for(i = 0; i < SZ; i++)
-        buf[i] = seq++;
-      if(write(fds[1], buf, SZ) != SZ){
-        printf("%s: pipe1 oops 1\n", s);
-        exit(1);
-      }
-    }
-    exit(0);
-  } else if(pid > 0){
-    close(fds[1]);
-    total = 0;
-    cc = 1;
-    while((n = read(fds[0], buf, cc)) > 0){
-      for(i = 0; i < n; i++){
-        if((buf[i] & 0xff) != (seq++ & 0xff)){
-          printf("%s: pipe1 oops 2\n", s);
-          return;
-        }
-      }
-      total += n;
-      cc = cc * 2;
-      if(cc > sizeof(buf))
-        cc = sizeof(buf);
-    }
-    if(total != N * SZ){
-      printf("%s: pipe1 oops 3 total %d\n", total);
-      exit(1);
-    }
-    close(fds[0]);
-    wait(&xstatus);
-    exit(xstatus);
-  } else {
-    printf("%s: fork() failed\n", s);
+  close(ns);
+  ns = socket(SOCK_STREAM);
+  if(connect(ns, "sockp") != -1){
+    printf("%s: connected to the wrong type of socket\n", s);
+    exit(1);
+  }
+  close(ns);
+  close(c);
+  close(ls);
+  c = socket(SOCK_SEQPACKET);
+  if(connect(c, "sockp") != -1){
+    printf("%s: connected to a closed socket\n", s);
+    exit(1);
+  }
+  close(c);
+  if(unlink("sockf") != 0 || unlink("sockp") != 0){
+    printf("%s: unlink failed\n", s);
     exit(1);
   }
 }
@@ -1390,10 +2274,9 @@ concreate(char *s)
   char file[3];
   int i, pid, n, fd;
   char fa[N];
-  struct {
-    ushort inum;
-    char name[DIRSIZ];
-  } de;
+  char blk[BSIZE];
+  struct dirent *de;
+  int off;
 
   file[0] = 'C';
   file[2] = '\0';
@@ -1426,21 +2309,28 @@ concreate(char *s)
   memset(fa, 0, sizeof(fa));
   fd = open(".", 0);
   n = 0;
-  while(read(fd, &de, sizeof(de)) > 0){
-    if(de.inum == 0)
-      continue;
-    if(de.name[0] == 'C' && de.name[2] == '\0'){
-      i = de.name[1] - '0';
-      if(i < 0 || i >= sizeof(fa)){
-        printf("%s: concreate weird file %s\n", s, de.name);
+  while(read(fd, blk, BSIZE) == BSIZE){
+    for(off = 0; off < BSIZE; off += de->reclen){
+      de = (struct dirent*)(blk + off);
+      if(de->reclen == 0){
+        printf("%s: concreate bad directory entry\n", s);
         exit(1);
       }
-      if(fa[i]){
-        printf("%s: concreate duplicate file %s\n", s, de.name);
-        exit(1);
+      if(de->inum == 0)
+        continue;
+      if(de->namelen == 2 && de->name[0] == 'C'){
+        i = de->name[1] - '0';
+        if(i < 0 || i >= sizeof(fa)){
+          printf("%s: concreate weird file C%c\n", s, de->name[1]);
+          exit(1);
+        }
+        if(fa[i]){
+          printf("%s: concreate duplicate file C%c\n", s, de->name[1]);
+          exit(1);
+        }
+        fa[i] = 1;
+        n++;
       }
-      fa[i] = 1;
-      n++;
     }
   }
   close(fd);
@@ -1865,50 +2755,66 @@ bigfile(char *s)
   unlink("bigfile.dat");
 }
 
+// names of up to DIRSIZ bytes are distinct; longer ones are
+// cut to DIRSIZ.
 void
-fourteen(char *s)
+longname(char *s)
 {
+  static char n[DIRSIZ+2];
   int fd;
 
-  // DIRSIZ is 14.
+  if(mkdir("12345678901234") != 0 || mkdir("123456789012345") != 0){
+    printf("%s: mkdir 1234567890123[45] failed\n", s);
+    exit(1);
+  }
+  fd = open("123456789012345/x", O_CREATE);
+  if(fd < 0){
+    printf("%s: create 123456789012345/x failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(open("12345678901234/x", 0) >= 0){
+    printf("%s: 12345678901234/x exists\n", s);
+    exit(1);
+  }
+  if(unlink("123456789012345/x") != 0 || unlink("123456789012345") != 0 ||
+     unlink("12345678901234") != 0){
+    printf("%s: unlink 1234567890123[45] failed\n", s);
+    exit(1);
+  }
 
-  if(mkdir("12345678901234") != 0){
-    printf("%s: mkdir 12345678901234 failed\n", s);
+  // n is DIRSIZ bytes, then DIRSIZ+1.
+  memset(n, 'a', DIRSIZ);
+  if(mkdir(n) != 0){
+    printf("%s: mkdir of a %d-byte name failed\n", s, DIRSIZ);
     exit(1);
   }
-  if(mkdir("12345678901234/123456789012345") != 0){
-    printf("%s: mkdir 12345678901234/123456789012345 failed\n", s);
+  n[DIRSIZ] = 'b';
+  if(mkdir(n) == 0){
+    printf("%s: mkdir of a %d-byte name succeeded!\n", s, DIRSIZ+1);
     exit(1);
   }
-  fd = open("123456789012345/123456789012345/123456789012345", O_CREATE);
-  if(fd < 0){
-    printf("%s: create 123456789012345/123456789012345/123456789012345 failed\n", s);
+  if(chdir(n) != 0){
+    printf("%s: chdir to a %d-byte name failed\n", s, DIRSIZ+1);
     exit(1);
   }
-  close(fd);
-  fd = open("12345678901234/12345678901234/12345678901234", 0);
+  fd = open(n, O_CREATE);
   if(fd < 0){
-    printf("%s: open 12345678901234/12345678901234/12345678901234 failed\n", s);
+    printf("%s: create of a %d-byte name failed\n", s, DIRSIZ+1);
     exit(1);
   }
   close(fd);
-
-  if(mkdir("12345678901234/12345678901234") == 0){
-    printf("%s: mkdir 12345678901234/12345678901234 succeeded!\n", s);
+  n[DIRSIZ] = 0;
+  fd = open(n, 0);
+  if(fd < 0){
+    printf("%s: open of a %d-byte name failed\n", s, DIRSIZ);
     exit(1);
   }
-  if(mkdir("123456789012345/12345678901234") == 0){
-    printf("%s: mkdir 12345678901234/123456789012345 succeeded!\n", s);
+  close(fd);
+  if(unlink(n) != 0 || chdir("..") != 0 || unlink(n) != 0){
+    printf("%s: unlink of a %d-byte name failed\n", s, DIRSIZ);
     exit(1);
   }
-
-  // clean up
-  unlink("123456789012345/12345678901234");
-  unlink("12345678901234/12345678901234");
-  unlink("12345678901234/12345678901234/12345678901234");
-  unlink("123456789012345/123456789012345/123456789012345");
-  unlink("12345678901234/123456789012345");
-  unlink("12345678901234");
 }
 
 void
@@ -2003,14 +2909,198 @@ dirfile(char *s)
   close(fd);
 }
 
+// the dentry cache: a name looked up and not found can be
+// created, and a name unlinked is gone, also through a
+// directory whose inode has been freed and reused.
+void
+dcachetest(char *s)
+{
+  int fd;
+
+  if(open("dcd/x", 0) >= 0 || open("dcd/x", 0) >= 0){
+    printf("%s: dcd/x exists\n", s);
+    exit(1);
+  }
+  if(mkdir("dcd") < 0 || mkdir("dcd/x") < 0){
+    printf("%s: mkdir dcd/x failed\n", s);
+    exit(1);
+  }
+  if(open("dcd/x/y", 0) >= 0){
+    printf("%s: dcd/x/y exists\n", s);
+    exit(1);
+  }
+  fd = open("dcd/x/y", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create dcd/x/y failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if((fd = open("dcd/x/y", 0)) < 0){
+    printf("%s: open dcd/x/y failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(unlink("dcd/x/y") < 0 || open("dcd/x/y", 0) >= 0){
+    printf("%s: unlink dcd/x/y failed\n", s);
+    exit(1);
+  }
+  if(unlink("dcd/x") < 0){
+    printf("%s: unlink dcd/x failed\n", s);
+    exit(1);
+  }
+  // probably reuses the inode of dcd/x.
+  fd = open("dcd/z", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create dcd/z failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(open("dcd/x/y", 0) >= 0 || open("dcd/z/y", O_CREATE|O_RDWR) >= 0){
+    printf("%s: lookup through a freed directory succeeded\n", s);
+    exit(1);
+  }
+  if(unlink("dcd/z") < 0 || unlink("dcd") < 0){
+    printf("%s: unlink dcd failed\n", s);
+    exit(1);
+  }
+}
+
+// a directory big enough for a hash index with several
+// leaves: names are found, unlinked names are gone, and the
+// directory can be removed once it is empty again.
+void
+dirindex(char *s)
+{
+  enum { N = 300 };
+  int i, fd;
+  char name[10];
+
+  if(mkdir("dxd") < 0){
+    printf("%s: mkdir dxd failed\n", s);
+    exit(1);
+  }
+  fd = open("dxd/f", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create dxd/f failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  strcpy(name, "dxd/x000");
+  for(i = 0; i < N; i++){
+    name[5] = '0' + i / 100;
+    name[6] = '0' + i / 10 % 10;
+    name[7] = '0' + i % 10;
+    if(link("dxd/f", name) != 0){
+      printf("%s: link(dxd/f, %s) failed\n", s, name);
+      exit(1);
+    }
+  }
+  for(i = 0; i < N; i += 2){
+    name[5] = '0' + i / 100;
+    name[6] = '0' + i / 10 % 10;
+    name[7] = '0' + i % 10;
+    if(unlink(name) != 0){
+      printf("%s: unlink %s failed\n", s, name);
+      exit(1);
+    }
+  }
+  if(unlink("dxd") == 0){
+    printf("%s: unlink non-empty dxd succeeded\n", s);
+    exit(1);
+  }
+  for(i = 0; i < N; i++){
+    name[5] = '0' + i / 100;
+    name[6] = '0' + i / 10 % 10;
+    name[7] = '0' + i % 10;
+    fd = open(name, 0);
+    if((fd >= 0) != (i % 2)){
+      printf("%s: open %s: %d\n", s, name, fd);
+      exit(1);
+    }
+    if(fd >= 0)
+      close(fd);
+    if(i % 2 && unlink(name) != 0){
+      printf("%s: unlink %s failed\n", s, name);
+      exit(1);
+    }
+  }
+  if(unlink("dxd/f") != 0 || unlink("dxd") != 0){
+    printf("%s: unlink dxd failed\n", s);
+    exit(1);
+  }
+}
+
+// a small file, whose data may be in its inode, keeps its
+// contents as it grows into blocks, and as it is truncated.
+void
+inlinetest(char *s)
+{
+  char b[64];
+  int fd, i, n;
+
+  fd = open("inl", O_CREATE|O_RDWR);
+  if(fd < 0 || write(fd, "0123456789", 10) != 10){
+    printf("%s: create inl failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  // grow it, a piece at a time, to several blocks.
+  fd = open("inl", O_RDWR);
+  if(read(fd, b, sizeof(b)) != 10 || memcmp(b, "0123456789", 10) != 0){
+    printf("%s: read inl failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 3*BSIZE/sizeof(b); i++){
+    memset(b, 'a' + i % 26, sizeof(b));
+    if(write(fd, b, sizeof(b)) != sizeof(b)){
+      printf("%s: write inl failed\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+  fd = open("inl", O_RDONLY);
+  if(read(fd, b, 10) != 10 || memcmp(b, "0123456789", 10) != 0){
+    printf("%s: inl lost its first bytes\n", s);
+    exit(1);
+  }
+  for(i = 0; (n = read(fd, b, sizeof(b))) > 0; i++){
+    if(n != sizeof(b) || b[0] != 'a' + i % 26 || b[n-1] != 'a' + i % 26){
+      printf("%s: inl has wrong data\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+  if(i != 3*BSIZE/sizeof(b)){
+    printf("%s: inl has %d pieces\n", s, i);
+    exit(1);
+  }
+
+  fd = open("inl", O_RDWR|O_TRUNC);
+  if(write(fd, "xyz", 3) != 3){
+    printf("%s: write truncated inl failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  fd = open("inl", O_RDONLY);
+  if(read(fd, b, sizeof(b)) != 3 || memcmp(b, "xyz", 3) != 0){
+    printf("%s: truncated inl has wrong data\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("inl");
+}
+
 // test that iput() is called at the end of _namei().
 // also tests empty file names.
 void
 iref(char *s)
 {
+  enum { N = 51 }; // more than the inode table used to hold;
+                   // the disk has too few inodes for NINODE.
   int i, fd;
 
-  for(i = 0; i < NINODE + 1; i++){
+  for(i = 0; i < N; i++){
     if(mkdir("irefd") != 0){
       printf("%s: mkdir irefd failed\n", s);
       exit(1);
@@ -2032,7 +3122,7 @@ iref(char *s)
   }
 
   // clean up
-  for(i = 0; i < NINODE + 1; i++){
+  for(i = 0; i < N; i++){
     chdir("..");
     unlink("irefd");
   }
@@ -2865,20 +3955,36 @@ main(int argc, char *argv[])
     {opentest, "opentest"},
     {writetest, "writetest"},
     {writebig, "writebig"},
+    {fsynctest, "fsynctest"},
+    {ordertest, "ordertest"},
     {createtest, "createtest"},
     {openiputtest, "openiput"},
     {exitiputtest, "exitiput"},
     {iputtest, "iput"},
     {mem, "mem"},
     {pipe1, "pipe1"},
+    {pipesize, "pipesize"},
+    {splicetest, "splicetest"},
+    {crossplicetest, "crossplicetest"},
+    {copyrange, "copyrange"},
+    {polltest, "polltest"},
+    {nonblock, "nonblock"},
+    {iovtest, "iovtest"},
+    {preadtest, "preadtest"},
+    {uringtest, "uringtest"},
+    {vdsotest, "vdsotest"},
+    {socktest, "socktest"},
     {killstatus, "killstatus"},
     {preempt, "preempt"},
     {exitwait, "exitwait"},
     {rmdot, "rmdot"},
-    {fourteen, "fourteen"},
+    {longname, "longname"},
     {bigfile, "bigfile"},
     {dirfile, "dirfile"},
     {iref, "iref"},
+    {dcachetest, "dcachetest"},
+    {dirindex, "dirindex"},
+    {inlinetest, "inlinetest"},
     {forktest, "forktest"},
     {bigdir, "bigdir"}, // slow
     { 0, 0},
@@ -6,10 +6,12 @@ print "# generated by usys.pl - do not edit\n";
 
 print "#include \"kernel/syscall.h\"\n";
 
+# entry("x") makes x() call SYS_x; entry("x", "y") makes y() do it.
 sub entry {
     my $name = shift;
-    print ".global $name\n";
-    print "${name}:\n";
+    my $sym = shift || $name;
+    print ".global $sym\n";
+    print "${sym}:\n";
     print " li a7, SYS_${name}\n";
     print " ecall\n";
     print " ret\n";
@@ -32,7 +34,27 @@ entry("link");
 entry("mkdir");
 entry("chdir");
 entry("dup");
-entry("getpid");
+entry("getpid", "sys_getpid");  # getpid() is in ulib.c
 entry("sbrk");
 entry("sleep");
-entry("uptime");
+entry("uptime", "sys_uptime");  # so is uptime()
+entry("iostat");
+entry("iopoll");
+entry("sync");
+entry("fsync");
+entry("fcntl");
+entry("splice");
+entry("tee");
+entry("copy_file_range");
+entry("poll");
+entry("readv");
+entry("writev");
+entry("pread");
+entry("pwrite");
+entry("uring_setup");
+entry("uring_enter");
+entry("socket");
+entry("bind");
+entry("listen");
+entry("accept");
+entry("connect");
@@ -0,0 +1,66 @@
+// vDSO benchmark.
+//
+//   vdsobench [n]
+//
+// Calls uptime() and getpid() n (default 100000) times each,
+// as the system calls and as ulib's reads of the vDSO pages,
+// and reports the cost of each call, timed with rdtime(),
+// which reads the time CSR without a trap either.
+
+#include "kernel/types.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/vdso.h"
+#include "user/user.h"
+
+int n;
+
+void
+report(char *what, uint64 t)
+{
+  uint64 ns = t * 1000000000 / ((struct vdso*)VDSO)->timebase;
+
+  printf("%s: %d calls, %d ns each\n", what, n, (int)(ns / n));
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 t0;
+  int x = 0;
+
+  n = 100000;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n < 1)
+    n = 100000;
+
+  t0 = rdtime();
+  for(int i = 0; i < n; i++)
+    x += sys_uptime();
+  report("uptime system call", rdtime() - t0);
+
+  t0 = rdtime();
+  for(int i = 0; i < n; i++)
+    x += uptime();
+  report("uptime vDSO", rdtime() - t0);
+
+  t0 = rdtime();
+  for(int i = 0; i < n; i++)
+    x += sys_getpid();
+  report("getpid system call", rdtime() - t0);
+
+  t0 = rdtime();
+  for(int i = 0; i < n; i++)
+    x += getpid();
+  report("getpid vDSO", rdtime() - t0);
+
+  t0 = rdtime();
+  for(int i = 0; i < n; i++)
+    x += rdtime();
+  report("rdtime", rdtime() - t0);
+
+  if(x == 42)
+    printf("\n");  // use x, so the loops aren't optimized away
+  exit(0);
+}
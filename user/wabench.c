@@ -0,0 +1,119 @@
+// Write amplification benchmark.
+//
+//   wabench [kbytes]
+//
+// Writes a large file of kbytes (default 1024) in one-block
+// write()s, overwrites it in place, and then writes 50 small
+// files of 4 KB each; each phase ends with fsync() or sync().
+// Reports, from iostat(), the bytes each phase wrote to the
+// disk per byte of file data, and how many blocks went to
+// the log, were installed from it, and were written in place.
+// In the default ordered mode file data skips the log, so
+// the ratio should be a little over 1; a file system made
+// with mkfs -j (make DATAMODE=journal) logs the data and
+// then installs it, for a ratio of about 2. Blocks still in
+// the log when a phase ends are installed, and counted, in a
+// later phase.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+#define HZ     10 // clock ticks per second; see kernel/start.c
+#define NSMALL 50 // small files
+#define SMALL  4  // KB per small file
+
+char buf[BSIZE];
+
+void
+report(char *phase, int kb, int t, struct iostat *a, struct iostat *b)
+{
+  int disk = (b->nbytes - a->nbytes) / 1024;
+
+  if(t < 1)
+    t = 1;
+  printf("%s: %d KB in %d ticks, %d KB/s, %d KB to disk, %d.%d%d bytes/byte, "
+         "%d blocks logged, %d installed, %d in place\n",
+         phase, kb, t, kb*HZ/t, disk, disk / kb, disk * 10 / kb % 10,
+         disk * 100 / kb % 10, (int)(b->nlog - a->nlog),
+         (int)(b->ninstall - a->ninstall), (int)(b->ndata - a->ndata));
+}
+
+void
+fill(int fd, int kb)
+{
+  for(int i = 0; i < kb*1024/BSIZE; i++){
+    if(write(fd, buf, BSIZE) != BSIZE){
+      fprintf(2, "wabench: write failed\n");
+      exit(1);
+    }
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[] = "wa00";
+  struct iostat s0, s1;
+  int kb, fd, t0;
+
+  kb = 1024;
+  if(argc > 1)
+    kb = atoi(argv[1]);
+  if(kb < 1)
+    kb = 1;
+  for(int i = 0; i < BSIZE; i++)
+    buf[i] = 'a' + i % 26;
+  sync();
+
+  iostat(&s0);
+  t0 = uptime();
+  if((fd = open("wabig", O_CREATE | O_RDWR)) < 0){
+    fprintf(2, "wabench: cannot create wabig\n");
+    exit(1);
+  }
+  fill(fd, kb);
+  fsync(fd);
+  close(fd);
+  iostat(&s1);
+  report("write", kb, uptime() - t0, &s0, &s1);
+
+  iostat(&s0);
+  t0 = uptime();
+  if((fd = open("wabig", O_RDWR)) < 0){
+    fprintf(2, "wabench: cannot open wabig\n");
+    exit(1);
+  }
+  fill(fd, kb);
+  fsync(fd);
+  close(fd);
+  iostat(&s1);
+  report("overwrite", kb, uptime() - t0, &s0, &s1);
+
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < NSMALL; i++){
+    path[2] = '0' + i / 10;
+    path[3] = '0' + i % 10;
+    if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+      fprintf(2, "wabench: cannot create %s\n", path);
+      exit(1);
+    }
+    fill(fd, SMALL);
+    close(fd);
+  }
+  sync();
+  iostat(&s1);
+  report("small", NSMALL*SMALL, uptime() - t0, &s0, &s1);
+
+  unlink("wabig");
+  for(int i = 0; i < NSMALL; i++){
+    path[2] = '0' + i / 10;
+    path[3] = '0' + i % 10;
+    unlink(path);
+  }
+  exit(0);
+}
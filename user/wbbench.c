@@ -0,0 +1,129 @@
+// File write and writeback benchmark.
+//
+//   wbbench [nfiles [kbytes]]
+//
+// Writes nfiles (default 50) small files of 4 KB each, then
+// the same number of temporary files that are deleted right
+// after they are written, then one large file of kbytes
+// (default 1024), all in one-block write()s. Each phase ends
+// with sync() or fsync(), so that its data is on the disk.
+// Reports the throughput of each phase and its log traffic
+// from iostat(): blocks written to the log, and blocks
+// installed from the log in place, per KB of file data.
+// Delayed allocation should make the temporary files cost
+// almost nothing, and the large file contiguous.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+#define HZ    10 // clock ticks per second; see kernel/start.c
+#define SMALL 4  // KB per small file
+
+char buf[BSIZE];
+
+void
+report(char *phase, int kb, int t, struct iostat *a, struct iostat *b)
+{
+  int logged = b->nlog - a->nlog;
+  int installed = b->ninstall - a->ninstall;
+
+  if(t < 1)
+    t = 1;
+  printf("%s: %d KB in %d ticks, %d KB/s, %d blocks logged, %d installed, %d writes, %d.%d log blocks/KB\n",
+         phase, kb, t, kb*HZ/t, logged, installed, (int)(b->nwrite - a->nwrite),
+         logged / kb, logged * 10 / kb % 10);
+}
+
+void
+name(char *path, int i)
+{
+  path[2] = '0' + i / 100 % 10;
+  path[3] = '0' + i / 10 % 10;
+  path[4] = '0' + i % 10;
+}
+
+int
+create(char *path, int kb)
+{
+  int fd;
+
+  fd = open(path, O_CREATE | O_RDWR);
+  if(fd < 0){
+    fprintf(2, "wbbench: cannot create %s\n", path);
+    exit(1);
+  }
+  for(int i = 0; i < kb*1024/BSIZE; i++){
+    if(write(fd, buf, BSIZE) != BSIZE){
+      fprintf(2, "wbbench: write failed\n");
+      exit(1);
+    }
+  }
+  return fd;
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[] = "wb000";
+  struct iostat s0, s1;
+  struct stat st;
+  int n, kb, fd, t0;
+
+  n = 50;
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n < 1 || n > 1000)
+    n = 50;
+  kb = 1024;
+  if(argc > 2)
+    kb = atoi(argv[2]);
+  if(kb < 1)
+    kb = 1;
+  for(int i = 0; i < BSIZE; i++)
+    buf[i] = 'a' + i % 26;
+  sync();
+
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < n; i++){
+    name(path, i);
+    close(create(path, SMALL));
+  }
+  sync();
+  iostat(&s1);
+  report("small", n*SMALL, uptime() - t0, &s0, &s1);
+
+  iostat(&s0);
+  t0 = uptime();
+  for(int i = 0; i < n; i++){
+    close(create("wbtmp", SMALL));
+    unlink("wbtmp");
+  }
+  sync();
+  iostat(&s1);
+  report("temporary", n*SMALL, uptime() - t0, &s0, &s1);
+
+  iostat(&s0);
+  t0 = uptime();
+  fd = create("wbbig", kb);
+  fsync(fd);
+  iostat(&s1);
+  report("large", kb, uptime() - t0, &s0, &s1);
+  if(fstat(fd, &st) < 0){
+    fprintf(2, "wbbench: cannot stat wbbig\n");
+    exit(1);
+  }
+  close(fd);
+  printf("large: %d extents\n", st.nextent);
+
+  unlink("wbbig");
+  for(int i = 0; i < n; i++){
+    name(path, i);
+    unlink(path);
+  }
+  exit(0);
+}